@@ -0,0 +1,197 @@
+// Frame time benchmark: renders procedural scenes headless and writes the cpu/gpu frame time
+// distribution of each one as JSON.
+//   lve_vulkanEngine_benchmark [--scene name]... [--objects n --triangles n --meshes n --pipelines n]
+//                              [--warmup n] [--frames n] [--width n] [--height n] [--out file|-]
+//                              [--trace file] [--counters]
+// Without scenes every preset runs, see GetBenchmarkPresets. --trace writes the cpu zones of the
+// whole run as a chrome trace. --counters adds the hardware counters of the cpu zones (Linux perf
+// events) to the results: ipc, last level cache and branch misses per thousand instructions
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "core/engine/VEngine.h"
+#include "core/api/VulkanLib.h"
+#include "core/debugger/public/CpuProfiler.h"
+#include "BenchmarkScene.h"
+#include "BenchmarkReport.h"
+
+namespace
+{
+	struct BenchmarkOptions
+	{
+		std::vector<BenchmarkSceneDesc> Scenes;
+		uint32_t WarmupFrames = 60;
+		uint32_t MeasuredFrames = 300;
+		uint32_t Width = 1280;
+		uint32_t Height = 720;
+		std::string OutputPath = "benchmark_results.json";
+		std::string TracePath;
+		bool Counters = false;
+	};
+
+	bool _ParseOptions(int argc, char** argv, BenchmarkOptions& options)
+	{
+		BenchmarkSceneDesc custom;
+		custom.Name = "custom";
+		bool hasCustom = false;
+
+		for (int i = 1; i < argc; ++i)
+		{
+			const char* arg = argv[i];
+			if (!strcmp(arg, "--counters"))
+			{
+				options.Counters = true;
+				continue;
+			}
+			if (i + 1 >= argc)
+			{
+				std::cerr << "Missing value for " << arg << "\n";
+				return false;
+			}
+			const char* value = argv[++i];
+			uint32_t number = (uint32_t)std::strtoul(value, nullptr, 10);
+
+			if (!strcmp(arg, "--scene"))
+			{
+				bool found = false;
+				for (const BenchmarkSceneDesc& preset : GetBenchmarkPresets())
+				{
+					if (preset.Name == value)
+					{
+						options.Scenes.push_back(preset);
+						found = true;
+					}
+				}
+				if (!found)
+				{
+					std::cerr << "Unknown scene " << value << "\n";
+					return false;
+				}
+			}
+			else if (!strcmp(arg, "--objects")) { custom.Objects = number; hasCustom = true; }
+			else if (!strcmp(arg, "--triangles")) { custom.TrianglesPerMesh = number; hasCustom = true; }
+			else if (!strcmp(arg, "--meshes")) { custom.UniqueMeshes = number; hasCustom = true; }
+			else if (!strcmp(arg, "--pipelines")) { custom.UniquePipelines = number; hasCustom = true; }
+			else if (!strcmp(arg, "--warmup")) options.WarmupFrames = number;
+			else if (!strcmp(arg, "--frames")) options.MeasuredFrames = number;
+			else if (!strcmp(arg, "--width")) options.Width = number;
+			else if (!strcmp(arg, "--height")) options.Height = number;
+			else if (!strcmp(arg, "--out")) options.OutputPath = value;
+			else if (!strcmp(arg, "--trace")) options.TracePath = value;
+			else
+			{
+				std::cerr << "Unknown option " << arg << "\n";
+				return false;
+			}
+		}
+
+		if (hasCustom)
+			options.Scenes.push_back(custom);
+		if (options.Scenes.empty())
+			options.Scenes = GetBenchmarkPresets();
+		return options.MeasuredFrames > 0 && options.Width > 0 && options.Height > 0;
+	}
+
+	// a fresh engine per scene so one scene's resources don't weigh on the next one
+	BenchmarkResult _RunScene(const BenchmarkSceneDesc& scene, const BenchmarkOptions& options, std::string& device)
+	{
+		EngineSettings settings;
+		settings.Headless.Width = options.Width;
+		settings.Headless.Height = options.Height;
+		settings.Headless.FrameCount = (uint64_t)options.WarmupFrames + options.MeasuredFrames;
+		settings.SwapChain.PresentMode = PRESENT_MODE_POLICY::UNCAPPED;
+
+		VEngine engine("vEngine benchmark", settings);
+		VkPhysicalDeviceProperties gpuProperties;
+		engine.GetVulkan().GetInstanceDispatch().GetPhysicalDeviceProperties(engine.GetVulkan().GetGpu(), &gpuProperties);
+		device = gpuProperties.deviceName;
+
+		BuildBenchmarkScene(engine, scene);
+		PerfCounters::Reset();
+
+		std::vector<double> cpuFrameTimes;
+		std::vector<double> gpuFrameTimes;
+		cpuFrameTimes.reserve(options.MeasuredFrames);
+		gpuFrameTimes.reserve(options.MeasuredFrames);
+		engine.SetFrameTimingCallback([&](const FrameTiming& timing)
+		{
+			if (timing.FrameNumber <= options.WarmupFrames)
+				return;
+			cpuFrameTimes.push_back(timing.CpuFrameMs);
+			if (timing.HasGpuTime)
+				gpuFrameTimes.push_back(timing.GpuFrameMs);
+		});
+		engine.Run();
+
+		BenchmarkResult result;
+		result.Scene = scene;
+		result.WarmupFrames = options.WarmupFrames;
+		result.MeasuredFrames = (uint32_t)cpuFrameTimes.size();
+		result.CpuFrameMs = ComputeFrameTimeStats(cpuFrameTimes);
+		result.GpuFrameMs = ComputeFrameTimeStats(gpuFrameTimes);
+		result.GpuScopes = engine.GetGpuScopeStats();
+		result.Startup = engine.GetStartupStats();
+		// warmup included, a zone runs too many times per frame to split them
+		if (PerfCounters::IsEnabled())
+			result.CpuZoneCounters = PerfCounters::GetZoneStats();
+		return result;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	BenchmarkOptions options;
+	if (!_ParseOptions(argc, argv, options))
+		return EXIT_FAILURE;
+
+	std::vector<BenchmarkResult> results;
+	std::string device;
+	if (!options.TracePath.empty())
+		CpuProfiler::GetInstance().BeginCapture();
+	if (options.Counters && !PerfCounters::Enable())
+		std::cerr << "Hardware counters not available (perf_event_paranoid, virtual machine?), running without\n";
+	try
+	{
+		for (const BenchmarkSceneDesc& scene : options.Scenes)
+		{
+			std::cerr << "Running " << scene.Name << "...\n";
+			results.push_back(_RunScene(scene, options, device));
+			const BenchmarkResult& result = results.back();
+			std::cerr << "  cpu p50 " << result.CpuFrameMs.P50 << " ms p99 " << result.CpuFrameMs.P99
+				<< " ms, gpu p50 " << result.GpuFrameMs.P50 << " ms p99 " << result.GpuFrameMs.P99 << " ms"
+				<< ", first frame " << result.Startup.TimeToFirstFrameMs << " ms\n";
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Benchmark failed: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	if (!options.TracePath.empty())
+	{
+		CpuProfiler::GetInstance().EndCapture();
+		if (!CpuProfiler::GetInstance().WriteChromeTrace(options.TracePath.c_str()))
+			std::cerr << "Can't write " << options.TracePath << "\n";
+	}
+
+	if (options.OutputPath == "-")
+	{
+		WriteBenchmarkJson(std::cout, device, options.Width, options.Height, results);
+	}
+	else
+	{
+		std::ofstream file(options.OutputPath);
+		if (!file)
+		{
+			std::cerr << "Can't write " << options.OutputPath << "\n";
+			return EXIT_FAILURE;
+		}
+		WriteBenchmarkJson(file, device, options.Width, options.Height, results);
+	}
+	return EXIT_SUCCESS;
+}
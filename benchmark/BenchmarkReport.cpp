@@ -0,0 +1,107 @@
+#include "BenchmarkReport.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace
+{
+	double _Percentile(const std::vector<double>& sorted, double percentile)
+	{
+		std::size_t rank = (std::size_t)std::ceil(percentile / 100.0 * sorted.size());
+		return sorted[std::min(std::max<std::size_t>(rank, 1), sorted.size()) - 1];
+	}
+
+	std::string _Escape(const std::string& text)
+	{
+		std::string escaped;
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')
+				escaped += '\\';
+			if ((unsigned char)c >= 0x20)
+				escaped += c;
+		}
+		return escaped;
+	}
+
+	void _WriteStats(std::ostream& out, const char* name, const FrameTimeStats& stats)
+	{
+		out << "\t\t\t\"" << name << "\": { \"samples\": " << stats.Samples
+			<< ", \"mean\": " << stats.Mean
+			<< ", \"p50\": " << stats.P50
+			<< ", \"p95\": " << stats.P95
+			<< ", \"p99\": " << stats.P99
+			<< ", \"max\": " << stats.Max << " }";
+	}
+}
+
+FrameTimeStats ComputeFrameTimeStats(std::vector<double>& samples)
+{
+	FrameTimeStats stats;
+	if (samples.empty())
+		return stats;
+
+	std::sort(samples.begin(), samples.end());
+	stats.Samples = (uint32_t)samples.size();
+	stats.Mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+	stats.P50 = _Percentile(samples, 50.0);
+	stats.P95 = _Percentile(samples, 95.0);
+	stats.P99 = _Percentile(samples, 99.0);
+	stats.Max = samples.back();
+	return stats;
+}
+
+void WriteBenchmarkJson(std::ostream& out, const std::string& device, uint32_t width, uint32_t height
+	, const std::vector<BenchmarkResult>& results)
+{
+	out << "{\n";
+	out << "\t\"device\": \"" << _Escape(device) << "\",\n";
+	out << "\t\"width\": " << width << ",\n";
+	out << "\t\"height\": " << height << ",\n";
+	out << "\t\"results\": [\n";
+	for (std::size_t i = 0; i < results.size(); ++i)
+	{
+		const BenchmarkResult& result = results[i];
+		const BenchmarkSceneDesc& scene = result.Scene;
+		out << "\t\t{\n";
+		out << "\t\t\t\"scene\": \"" << _Escape(scene.Name) << "\",\n";
+		out << "\t\t\t\"objects\": " << scene.Objects << ",\n";
+		out << "\t\t\t\"trianglesPerMesh\": " << scene.TrianglesPerMesh << ",\n";
+		out << "\t\t\t\"triangles\": " << (uint64_t)scene.Objects * scene.TrianglesPerMesh << ",\n";
+		out << "\t\t\t\"uniqueMeshes\": " << scene.UniqueMeshes << ",\n";
+		out << "\t\t\t\"uniquePipelines\": " << scene.UniquePipelines << ",\n";
+		out << "\t\t\t\"warmupFrames\": " << result.WarmupFrames << ",\n";
+		out << "\t\t\t\"measuredFrames\": " << result.MeasuredFrames << ",\n";
+		_WriteStats(out, "cpuFrameMs", result.CpuFrameMs);
+		out << ",\n";
+		_WriteStats(out, "gpuFrameMs", result.GpuFrameMs);
+		out << ",\n\t\t\t\"gpuScopesAverageMs\": {";
+		for (std::size_t j = 0; j < result.GpuScopes.size(); ++j)
+			out << (j > 0 ? ", " : " ") << "\"" << _Escape(result.GpuScopes[j].Name) << "\": " << result.GpuScopes[j].AverageMs;
+		out << " }";
+		out << ",\n\t\t\t\"initMs\": " << result.Startup.InitMs;
+		out << ",\n\t\t\t\"timeToFirstFrameMs\": " << result.Startup.TimeToFirstFrameMs;
+		out << ",\n\t\t\t\"startupStagesMs\": {";
+		for (std::size_t j = 0; j < result.Startup.Stages.size(); ++j)
+			out << (j > 0 ? ", " : " ") << "\"" << _Escape(result.Startup.Stages[j].Name) << "\": " << result.Startup.Stages[j].DurationMs;
+		out << " }";
+		if (!result.CpuZoneCounters.empty())
+		{
+			out << ",\n\t\t\t\"cpuZoneCounters\": {";
+			for (std::size_t j = 0; j < result.CpuZoneCounters.size(); ++j)
+			{
+				const ZoneCounterStats& zone = result.CpuZoneCounters[j];
+				out << (j > 0 ? "," : "") << "\n\t\t\t\t\"" << _Escape(zone.Name) << "\": { \"samples\": " << zone.Samples
+					<< ", \"cycles\": " << zone.Totals.Cycles
+					<< ", \"instructions\": " << zone.Totals.Instructions
+					<< ", \"ipc\": " << zone.Ipc
+					<< ", \"llcMissesPerKiloInstruction\": " << zone.LlcMissesPerKiloInstruction
+					<< ", \"branchMissesPerKiloInstruction\": " << zone.BranchMissesPerKiloInstruction << " }";
+			}
+			out << "\n\t\t\t}";
+		}
+		out << "\n\t\t}" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "\t]\n";
+	out << "}\n";
+}
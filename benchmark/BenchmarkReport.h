@@ -0,0 +1,41 @@
+#ifndef BENCHMARK_REPORT_HPP
+#define BENCHMARK_REPORT_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "BenchmarkScene.h"
+#include "core/api/VulkanGpuProfiler.h"
+#include "core/engine/StartupTimer.h"
+#include "core/debugger/public/PerfCounters.h"
+
+struct FrameTimeStats
+{
+	uint32_t Samples = 0;
+	double Mean = 0.0;
+	double P50 = 0.0;
+	double P95 = 0.0;
+	double P99 = 0.0;
+	double Max = 0.0;
+};
+
+struct BenchmarkResult
+{
+	BenchmarkSceneDesc Scene;
+	uint32_t WarmupFrames = 0;
+	uint32_t MeasuredFrames = 0;
+	FrameTimeStats CpuFrameMs;
+	FrameTimeStats GpuFrameMs;// no samples without timestamp support
+	std::vector<GpuScopeStats> GpuScopes;// moving averages at the end of the run
+	StartupStats Startup;// engine constructor, the first frame also waits for the scene to be built
+	std::vector<ZoneCounterStats> CpuZoneCounters;// only with --counters
+};
+
+// nearest rank percentiles, the samples are sorted in place
+FrameTimeStats ComputeFrameTimeStats(std::vector<double>& samples);
+
+void WriteBenchmarkJson(std::ostream& out, const std::string& device, uint32_t width, uint32_t height
+	, const std::vector<BenchmarkResult>& results);
+
+#endif //BENCHMARK_REPORT_HPP
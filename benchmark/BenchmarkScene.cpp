@@ -0,0 +1,104 @@
+#include "BenchmarkScene.h"
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "core/engine/VEngine.h"
+
+namespace
+{
+	// a disc of triangleCount slices, the mesh index changes the shape and the colors
+	std::vector<float> _CreateDiscMesh(uint32_t triangleCount, uint32_t meshIndex)
+	{
+		const float pi = glm::pi<float>();
+		uint32_t points = 3 + meshIndex % 5;// star points
+		float hue = 0.15f * meshIndex;
+
+		auto radius = [&](float angle) { return 0.5f * (0.8f + 0.2f * std::cos(angle * points)); };
+		auto color = [&](float t) { return glm::vec3(0.5f + 0.5f * std::cos(2.0f * pi * (t + hue))
+			, 0.5f + 0.5f * std::cos(2.0f * pi * (t + hue + 0.33f))
+			, 0.5f + 0.5f * std::cos(2.0f * pi * (t + hue + 0.67f))); };
+
+		std::vector<float> vertices;
+		vertices.reserve((std::size_t)triangleCount * 3 * 6);
+		auto addVertex = [&vertices](glm::vec3 position, glm::vec3 rgb)
+		{
+			vertices.insert(vertices.end(), { position.x, position.y, position.z, rgb.x, rgb.y, rgb.z });
+		};
+
+		for (uint32_t i = 0; i < triangleCount; ++i)
+		{
+			float t0 = (float)i / triangleCount;
+			float t1 = (float)(i + 1) / triangleCount;
+			float a0 = 2.0f * pi * t0;
+			float a1 = 2.0f * pi * t1;
+			addVertex(glm::vec3(0.0f), glm::vec3(1.0f));
+			addVertex(glm::vec3(std::cos(a0), std::sin(a0), 0.0f) * radius(a0), color(t0));
+			addVertex(glm::vec3(std::cos(a1), std::sin(a1), 0.0f) * radius(a1), color(t1));
+		}
+		return vertices;
+	}
+}
+
+const std::vector<BenchmarkSceneDesc>& GetBenchmarkPresets()
+{
+	static const std::vector<BenchmarkSceneDesc> presets
+	{
+		// name, objects, triangles per mesh, unique meshes, unique pipelines
+		{ "single_draw", 1, 1, 1, 1 },
+		{ "draws_1k", 1000, 16, 4, 2 },
+		{ "draws_10k", 10000, 16, 16, 4 },
+		{ "draws_100k", 100000, 8, 16, 8 },
+		{ "draws_1m", 1000000, 2, 16, 8 },
+		{ "triangles_1m", 100, 10000, 1, 1 },
+		{ "state_changes", 10000, 16, 64, 256 },
+	};
+	return presets;
+}
+
+void BuildBenchmarkScene(VEngine& engine, const BenchmarkSceneDesc& desc)
+{
+	uint32_t objectCount = std::max(1u, desc.Objects);
+	uint32_t meshCount = std::max(1u, desc.UniqueMeshes);
+	uint32_t pipelineCount = std::max(1u, desc.UniquePipelines);
+	uint32_t triangleCount = std::max(1u, desc.TrianglesPerMesh);
+
+	// the engine's triangle (mesh 0) isn't used, its default pipeline is the first of ours
+	std::vector<uint32_t> meshes(meshCount);
+	for (uint32_t i = 0; i < meshCount; ++i)
+		meshes[i] = engine.AddMesh(_CreateDiscMesh(triangleCount, i));
+	std::vector<uint32_t> pipelines(pipelineCount);
+	pipelines[0] = 0;
+	for (uint32_t i = 1; i < pipelineCount; ++i)
+		pipelines[i] = engine.AddPipelineVariant();
+
+	// a square grid spanning [-1,1], the default camera at z=2 sees all of it
+	uint32_t side = (uint32_t)std::ceil(std::sqrt((double)objectCount));
+	float cell = 2.0f / side;
+	uint64_t groups = (uint64_t)pipelineCount * meshCount;
+
+	SimulationState scene;
+	scene.Objects.resize(objectCount);
+	for (uint32_t i = 0; i < objectCount; ++i)
+	{
+		ObjectState& object = scene.Objects[i];
+		object.Position = glm::vec3(-1.0f + cell * (i % side + 0.5f), -1.0f + cell * (i / side + 0.5f), 0.0f);
+		object.Scale = glm::vec3(cell * 0.9f);
+		object.Radius = 0.5f;
+		// contiguous runs of the same pipeline, and of the same mesh inside them
+		uint64_t group = (uint64_t)i * groups / objectCount;
+		object.Pipeline = pipelines[group / meshCount];
+		object.Mesh = meshes[group % meshCount];
+	}
+
+	engine.SetSimulation(scene, [](SimulationState& state, double dt)
+	{
+		for (std::size_t i = 0; i < state.Objects.size(); ++i)
+		{
+			float speed = glm::radians(30.0f) * (float)(1 + i % 4);
+			glm::quat spin = glm::angleAxis(speed * (float)dt, glm::vec3(0.0f, 0.0f, 1.0f));
+			state.Objects[i].Rotation = glm::normalize(spin * state.Objects[i].Rotation);
+		}
+	});
+}
@@ -0,0 +1,28 @@
+#ifndef BENCHMARK_SCENE_HPP
+#define BENCHMARK_SCENE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class VEngine;
+
+// A procedural stress scene, every object is one draw
+struct BenchmarkSceneDesc
+{
+	std::string Name;
+	uint32_t Objects = 1;
+	uint32_t TrianglesPerMesh = 1;
+	uint32_t UniqueMeshes = 1;
+	uint32_t UniquePipelines = 1;
+};
+
+// from a single draw to a million, plus geometry and state change heavy scenes
+const std::vector<BenchmarkSceneDesc>& GetBenchmarkPresets();
+
+// Adds the meshes and pipelines to the engine and sets a simulation spinning the objects.
+// Objects are laid out on a grid filling the view and sorted by pipeline then mesh, so a
+// frame has at most UniquePipelines * UniqueMeshes binds
+void BuildBenchmarkScene(VEngine& engine, const BenchmarkSceneDesc& desc);
+
+#endif //BENCHMARK_SCENE_HPP
@@ -1,3 +1,4 @@
-C:\VulkanSDK\1.2.131.2\Bin\glslc.exe -fshader-stage=vertex vertex.glsl -o vertex.spv
-C:\VulkanSDK\1.2.131.2\Bin\glslc.exe -fshader-stage=fragment fragment.glsl -o fragment.spv
+@echo off
+rem kept for double click builds, the real work is done by compileShaders.py
+python "%~dp0compileShaders.py" %*
 pause
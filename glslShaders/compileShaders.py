@@ -0,0 +1,239 @@
+#!/usr/bin/env python3
+"""
+Incremental offline shader build.
+
+Compiles every *.glsl file in this folder to SPIR-V next to its source
+(vertex.glsl -> vertex.spv). A shader is only recompiled when the hash of its
+source, everything it #includes and the compiler flags changed since the last
+build, the hashes live in .shadercache.json.
+
+    compileShaders.py                 debug build (debug info, no optimization)
+    compileShaders.py --release       optimized SPIR-V with debug info stripped
+    compileShaders.py --embed <file>  also write the bytecode as constexpr uint32_t
+                                      arrays to a C++ header
+
+The shader stage is taken from glslc's #pragma shader_stage(...) in the source,
+otherwise from a whole word of the file name: vertex, fragment, compute, geometry,
+tesscontrol, tesseval (or the short vert, frag, comp, geom, tesc, tese), words are
+split on '_', '.', '-' and camelCase (computeFill.glsl, sky_frag.glsl). A name with
+words of two stages is an error, add the pragma.
+"""
+import argparse
+import hashlib
+import json
+import os
+import re
+import shutil
+import subprocess
+import sys
+
+SHADER_DIR = os.path.dirname(os.path.abspath(__file__))
+PROJECT_DIR = os.path.dirname(SHADER_DIR)
+CACHE_FILE = os.path.join(SHADER_DIR, ".shadercache.json")
+
+STAGES = {
+    "tesscontrol": "tesc", "tesc": "tesc",
+    "tesseval": "tese", "tese": "tese",
+    "vertex": "vertex", "vert": "vertex",
+    "fragment": "fragment", "frag": "fragment",
+    "compute": "compute", "comp": "compute",
+    "geometry": "geometry", "geom": "geometry",
+}
+
+INCLUDE_RE = re.compile(r'^\s*#\s*include\s+[<"]([^>"]+)[>"]', re.MULTILINE)
+PRAGMA_STAGE_RE = re.compile(r'^\s*#\s*pragma\s+shader_stage\s*\(\s*(\w+)\s*\)', re.MULTILINE)
+NAME_WORD_RE = re.compile(r"[A-Z]?[a-z0-9]+|[A-Z]+(?![a-z])")
+
+
+def find_tool(name):
+    exe = name + (".exe" if os.name == "nt" else "")
+    sdk = os.environ.get("VULKAN_SDK")
+    if sdk:
+        for sub in ("Bin", "bin"):
+            candidate = os.path.join(sdk, sub, exe)
+            if os.path.isfile(candidate):
+                return candidate
+    return shutil.which(exe)
+
+
+def shader_stage(path):
+    """None for a file only meant to be #included, raises ValueError when the stage is ambiguous"""
+    with open(path, "r", encoding="utf-8") as f:
+        pragma = PRAGMA_STAGE_RE.search(f.read())
+    if pragma:
+        stage = STAGES.get(pragma.group(1).lower())
+        if stage is None:
+            raise ValueError("unknown #pragma shader_stage(%s)" % pragma.group(1))
+        return stage
+
+    name = os.path.basename(path)[:-len(".glsl")]
+    stages = {STAGES[word.lower()] for word in NAME_WORD_RE.findall(name) if word.lower() in STAGES}
+    if len(stages) > 1:
+        raise ValueError("the name matches the stages %s, add a #pragma shader_stage" % ", ".join(sorted(stages)))
+    return stages.pop() if stages else None
+
+
+def collect_sources(path, seen=None):
+    """returns the shader source followed by every file it includes, recursively"""
+    if seen is None:
+        seen = []
+    path = os.path.normpath(path)
+    if path in seen:
+        return seen
+    seen.append(path)
+    with open(path, "r", encoding="utf-8") as f:
+        text = f.read()
+    for include in INCLUDE_RE.findall(text):
+        included = os.path.join(os.path.dirname(path), include)
+        if not os.path.isfile(included):
+            included = os.path.join(SHADER_DIR, include)
+        if os.path.isfile(included):
+            collect_sources(included, seen)
+    return seen
+
+
+def source_hash(sources, flags):
+    h = hashlib.sha256()
+    h.update(" ".join(flags).encode("utf-8"))
+    for src in sources:
+        h.update(os.path.relpath(src, SHADER_DIR).replace("\\", "/").encode("utf-8"))
+        with open(src, "rb") as f:
+            h.update(f.read())
+    return h.hexdigest()
+
+
+def compile_shader(glslc, spirv_opt, src, dst, stage, flags, release):
+    cmd = [glslc, "-fshader-stage=" + stage, "-I", SHADER_DIR] + flags + [src, "-o", dst]
+    if subprocess.call(cmd) != 0:
+        return False
+    if release and spirv_opt:
+        # glslc -O keeps OpName/OpLine/OpSource, strip them so release binaries carry only the code
+        if subprocess.call([spirv_opt, "--strip-debug", dst, "-o", dst]) != 0:
+            return False
+    return True
+
+
+def write_if_changed(path, text):
+    if os.path.isfile(path):
+        with open(path, "r", encoding="utf-8") as f:
+            if f.read() == text:
+                return False
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    with open(path, "w", encoding="utf-8", newline="\n") as f:
+        f.write(text)
+    return True
+
+
+def write_embedded_header(header, outputs):
+    lines = [
+        "// generated by glslShaders/compileShaders.py, don't edit",
+        "#ifndef EMBEDDED_SHADERS_HPP",
+        "#define EMBEDDED_SHADERS_HPP",
+        "",
+        "#include <cstdint>",
+        "#include <cstddef>",
+        "",
+        "namespace EmbeddedShaders",
+        "{",
+    ]
+    table = []
+    for dst in outputs:
+        with open(dst, "rb") as f:
+            code = f.read()
+        words = [int.from_bytes(code[i:i + 4], "little") for i in range(0, len(code), 4)]
+        symbol = re.sub(r"\W", "_", os.path.basename(dst))
+        lines.append("\tconstexpr uint32_t %s[] =" % symbol)
+        lines.append("\t{")
+        for i in range(0, len(words), 8):
+            lines.append("\t\t" + ",".join("0x%08x" % w for w in words[i:i + 8]) + ",")
+        lines.append("\t};")
+        lines.append("")
+        path = os.path.relpath(dst, PROJECT_DIR).replace("\\", "/")
+        table.append('\t\t{ "%s", %s, sizeof(%s) },' % (path, symbol, symbol))
+
+    lines += [
+        "\tstruct Entry",
+        "\t{",
+        "\t\tconst char* Path;// same path the loader would open from disk",
+        "\t\tconst uint32_t* Code;",
+        "\t\tstd::size_t Size;// in bytes",
+        "\t};",
+        "",
+        "\tconstexpr Entry Table[] =",
+        "\t{",
+    ] + table + [
+        "\t};",
+        "}",
+        "",
+        "#endif //EMBEDDED_SHADERS_HPP",
+        "",
+    ]
+    if write_if_changed(header, "\n".join(lines)):
+        print("embedded shaders written to " + header)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="incremental GLSL -> SPIR-V build")
+    parser.add_argument("--release", action="store_true", help="optimize and strip debug info")
+    parser.add_argument("--embed", metavar="HEADER", help="emit the SPIR-V as constexpr arrays in HEADER")
+    parser.add_argument("--force", action="store_true", help="ignore the cache and rebuild everything")
+    parser.add_argument("--glslc", help="path to glslc, defaults to $VULKAN_SDK or PATH")
+    args = parser.parse_args()
+
+    glslc = args.glslc or find_tool("glslc")
+    if not glslc:
+        sys.exit("glslc not found, install the Vulkan SDK or set VULKAN_SDK")
+    spirv_opt = find_tool("spirv-opt") if args.release else None
+    if args.release and not spirv_opt:
+        print("spirv-opt not found, release shaders will keep their debug names")
+
+    flags = ["-O", "--target-env=vulkan1.0"] if args.release else ["-g", "-O0", "--target-env=vulkan1.0"]
+
+    cache = {}
+    if os.path.isfile(CACHE_FILE) and not args.force:
+        with open(CACHE_FILE, "r", encoding="utf-8") as f:
+            cache = json.load(f)
+
+    outputs = []
+    failed = False
+    compiled = 0
+    for name in sorted(os.listdir(SHADER_DIR)):
+        if not name.endswith(".glsl"):
+            continue
+        src = os.path.join(SHADER_DIR, name)
+        try:
+            stage = shader_stage(src)
+        except ValueError as error:
+            print("%s: %s" % (name, error))
+            failed = True
+            continue
+        if stage is None:
+            # shared code only meant to be #included
+            continue
+        dst = os.path.join(SHADER_DIR, name[:-len(".glsl")] + ".spv")
+        digest = source_hash(collect_sources(src), flags + [stage])
+        outputs.append(dst)
+
+        if cache.get(name) == digest and os.path.isfile(dst):
+            continue
+        print("compiling %s (%s)" % (name, stage))
+        if compile_shader(glslc, spirv_opt, src, dst, stage, flags, args.release):
+            cache[name] = digest
+            compiled += 1
+        else:
+            cache.pop(name, None)
+            failed = True
+
+    with open(CACHE_FILE, "w", encoding="utf-8", newline="\n") as f:
+        json.dump(cache, f, indent=2, sort_keys=True)
+
+    if failed:
+        sys.exit(1)
+    print("%d shader(s) compiled, %d up to date" % (compiled, len(outputs) - compiled))
+
+    if args.embed:
+        write_embedded_header(os.path.abspath(args.embed), outputs)
+
+
+if __name__ == "__main__":
+    main()
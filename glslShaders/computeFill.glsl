@@ -0,0 +1,27 @@
+#version 450 core
+
+// sample for VulkanComputePipeline, the compute smoke test checks what it writes:
+// Values[i] = i * Scale + Offset for the first Count elements, the rest is left alone
+layout (local_size_x = 64) in;
+
+layout (constant_id = 1) const uint Offset = 0;
+
+layout (set = 0, binding = 0) buffer Output
+{
+   uint Values[];
+} result;
+
+layout (push_constant) uniform PushConstants
+{
+   uint Count;
+   uint Scale;
+} push;
+
+void main()
+{
+   uint i = gl_GlobalInvocationID.x;
+   // DispatchForSize rounds up to whole work groups
+   if (i >= push.Count)
+      return;
+   result.Values[i] = i * push.Scale + Offset;
+}
@@ -5,10 +5,22 @@ layout (location = 1) in vec3 color;
 
 layout (location = 0) out vec3 colour;
 
+// written right before the frame is submitted, not when it is recorded
+layout (set = 0, binding = 0) uniform Camera
+{
+   mat4 ViewProjection;
+} camera;
+
+// model matrix of the object, interpolated on the cpu every frame
+layout (push_constant) uniform PushConstants
+{
+   mat4 Model;
+} push;
+
 void main()
 {
 
-   gl_Position = vec4(pos,1.0);
+   gl_Position = camera.ViewProjection * push.Model * vec4(pos,1.0);
 
    colour = color;
 
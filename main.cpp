@@ -1,12 +1,24 @@
+#ifdef _WIN32
 #include <Windows.h>
+#endif
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
 #include "core/engine/VEngine.h"
 
+#ifdef _WIN32
 int WinMain(_In_ HINSTANCE hInstance, _In_opt_  HINSTANCE hprevInstance, _In_ LPSTR lpCmdLine, _In_ int nCmdShow)
 {
 
 	try
 	{
-		VEngine engine("vEngine (vulkan)",hInstance);
+		// every hitch on a user's machine leaves its own profile, hitch_<frame>.json in the working directory
+		EngineSettings settings;
+		settings.Hitch.Enabled = true;
+		// the second start skips compiling the pipelines again
+		settings.PipelineCachePath = "pipelineCache.bin";
+		VEngine engine("vEngine (vulkan)", hInstance, settings);
 		engine.Run();
 	}
 	catch (...)
@@ -17,4 +29,38 @@ int WinMain(_In_ HINSTANCE hInstance, _In_opt_  HINSTANCE hprevInstance, _In_ LP
 	system("pause");
 
 	return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
+#else
+// no window system, e.g: farm nodes and CI. Renders offscreen, optionally a fixed number of frames
+//   lve_vulkanEngine [frames] [--allocation-guard]
+// --allocation-guard fails the run when a frame allocates after the warmup, see EngineSettings::AllocationGuard
+int main(int argc, char** argv)
+{
+	EngineSettings settings;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "--allocation-guard"))
+			settings.AllocationGuard.Enabled = true;
+		else
+			settings.Headless.FrameCount = std::strtoull(argv[i], nullptr, 10);
+	}
+
+	try
+	{
+		VEngine engine("vEngine (vulkan)", settings);
+		engine.Run();
+	}
+	catch (const std::exception& e)
+	{
+		// release builds have no log, the ci output is all there is
+		fprintf(stderr, "%s", e.what());
+		return EXIT_FAILURE;
+	}
+	catch (...)
+	{
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+#endif
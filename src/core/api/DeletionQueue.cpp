@@ -0,0 +1,117 @@
+#include "DeletionQueue.h"
+
+DeletionQueue::DeletionQueue()
+	: Pending{}
+	, Lock{}
+	, SubmittedFrameValue{ 0 }
+	, Device{ VK_NULL_HANDLE }
+	, Allocator{ nullptr }
+	, Dispatch{ nullptr }
+{
+}
+
+DeletionQueue::~DeletionQueue()
+{
+	FlushAll();
+}
+
+void DeletionQueue::Push(std::function<void()>&& destroy)
+{
+	std::lock_guard<std::mutex> lock(Lock);
+	Pending.push_back(PendingDeletion{ SubmittedFrameValue + 1, std::move(destroy) });
+}
+
+void DeletionQueue::DestroyBuffer(VkBuffer buffer, VkDeviceMemory memory)
+{
+	if (buffer == VK_NULL_HANDLE && memory == VK_NULL_HANDLE)
+		return;
+	VkDevice device = Device;
+	const VkAllocationCallbacks* allocator = Allocator;
+	Push([dispatch = Dispatch, device, allocator, buffer, memory]()
+	{
+		if (buffer != VK_NULL_HANDLE)
+			dispatch->DestroyBuffer(device, buffer, allocator);
+		if (memory != VK_NULL_HANDLE)
+			dispatch->FreeMemory(device, memory, allocator);
+	});
+}
+
+void DeletionQueue::DestroyImage(VkImage image, VkImageView view, VkDeviceMemory memory)
+{
+	if (image == VK_NULL_HANDLE && view == VK_NULL_HANDLE && memory == VK_NULL_HANDLE)
+		return;
+	VkDevice device = Device;
+	const VkAllocationCallbacks* allocator = Allocator;
+	Push([dispatch = Dispatch, device, allocator, image, view, memory]()
+	{
+		if (view != VK_NULL_HANDLE)
+			dispatch->DestroyImageView(device, view, allocator);
+		if (image != VK_NULL_HANDLE)
+			dispatch->DestroyImage(device, image, allocator);
+		if (memory != VK_NULL_HANDLE)
+			dispatch->FreeMemory(device, memory, allocator);
+	});
+}
+
+void DeletionQueue::DestroyImageView(VkImageView view)
+{
+	if (view == VK_NULL_HANDLE)
+		return;
+	VkDevice device = Device;
+	const VkAllocationCallbacks* allocator = Allocator;
+	Push([dispatch = Dispatch, device, allocator, view]() { dispatch->DestroyImageView(device, view, allocator); });
+}
+
+void DeletionQueue::DestroyFramebuffer(VkFramebuffer framebuffer)
+{
+	if (framebuffer == VK_NULL_HANDLE)
+		return;
+	VkDevice device = Device;
+	const VkAllocationCallbacks* allocator = Allocator;
+	Push([dispatch = Dispatch, device, allocator, framebuffer]() { dispatch->DestroyFramebuffer(device, framebuffer, allocator); });
+}
+
+void DeletionQueue::DestroyPipeline(VkPipeline pipeline)
+{
+	if (pipeline == VK_NULL_HANDLE)
+		return;
+	VkDevice device = Device;
+	const VkAllocationCallbacks* allocator = Allocator;
+	Push([dispatch = Dispatch, device, allocator, pipeline]() { dispatch->DestroyPipeline(device, pipeline, allocator); });
+}
+
+void DeletionQueue::DestroyPipelineLayout(VkPipelineLayout pipelineLayout)
+{
+	if (pipelineLayout == VK_NULL_HANDLE)
+		return;
+	VkDevice device = Device;
+	const VkAllocationCallbacks* allocator = Allocator;
+	Push([dispatch = Dispatch, device, allocator, pipelineLayout]() { dispatch->DestroyPipelineLayout(device, pipelineLayout, allocator); });
+}
+
+void DeletionQueue::Flush(uint64_t completedFrameValue)
+{
+	std::lock_guard<std::mutex> lock(Lock);
+	// entries are pushed with increasing frame values, stop at the first one still in flight
+	while (!Pending.empty() && Pending.front().FrameValue <= completedFrameValue)
+	{
+		Pending.front().Destroy();
+		Pending.pop_front();
+	}
+}
+
+void DeletionQueue::FlushAll()
+{
+	std::lock_guard<std::mutex> lock(Lock);
+	while (!Pending.empty())
+	{
+		Pending.front().Destroy();
+		Pending.pop_front();
+	}
+}
+
+bool DeletionQueue::Empty()
+{
+	std::lock_guard<std::mutex> lock(Lock);
+	return Pending.empty();
+}
@@ -0,0 +1,60 @@
+#ifndef DELETION_QUEUE_HPP
+#define DELETION_QUEUE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vulkan/vulkan.h>
+#include "core/api/VulkanDispatch.h"
+
+// Resources the gpu may still be using are not destroyed straight away. They are tagged with
+// the frame value of the next frame to be submitted and destroyed once the gpu has completed it,
+// so we never need a vkDeviceWaitIdle to get rid of them.
+// Push and Flush may run on different threads, the destroy functions run on the flushing one
+class DeletionQueue
+{
+	struct PendingDeletion
+	{
+		uint64_t FrameValue;
+		std::function<void()> Destroy;
+	};
+
+	std::deque<PendingDeletion> Pending;
+	std::mutex Lock;
+	std::atomic<uint64_t> SubmittedFrameValue;
+	VkDevice Device;
+	const VkAllocationCallbacks* Allocator;
+	const VulkanDispatch* Dispatch;// owned by VulkanLib, outlives the queue
+
+public:
+	DeletionQueue();
+	~DeletionQueue();
+	DeletionQueue(const DeletionQueue&) = delete;
+	DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+	// called by the swap chain every time a frame is submitted
+	void SetSubmittedFrameValue(uint64_t frameValue) { SubmittedFrameValue = frameValue; }
+	uint64_t GetSubmittedFrameValue() const { return SubmittedFrameValue; }
+
+	void SetDevice(VkDevice device, const VkAllocationCallbacks* allocator, const VulkanDispatch* dispatch) { Device = device; Allocator = allocator; Dispatch = dispatch; }
+
+	// destroy once the next frame to be submitted has completed. With the present thread a frame
+	// can be halfway recorded while the main thread pushes, so the last submitted one isn't enough
+	void Push(std::function<void()>&& destroy);
+	// helpers for the usual resources, null handles are skipped
+	void DestroyBuffer(VkBuffer buffer, VkDeviceMemory memory = VK_NULL_HANDLE);
+	void DestroyImage(VkImage image, VkImageView view = VK_NULL_HANDLE, VkDeviceMemory memory = VK_NULL_HANDLE);
+	void DestroyImageView(VkImageView view);
+	void DestroyFramebuffer(VkFramebuffer framebuffer);
+	void DestroyPipeline(VkPipeline pipeline);
+	void DestroyPipelineLayout(VkPipelineLayout pipelineLayout);
+	// runs every deletion whose frame the gpu has completed
+	void Flush(uint64_t completedFrameValue);
+	// only when the device is idle (shutdown)
+	void FlushAll();
+	bool Empty();
+};
+
+#endif //DELETION_QUEUE_HPP
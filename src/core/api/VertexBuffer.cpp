@@ -1,8 +1,10 @@
 #include "VertexBuffer.h"
+#include <cstring>
 #include "core/debugger/public/Logger.h"
+#include "core/api/VulkanUploadManager.h"
 
 
-VertexBuffer::VertexBuffer(const VulkanLib& vulkan,const std::vector<float> meshData, int stride,int binding, int descriptions)
+VertexBuffer::VertexBuffer(const VulkanLib& vulkan,const std::vector<float> meshData, int stride,int binding, int descriptions, VulkanUploadManager* uploader)
 	: Vulkan{vulkan}
 	, VertBuffer{}
 	, VertexBufferDeviceMemory{}
@@ -35,18 +37,22 @@ VertexBuffer::VertexBuffer(const VulkanLib& vulkan,const std::vector<float> mesh
 	BindingDescriptions.push_back(bindingDescription);
 	AttribDescriptions.push_back(position);
 	AttribDescriptions.push_back(color);
-	CreateBuffer();
+	if (uploader)
+		CreateStagingBuffer(*uploader);
+	else
+		CreateBuffer();
 }
 
 VertexBuffer::~VertexBuffer()
 {
-	vkDestroyBuffer(Vulkan.GetLogicalDevice(), VertBuffer, nullptr);
-	vkFreeMemory(Vulkan.GetLogicalDevice(), VertexBufferDeviceMemory, nullptr);
+	// frames in flight may still read from it
+	Vulkan.GetDeletionQueue().DestroyBuffer(VertBuffer, VertexBufferDeviceMemory);
 }
 
 
 void VertexBuffer::CreateBuffer()
 {
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
 	VkBufferCreateInfo bufferInfo = {};
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	bufferInfo.size = sizeof(MeshData[0]) * MeshData.size();
@@ -54,44 +60,55 @@ void VertexBuffer::CreateBuffer()
 	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 	bufferInfo.flags = 0;
 
-	VK_CHECK(vkCreateBuffer(Vulkan.GetLogicalDevice(), &bufferInfo, nullptr, &VertBuffer));
+	VK_CHECK(vk.CreateBuffer(Vulkan.GetLogicalDevice(), &bufferInfo, Vulkan.GetAllocator(), &VertBuffer));
 
 	//Allocate memory
 	VkMemoryRequirements memRequirements;
-	vkGetBufferMemoryRequirements(Vulkan.GetLogicalDevice(), VertBuffer, &memRequirements);
+	vk.GetBufferMemoryRequirements(Vulkan.GetLogicalDevice(), VertBuffer, &memRequirements);
 
 	VkMemoryAllocateInfo allocInfo = {};
 	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 	allocInfo.allocationSize = memRequirements.size;
 
-	// Set memory type index
-	VkPhysicalDeviceMemoryProperties memProperties = {};
-	vkGetPhysicalDeviceMemoryProperties(Vulkan.GetGpu(), &memProperties);
-	VkMemoryPropertyFlags propertiesWantedFlags{ VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT };
-	
-	for (int i = 0; i < memProperties.memoryTypeCount; ++i)
-	{
-		if ((memRequirements.memoryTypeBits & (1 << i)) &&
-			(memProperties.memoryTypes[i].propertyFlags & propertiesWantedFlags))
-		{
-			allocInfo.memoryTypeIndex = i;
-			break;
-		}
-	}
-
-	VK_CHECK(vkAllocateMemory(Vulkan.GetLogicalDevice(), &allocInfo, nullptr, &VertexBufferDeviceMemory));
-
-	vkBindBufferMemory(Vulkan.GetLogicalDevice(), VertBuffer, VertexBufferDeviceMemory,0);
+	allocInfo.memoryTypeIndex = Vulkan.FindMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	VK_CHECK(vk.AllocateMemory(Vulkan.GetLogicalDevice(), &allocInfo, Vulkan.GetAllocator(), &VertexBufferDeviceMemory));
+
+	vk.BindBufferMemory(Vulkan.GetLogicalDevice(), VertBuffer, VertexBufferDeviceMemory,0);
 
 	void* data{ nullptr };
-	vkMapMemory(Vulkan.GetLogicalDevice(), VertexBufferDeviceMemory, 0, bufferInfo.size, 0, &data);
+	vk.MapMemory(Vulkan.GetLogicalDevice(), VertexBufferDeviceMemory, 0, bufferInfo.size, 0, &data);
 	std::memcpy(data, MeshData.data(), (std::size_t)bufferInfo.size);
-	vkUnmapMemory(Vulkan.GetLogicalDevice(), VertexBufferDeviceMemory);
+	vk.UnmapMemory(Vulkan.GetLogicalDevice(), VertexBufferDeviceMemory);
 }
 
-void VertexBuffer::CreateStagingBuffer()
+void VertexBuffer::CreateStagingBuffer(VulkanUploadManager& uploader)
 {
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = sizeof(MeshData[0]) * MeshData.size();
+	bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	// exclusive, the upload manager hands it over from the transfer queue
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	bufferInfo.flags = 0;
+
+	VK_CHECK(vk.CreateBuffer(Vulkan.GetLogicalDevice(), &bufferInfo, Vulkan.GetAllocator(), &VertBuffer));
+
+	VkMemoryRequirements memRequirements;
+	vk.GetBufferMemoryRequirements(Vulkan.GetLogicalDevice(), VertBuffer, &memRequirements);
+
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = Vulkan.FindMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	VK_CHECK(vk.AllocateMemory(Vulkan.GetLogicalDevice(), &allocInfo, Vulkan.GetAllocator(), &VertexBufferDeviceMemory));
+
+	vk.BindBufferMemory(Vulkan.GetLogicalDevice(), VertBuffer, VertexBufferDeviceMemory, 0);
 
+	// copied to staging memory now, to the gpu on the next flush
+	uploader.UploadBuffer(VertBuffer, MeshData.data(), bufferInfo.size);
 }
 
 std::vector<VkVertexInputBindingDescription>& VertexBuffer::GetBindingDescriptions()
@@ -101,8 +118,9 @@ std::vector<VkVertexInputBindingDescription>& VertexBuffer::GetBindingDescriptio
 
 void VertexBuffer::BindBuffer(VkCommandBuffer commandBuffer)
 {
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
 	constexpr VkDeviceSize offsets[] = { 0 };
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &VertBuffer, offsets);
+	vk.CmdBindVertexBuffers(commandBuffer, 0, 1, &VertBuffer, offsets);
 }
 
 std::vector<VkVertexInputAttributeDescription>& VertexBuffer::GetAttributeDescriptions()
@@ -4,6 +4,8 @@
 #include <vector>
 #include "core/api/VulkanLib.h"
 
+class VulkanUploadManager;
+
 class VertexBuffer
 {
 
@@ -18,13 +20,16 @@ class VertexBuffer
 	
 public:
 
-	VertexBuffer(const VulkanLib& vulkan, const std::vector<float> meshData,int stride, int binding, int descriptionCount);
+	// with an upload manager the vertices live in device local memory, otherwise in host visible memory
+	VertexBuffer(const VulkanLib& vulkan, const std::vector<float> meshData,int stride, int binding, int descriptionCount, VulkanUploadManager* uploader = nullptr);
 	~VertexBuffer();
 
 	void CreateBuffer();
-	void CreateStagingBuffer();
+	void CreateStagingBuffer(VulkanUploadManager& uploader);
 	void BindBuffer(VkCommandBuffer commandBuffer);
 	int GetVerticesSize() const { return MeshData.size(); }
+	// what vkCmdDraw wants, GetVerticesSize counts floats
+	uint32_t GetVertexCount() const { return (uint32_t)(MeshData.size() * sizeof(float) / Stride); }
 	std::vector<VkVertexInputBindingDescription>& GetBindingDescriptions();
 	std::vector<VkVertexInputAttributeDescription>& GetAttributeDescriptions();
 
@@ -0,0 +1,120 @@
+#include "VulkanAsyncCompute.h"
+#include "core/debugger/public/Logger.h"
+#include "core/api/VulkanLib.h"
+#include "core/api/VulkanSwapChain.h"
+
+VulkanAsyncCompute::VulkanAsyncCompute(const VulkanLib& vulkan, VulkanSwapChain& swapChain, uint32_t slotCount)
+	: Vulkan{ vulkan }
+	, SwapChain{ swapChain }
+	, CommandPool{ VK_NULL_HANDLE }
+	, Slots{}
+	, CurrentSlot{ 0 }
+	, Recording{ false }
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	VkDevice device = Vulkan.GetLogicalDevice();
+
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = Vulkan.GetComputeQueueIndex();
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	VK_CHECK(vk.CreateCommandPool(device, &poolInfo, Vulkan.GetAllocator(), &CommandPool));
+
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = CommandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = 1;
+
+	VkSemaphoreCreateInfo semaphoreInfo = {};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	Slots.resize(slotCount);
+	for (Slot& slot : Slots)
+	{
+		slot = {};
+		VK_CHECK(vk.AllocateCommandBuffers(device, &allocInfo, &slot.Commands));
+		VK_CHECK(vk.CreateSemaphore(device, &semaphoreInfo, Vulkan.GetAllocator(), &slot.Finished));
+	}
+
+	LOG_TRACE("Async compute %s\n", IsAsync() ? "on its own queue" : "on the graphics queue")
+}
+
+VulkanAsyncCompute::~VulkanAsyncCompute()
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	// the owner waits for the device before tearing the engine down
+	VkDevice device = Vulkan.GetLogicalDevice();
+	for (Slot& slot : Slots)
+		vk.DestroySemaphore(device, slot.Finished, Vulkan.GetAllocator());
+	vk.DestroyCommandPool(device, CommandPool, Vulkan.GetAllocator());
+}
+
+bool VulkanAsyncCompute::IsAsync() const
+{
+	return Vulkan.HasDedicatedComputeQueue();
+}
+
+VkCommandBuffer VulkanAsyncCompute::Begin()
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	if (Recording)
+		LOG_ERR("Async compute Begin() called twice without Submit()\n")
+
+	CurrentSlot = (CurrentSlot + 1) % Slots.size();
+	Slot& slot = Slots[CurrentSlot];
+	// the graphics frame that waited on this slot has finished, so has the compute work
+	// and the semaphore wait, both can be reused
+	SwapChain.WaitForFrameValue(slot.FrameValue);
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	VK_CHECK(vk.BeginCommandBuffer(slot.Commands, &beginInfo));
+
+	Recording = true;
+	return slot.Commands;
+}
+
+void VulkanAsyncCompute::Submit(VkPipelineStageFlags graphicsWaitStage, VkSemaphore waitSemaphore, VkPipelineStageFlags waitStage)
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	if (!Recording)
+		LOG_ERR("Async compute Submit() called without Begin()\n")
+
+	Slot& slot = Slots[CurrentSlot];
+	VK_CHECK(vk.EndCommandBuffer(slot.Commands));
+
+	VulkanSubmitBatch& frameBatch = SwapChain.GetFrameBatch();
+	if (!IsAsync())
+	{
+		// Same queue as the frame, ride along in the frame batch instead of a submit of our own.
+		// The semaphore still orders the frame after the compute work and makes its writes visible
+		if (waitSemaphore != VK_NULL_HANDLE)
+			frameBatch.AddWait(waitSemaphore, waitStage);
+		frameBatch.AddCommandBuffer(slot.Commands);
+		frameBatch.AddSignal(slot.Finished);
+	}
+	else
+	{
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		if (waitSemaphore != VK_NULL_HANDLE)
+		{
+			submitInfo.waitSemaphoreCount = 1;
+			submitInfo.pWaitSemaphores = &waitSemaphore;
+			submitInfo.pWaitDstStageMask = &waitStage;
+		}
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &slot.Commands;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &slot.Finished;
+
+		VK_CHECK(Vulkan.QueueSubmit(Vulkan.GetComputeQueue(), 1, &submitInfo, VK_NULL_HANDLE));
+	}
+
+	// the next frame the swap chain submits consumes the results
+	frameBatch.AddWait(slot.Finished, graphicsWaitStage);
+	slot.FrameValue = SwapChain.GetSubmittedFrameValue() + 1;
+	Recording = false;
+}
@@ -0,0 +1,47 @@
+#ifndef VULKAN_ASYNC_COMPUTE_HPP
+#define VULKAN_ASYNC_COMPUTE_HPP
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "defines.h"
+
+class VulkanLib;
+class VulkanSwapChain;
+
+// Records and submits compute work (culling, particles, post-processing...) on the compute queue.
+// Each submit signals a semaphore the next frame waits on before the stages that consume the
+// results, so the compute work of frame N overlaps the rasterization of frame N-1.
+// Buffers the compute work writes while the previous frame still reads them must be per frame slot.
+class VulkanAsyncCompute
+{
+	struct Slot
+	{
+		VkCommandBuffer Commands;
+		VkSemaphore Finished;// waited by the graphics submit of the frame that consumes the results
+		uint64_t FrameValue;// that frame, once it completes the slot can be reused
+	};
+
+	const VulkanLib& Vulkan;
+	VulkanSwapChain& SwapChain;
+	VkCommandPool CommandPool;
+	std::vector<Slot> Slots;
+	uint32_t CurrentSlot;
+	bool Recording;
+
+public:
+	DISABLE_COPY(VulkanAsyncCompute)
+	VulkanAsyncCompute(const VulkanLib& vulkan, VulkanSwapChain& swapChain, uint32_t slotCount = 3);
+	~VulkanAsyncCompute();
+
+	// returns a command buffer ready to record, blocks only if every slot is still in use
+	VkCommandBuffer Begin();
+	// Submits what was recorded since Begin(). The next frame submitted through the swap chain
+	// waits for it at graphicsWaitStage. waitSemaphore lets the compute work wait on another queue
+	void Submit(VkPipelineStageFlags graphicsWaitStage
+		, VkSemaphore waitSemaphore = VK_NULL_HANDLE
+		, VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	bool IsAsync() const;
+};
+
+#endif //VULKAN_ASYNC_COMPUTE_HPP
@@ -0,0 +1,20 @@
+#ifndef VULKAN_CAPABILITIES_HPP
+#define VULKAN_CAPABILITIES_HPP
+
+#include <cstdint>
+
+// Optional features found on the selected gpu and enabled when the logical device is created.
+// Code that has a faster path checks these flags instead of assuming the 1.0 baseline
+struct VulkanCapabilities
+{
+	uint32_t ApiVersion = 0;// lowest of the instance and the gpu versions, what we can really use
+	bool TimelineSemaphore = false;
+	bool DescriptorIndexing = false;
+	bool BufferDeviceAddress = false;
+	bool DynamicRendering = false;
+	bool DrawIndirectCount = false;
+	bool GeometryShader = false;
+	bool PipelineStatisticsQuery = false;
+};
+
+#endif //VULKAN_CAPABILITIES_HPP
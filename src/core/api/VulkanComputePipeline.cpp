@@ -0,0 +1,204 @@
+#include "VulkanComputePipeline.h"
+#include "core/utils/ShaderLoader.h"
+#include "core/debugger/public/Logger.h"
+#include "core/api/VulkanLib.h"
+
+VulkanComputePipeline::VulkanComputePipeline(const VulkanLib& vulkan, const ComputePipelineDesc& desc)
+	: Vulkan{ vulkan }
+	, ComputePipeline{ VK_NULL_HANDLE }
+	, PipelineLayout{ VK_NULL_HANDLE }
+	, SetLayout{ VK_NULL_HANDLE }
+	, DescriptorPool{ VK_NULL_HANDLE }
+	, LocalSize{ desc.LocalSize[0], desc.LocalSize[1], desc.LocalSize[2] }
+	, MaxGroupCount{}
+	, PushConstantSize{ desc.PushConstantSize }
+{
+	if (LocalSize[0] == 0 || LocalSize[1] == 0 || LocalSize[2] == 0)
+		LOG_ERR("Compute local size can't be 0\n")
+
+	VkPhysicalDeviceProperties gpuProperties;
+	Vulkan.GetInstanceDispatch().GetPhysicalDeviceProperties(Vulkan.GetGpu(), &gpuProperties);
+	for (int i = 0; i < 3; ++i)
+		MaxGroupCount[i] = gpuProperties.limits.maxComputeWorkGroupCount[i];
+
+	_CreateLayouts(desc);
+	_CreatePipeline(desc);
+}
+
+VulkanComputePipeline::~VulkanComputePipeline()
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	// dispatches in flight may still use them, destroying the pool frees its sets
+	VkDevice device = Vulkan.GetLogicalDevice();
+	VkDescriptorPool descriptorPool = DescriptorPool;
+	VkDescriptorSetLayout setLayout = SetLayout;
+	Vulkan.GetDeletionQueue().DestroyPipeline(ComputePipeline);
+	Vulkan.GetDeletionQueue().DestroyPipelineLayout(PipelineLayout);
+	const VkAllocationCallbacks* allocator = Vulkan.GetAllocator();
+	Vulkan.GetDeletionQueue().Push([dispatch = &vk, device, allocator, descriptorPool, setLayout]()
+	{
+		dispatch->DestroyDescriptorPool(device, descriptorPool, allocator);
+		dispatch->DestroyDescriptorSetLayout(device, setLayout, allocator);
+	});
+}
+
+void VulkanComputePipeline::_CreateLayouts(const ComputePipelineDesc& desc)
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	VkDevice device = Vulkan.GetLogicalDevice();
+
+	if (desc.StorageBufferCount > 0)
+	{
+		std::vector<VkDescriptorSetLayoutBinding> bindings(desc.StorageBufferCount);
+		for (uint32_t i = 0; i < desc.StorageBufferCount; ++i)
+		{
+			bindings[i] = {};
+			bindings[i].binding = i;
+			bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+
+		VkDescriptorSetLayoutCreateInfo setLayoutInfo = {};
+		setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		setLayoutInfo.bindingCount = (uint32_t)bindings.size();
+		setLayoutInfo.pBindings = bindings.data();
+		VK_CHECK(vk.CreateDescriptorSetLayout(device, &setLayoutInfo, Vulkan.GetAllocator(), &SetLayout));
+
+		VkDescriptorPoolSize poolSize = {};
+		poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSize.descriptorCount = desc.StorageBufferCount * desc.MaxDescriptorSets;
+
+		VkDescriptorPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.maxSets = desc.MaxDescriptorSets;
+		poolInfo.poolSizeCount = 1;
+		poolInfo.pPoolSizes = &poolSize;
+		VK_CHECK(vk.CreateDescriptorPool(device, &poolInfo, Vulkan.GetAllocator(), &DescriptorPool));
+	}
+
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = desc.PushConstantSize;
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = SetLayout != VK_NULL_HANDLE ? 1 : 0;
+	pipelineLayoutInfo.pSetLayouts = &SetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = desc.PushConstantSize > 0 ? 1 : 0;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	VK_CHECK(vk.CreatePipelineLayout(device, &pipelineLayoutInfo, Vulkan.GetAllocator(), &PipelineLayout));
+}
+
+void VulkanComputePipeline::_CreatePipeline(const ComputePipelineDesc& desc)
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	VkShaderModule shaderModule = _CreateShaderModule(ShaderLoader::readFile(desc.ShaderPath));
+
+	VkSpecializationInfo specializationInfo = {};
+	specializationInfo.mapEntryCount = (uint32_t)desc.Specialization.Entries.size();
+	specializationInfo.pMapEntries = desc.Specialization.Entries.data();
+	specializationInfo.dataSize = desc.Specialization.Data.size();
+	specializationInfo.pData = desc.Specialization.Data.data();
+
+	VkPipelineShaderStageCreateInfo stageInfo = {};
+	stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	stageInfo.module = shaderModule;
+	stageInfo.pName = "main";
+	stageInfo.pSpecializationInfo = desc.Specialization.Empty() ? nullptr : &specializationInfo;
+
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage = stageInfo;
+	pipelineInfo.layout = PipelineLayout;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineInfo.basePipelineIndex = -1;
+
+	VK_CHECK(vk.CreateComputePipelines(Vulkan.GetLogicalDevice(), Vulkan.GetPipelineCache(), 1, &pipelineInfo, Vulkan.GetAllocator(), &ComputePipeline));
+
+	vk.DestroyShaderModule(Vulkan.GetLogicalDevice(), shaderModule, Vulkan.GetAllocator());
+}
+
+VkDescriptorSet VulkanComputePipeline::AllocateDescriptorSet()
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	if (DescriptorPool == VK_NULL_HANDLE)
+		LOG_ERR("Compute pipeline created without storage buffers has no descriptor sets\n")
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = DescriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &SetLayout;
+
+	VkDescriptorSet set = VK_NULL_HANDLE;
+	VK_CHECK(vk.AllocateDescriptorSets(Vulkan.GetLogicalDevice(), &allocInfo, &set));
+	return set;
+}
+
+void VulkanComputePipeline::SetStorageBuffer(VkDescriptorSet set, uint32_t binding, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	VkDescriptorBufferInfo bufferInfo = {};
+	bufferInfo.buffer = buffer;
+	bufferInfo.offset = offset;
+	bufferInfo.range = range;
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = set;
+	write.dstBinding = binding;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	write.pBufferInfo = &bufferInfo;
+
+	vk.UpdateDescriptorSets(Vulkan.GetLogicalDevice(), 1, &write, 0, nullptr);
+}
+
+void VulkanComputePipeline::BindPipeline(VkCommandBuffer cmdBuffer)
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	vk.CmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, ComputePipeline);
+}
+
+void VulkanComputePipeline::BindDescriptorSet(VkCommandBuffer cmdBuffer, VkDescriptorSet set)
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	vk.CmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, PipelineLayout, 0, 1, &set, 0, nullptr);
+}
+
+void VulkanComputePipeline::PushConstants(VkCommandBuffer cmdBuffer, const void* data, uint32_t size)
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	if (size > PushConstantSize)
+		LOG_ERR("Push constants bigger than the range the compute pipeline was created with\n")
+	vk.CmdPushConstants(cmdBuffer, PipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, size, data);
+}
+
+void VulkanComputePipeline::Dispatch(VkCommandBuffer cmdBuffer, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	if (groupCountX > MaxGroupCount[0] || groupCountY > MaxGroupCount[1] || groupCountZ > MaxGroupCount[2])
+		LOG_ERR("Dispatch bigger than maxComputeWorkGroupCount, split it or raise the local size\n")
+	vk.CmdDispatch(cmdBuffer, groupCountX, groupCountY, groupCountZ);
+}
+
+void VulkanComputePipeline::DispatchForSize(VkCommandBuffer cmdBuffer, uint32_t sizeX, uint32_t sizeY, uint32_t sizeZ)
+{
+	Dispatch(cmdBuffer, GroupCount(sizeX, LocalSize[0]), GroupCount(sizeY, LocalSize[1]), GroupCount(sizeZ, LocalSize[2]));
+}
+
+VkShaderModule VulkanComputePipeline::_CreateShaderModule(const std::vector<char>& code)
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	VkShaderModuleCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	createInfo.codeSize = code.size();
+	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+	VkShaderModule shaderModule = VK_NULL_HANDLE;
+	VK_CHECK(vk.CreateShaderModule(Vulkan.GetLogicalDevice(), &createInfo, Vulkan.GetAllocator(), &shaderModule));
+	return shaderModule;
+}
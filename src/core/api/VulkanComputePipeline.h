@@ -0,0 +1,86 @@
+#ifndef VULKAN_COMPUTE_PIPELINE_HPP
+#define VULKAN_COMPUTE_PIPELINE_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "defines.h"
+
+class VulkanLib;
+
+// Values for the shader's layout(constant_id = N) constants, baked in at pipeline creation
+struct SpecializationConstants
+{
+	std::vector<VkSpecializationMapEntry> Entries;
+	std::vector<uint8_t> Data;
+
+	// T must match the type of the constant in the shader (bool constants are VkBool32)
+	template<typename T>
+	void Set(uint32_t constantId, const T& value)
+	{
+		VkSpecializationMapEntry entry = {};
+		entry.constantID = constantId;
+		entry.offset = (uint32_t)Data.size();
+		entry.size = sizeof(T);
+		Entries.push_back(entry);
+		Data.resize(Data.size() + sizeof(T));
+		std::memcpy(Data.data() + entry.offset, &value, sizeof(T));
+	}
+	bool Empty() const { return Entries.empty(); }
+};
+
+struct ComputePipelineDesc
+{
+	std::string ShaderPath;// compiled .spv
+	// must match the shader's local_size, a shader using local_size_x_id can get it through Specialization
+	uint32_t LocalSize[3] = { 64, 1, 1 };
+	uint32_t StorageBufferCount = 0;// storage buffers at bindings 0..N-1 of set 0
+	uint32_t PushConstantSize = 0;
+	uint32_t MaxDescriptorSets = 4;// sets AllocateDescriptorSet can hand out, one per frame in flight is typical
+	SpecializationConstants Specialization;
+};
+
+// Compute counterpart of VulkanPipeline: one compute stage, its descriptor set layout,
+// pipeline layout and a small descriptor pool for its storage buffers
+class VulkanComputePipeline
+{
+	const VulkanLib& Vulkan;
+	VkPipeline ComputePipeline;
+	VkPipelineLayout PipelineLayout;
+	VkDescriptorSetLayout SetLayout;
+	VkDescriptorPool DescriptorPool;
+	uint32_t LocalSize[3];
+	uint32_t MaxGroupCount[3];
+	uint32_t PushConstantSize;
+
+	VkShaderModule _CreateShaderModule(const std::vector<char>& code);
+	void _CreateLayouts(const ComputePipelineDesc& desc);
+	void _CreatePipeline(const ComputePipelineDesc& desc);
+
+public:
+	DISABLE_COPY(VulkanComputePipeline)
+	VulkanComputePipeline(const VulkanLib& vulkan, const ComputePipelineDesc& desc);
+	~VulkanComputePipeline();
+
+	VkDescriptorSet AllocateDescriptorSet();
+	void SetStorageBuffer(VkDescriptorSet set, uint32_t binding, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+
+	void BindPipeline(VkCommandBuffer cmdBuffer);
+	void BindDescriptorSet(VkCommandBuffer cmdBuffer, VkDescriptorSet set);
+	void PushConstants(VkCommandBuffer cmdBuffer, const void* data, uint32_t size);
+	// raw group counts
+	void Dispatch(VkCommandBuffer cmdBuffer, uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1);
+	// one invocation per element: group counts are the problem size divided by the local size, rounded up,
+	// the shader must discard the invocations past the end
+	void DispatchForSize(VkCommandBuffer cmdBuffer, uint32_t sizeX, uint32_t sizeY = 1, uint32_t sizeZ = 1);
+	// in 64 bits, size + localSize - 1 wraps around for sizes near UINT32_MAX
+	static uint32_t GroupCount(uint32_t size, uint32_t localSize) { return (uint32_t)(((uint64_t)size + localSize - 1) / localSize); }
+
+	VkPipeline GetPipeline() const { return ComputePipeline; }
+	VkPipelineLayout GetPipelineLayout() const { return PipelineLayout; }
+	VkDescriptorSetLayout GetDescriptorSetLayout() const { return SetLayout; }
+};
+
+#endif //VULKAN_COMPUTE_PIPELINE_HPP
@@ -0,0 +1,34 @@
+#include "VulkanDispatch.h"
+
+bool VulkanInstanceDispatch::Load(VkInstance instance)
+{
+	bool complete = true;
+#define VULKAN_LOAD_REQUIRED(name) \
+	name = (PFN_vk##name)vkGetInstanceProcAddr(instance, "vk" #name); \
+	complete = complete && name != nullptr;
+#define VULKAN_LOAD_OPTIONAL(name) name = (PFN_vk##name)vkGetInstanceProcAddr(instance, "vk" #name);
+	VULKAN_INSTANCE_FUNCTIONS(VULKAN_LOAD_REQUIRED)
+	VULKAN_OPTIONAL_INSTANCE_FUNCTIONS(VULKAN_LOAD_OPTIONAL)
+#undef VULKAN_LOAD_REQUIRED
+#undef VULKAN_LOAD_OPTIONAL
+	return complete;
+}
+
+bool VulkanDispatch::Load(const VulkanInstanceDispatch& instance, VkDevice device)
+{
+	// the device's own vkGetDeviceProcAddr, the exported one is a trampoline too
+	PFN_vkGetDeviceProcAddr getDeviceProcAddr = instance.GetDeviceProcAddr;
+	if (!getDeviceProcAddr)
+		return false;
+
+	bool complete = true;
+#define VULKAN_LOAD_REQUIRED(name) \
+	name = (PFN_vk##name)getDeviceProcAddr(device, "vk" #name); \
+	complete = complete && name != nullptr;
+#define VULKAN_LOAD_OPTIONAL(name) name = (PFN_vk##name)getDeviceProcAddr(device, "vk" #name);
+	VULKAN_DEVICE_FUNCTIONS(VULKAN_LOAD_REQUIRED)
+	VULKAN_OPTIONAL_DEVICE_FUNCTIONS(VULKAN_LOAD_OPTIONAL)
+#undef VULKAN_LOAD_REQUIRED
+#undef VULKAN_LOAD_OPTIONAL
+	return complete;
+}
@@ -0,0 +1,144 @@
+#ifndef VULKAN_DISPATCH_HPP
+#define VULKAN_DISPATCH_HPP
+
+#include <vulkan/vulkan.h>
+
+// Every device level command the engine calls, without the vk prefix. Add new ones here
+#define VULKAN_DEVICE_FUNCTIONS(X) \
+	X(DestroyDevice) \
+	X(GetDeviceQueue) \
+	X(DeviceWaitIdle) \
+	X(QueueSubmit) \
+	X(QueueWaitIdle) \
+	X(AllocateMemory) \
+	X(FreeMemory) \
+	X(MapMemory) \
+	X(UnmapMemory) \
+	X(BindBufferMemory) \
+	X(BindImageMemory) \
+	X(GetBufferMemoryRequirements) \
+	X(GetImageMemoryRequirements) \
+	X(CreateBuffer) \
+	X(DestroyBuffer) \
+	X(CreateImage) \
+	X(DestroyImage) \
+	X(CreateImageView) \
+	X(DestroyImageView) \
+	X(CreateFence) \
+	X(DestroyFence) \
+	X(ResetFences) \
+	X(GetFenceStatus) \
+	X(WaitForFences) \
+	X(CreateSemaphore) \
+	X(DestroySemaphore) \
+	X(CreateQueryPool) \
+	X(DestroyQueryPool) \
+	X(GetQueryPoolResults) \
+	X(CreateShaderModule) \
+	X(DestroyShaderModule) \
+	X(CreatePipelineCache) \
+	X(DestroyPipelineCache) \
+	X(GetPipelineCacheData) \
+	X(CreateGraphicsPipelines) \
+	X(CreateComputePipelines) \
+	X(DestroyPipeline) \
+	X(CreatePipelineLayout) \
+	X(DestroyPipelineLayout) \
+	X(CreateDescriptorSetLayout) \
+	X(DestroyDescriptorSetLayout) \
+	X(CreateDescriptorPool) \
+	X(DestroyDescriptorPool) \
+	X(AllocateDescriptorSets) \
+	X(UpdateDescriptorSets) \
+	X(CreateFramebuffer) \
+	X(DestroyFramebuffer) \
+	X(CreateRenderPass) \
+	X(DestroyRenderPass) \
+	X(CreateCommandPool) \
+	X(DestroyCommandPool) \
+	X(AllocateCommandBuffers) \
+	X(FreeCommandBuffers) \
+	X(BeginCommandBuffer) \
+	X(EndCommandBuffer) \
+	X(CmdBindPipeline) \
+	X(CmdSetViewport) \
+	X(CmdSetScissor) \
+	X(CmdBindDescriptorSets) \
+	X(CmdBindVertexBuffers) \
+	X(CmdDraw) \
+	X(CmdDispatch) \
+	X(CmdCopyBuffer) \
+	X(CmdCopyBufferToImage) \
+	X(CmdPipelineBarrier) \
+	X(CmdBeginQuery) \
+	X(CmdEndQuery) \
+	X(CmdResetQueryPool) \
+	X(CmdWriteTimestamp) \
+	X(CmdPushConstants) \
+	X(CmdBeginRenderPass) \
+	X(CmdEndRenderPass)
+
+// only there when the device has the feature or extension, null otherwise
+#define VULKAN_OPTIONAL_DEVICE_FUNCTIONS(X) \
+	X(GetSemaphoreCounterValue) \
+	X(WaitSemaphores) \
+	X(CreateSwapchainKHR) \
+	X(DestroySwapchainKHR) \
+	X(GetSwapchainImagesKHR) \
+	X(AcquireNextImageKHR) \
+	X(QueuePresentKHR)
+
+// Instance and physical device commands the engine calls once the instance exists. The global
+// ones (vkCreateInstance, vkEnumerateInstance*) have no instance to load them with
+#define VULKAN_INSTANCE_FUNCTIONS(X) \
+	X(DestroyInstance) \
+	X(EnumeratePhysicalDevices) \
+	X(GetPhysicalDeviceProperties) \
+	X(GetPhysicalDeviceFeatures) \
+	X(GetPhysicalDeviceFormatProperties) \
+	X(GetPhysicalDeviceMemoryProperties) \
+	X(GetPhysicalDeviceQueueFamilyProperties) \
+	X(EnumerateDeviceExtensionProperties) \
+	X(CreateDevice) \
+	X(GetDeviceProcAddr)
+
+// null without a 1.1 instance or the surface extension (headless)
+#define VULKAN_OPTIONAL_INSTANCE_FUNCTIONS(X) \
+	X(GetPhysicalDeviceFeatures2) \
+	X(DestroySurfaceKHR) \
+	X(GetPhysicalDeviceSurfaceSupportKHR) \
+	X(GetPhysicalDeviceSurfaceCapabilitiesKHR) \
+	X(GetPhysicalDeviceSurfaceFormatsKHR) \
+	X(GetPhysicalDeviceSurfacePresentModesKHR)
+
+// Instance commands from vkGetInstanceProcAddr(instance, ...), they skip the loader's lookup of
+// the instance the same way VulkanDispatch does for the device. Filled by VulkanLib right after
+// the instance is created, use it through VulkanLib::GetInstanceDispatch
+struct VulkanInstanceDispatch
+{
+#define VULKAN_DISPATCH_MEMBER(name) PFN_vk##name name = nullptr;
+	VULKAN_INSTANCE_FUNCTIONS(VULKAN_DISPATCH_MEMBER)
+	VULKAN_OPTIONAL_INSTANCE_FUNCTIONS(VULKAN_DISPATCH_MEMBER)
+#undef VULKAN_DISPATCH_MEMBER
+
+	// false when a required command is missing
+	bool Load(VkInstance instance);
+};
+
+// Device commands straight from the driver (vkGetDeviceProcAddr). The vk* exports of the loader
+// are trampolines that look up the dispatch table of the handle on every call, these skip that.
+// Matters for the command buffer calls, thousands of them per frame. Filled by VulkanLib after
+// the device is created, use it through VulkanLib::GetDispatch: vk.CmdDraw(...)
+struct VulkanDispatch
+{
+#define VULKAN_DISPATCH_MEMBER(name) PFN_vk##name name = nullptr;
+	VULKAN_DEVICE_FUNCTIONS(VULKAN_DISPATCH_MEMBER)
+	VULKAN_OPTIONAL_DEVICE_FUNCTIONS(VULKAN_DISPATCH_MEMBER)
+#undef VULKAN_DISPATCH_MEMBER
+
+	// false when a required command is missing. DestroyDevice is loaded first, so the device can
+	// still be destroyed when another command is missing
+	bool Load(const VulkanInstanceDispatch& instance, VkDevice device);
+};
+
+#endif //VULKAN_DISPATCH_HPP
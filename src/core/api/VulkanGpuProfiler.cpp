@@ -0,0 +1,267 @@
+#include "VulkanGpuProfiler.h"
+#include <algorithm>
+#include "core/debugger/public/Logger.h"
+#include "core/api/VulkanLib.h"
+
+VulkanGpuProfiler::VulkanGpuProfiler(const VulkanLib& vulkan, uint32_t slotCount, uint32_t maxScopesPerFrame, bool pipelineStatistics)
+	: Vulkan{ vulkan }
+	, MaxScopesPerFrame{ maxScopesPerFrame > 0 ? maxScopesPerFrame : 1 }
+	, TimestampPeriodMs{ 0.0 }
+	, TimestampMask{ 0 }
+	, PipelineStatistics{ false }
+	, Frames{}
+	, RecordingSlot{ UINT32_MAX }
+	, ResultBuffer{}
+	, StatsMutex{}
+	, Stats{}
+	, Resolved{}
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	const VulkanInstanceDispatch& vki = Vulkan.GetInstanceDispatch();
+	VkPhysicalDeviceProperties gpuProperties;
+	vki.GetPhysicalDeviceProperties(Vulkan.GetGpu(), &gpuProperties);
+	uint32_t familyCount = 0;
+	vki.GetPhysicalDeviceQueueFamilyProperties(Vulkan.GetGpu(), &familyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(familyCount);
+	vki.GetPhysicalDeviceQueueFamilyProperties(Vulkan.GetGpu(), &familyCount, queueFamilies.data());
+
+	uint32_t validBits = queueFamilies[Vulkan.GetGraphicsQueueIndex()].timestampValidBits;
+	if (validBits == 0)
+	{
+		LOG_WARN("The graphics queue has no timestamps, the gpu profiler is disabled\n")
+		return;
+	}
+	TimestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+	TimestampPeriodMs = gpuProperties.limits.timestampPeriod / 1000000.0;
+
+	PipelineStatistics = pipelineStatistics && Vulkan.GetCapabilities().PipelineStatisticsQuery;
+	if (pipelineStatistics && !PipelineStatistics)
+		LOG_WARN("No pipeline statistics queries on this gpu, only timestamps are profiled\n")
+
+	VkDevice device = Vulkan.GetLogicalDevice();
+	Frames.resize(slotCount > 0 ? slotCount : 1);
+	for (FrameQueries& frame : Frames)
+	{
+		VkQueryPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		poolInfo.queryCount = MaxScopesPerFrame * 2;
+		VK_CHECK(vk.CreateQueryPool(device, &poolInfo, Vulkan.GetAllocator(), &frame.Timestamps));
+
+		frame.Statistics = VK_NULL_HANDLE;
+		if (PipelineStatistics)
+		{
+			poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+			poolInfo.queryCount = MaxScopesPerFrame;
+			poolInfo.pipelineStatistics = _StatisticFlags();
+			VK_CHECK(vk.CreateQueryPool(device, &poolInfo, Vulkan.GetAllocator(), &frame.Statistics));
+		}
+		frame.Scopes.reserve(MaxScopesPerFrame);
+		frame.TimestampCount = 0;
+		frame.StatisticsCount = 0;
+		frame.Pending = false;
+	}
+	// value and availability of each query, the bigger of the two pools
+	ResultBuffer.resize(std::max(MaxScopesPerFrame * 2 * 2, MaxScopesPerFrame * (STATISTICS_COUNT + 1)));
+}
+
+VulkanGpuProfiler::~VulkanGpuProfiler()
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	// frames in flight may still write to them
+	VkDevice device = Vulkan.GetLogicalDevice();
+	const VkAllocationCallbacks* allocator = Vulkan.GetAllocator();
+	for (const FrameQueries& frame : Frames)
+	{
+		VkQueryPool timestamps = frame.Timestamps;
+		VkQueryPool statistics = frame.Statistics;
+		Vulkan.GetDeletionQueue().Push([dispatch = &vk, device, allocator, timestamps, statistics]()
+		{
+			dispatch->DestroyQueryPool(device, timestamps, allocator);
+			dispatch->DestroyQueryPool(device, statistics, allocator);
+		});
+	}
+}
+
+void VulkanGpuProfiler::_Accumulate(double& average, double sample)
+{
+	average = average == 0.0 ? sample : average + (sample - average) * SMOOTHING;
+}
+
+VkQueryPipelineStatisticFlags VulkanGpuProfiler::_StatisticFlags()
+{
+	// results come in bit order, ResolveFrame reads them in this order
+	return VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT
+		| VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+		| VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT
+		| VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT
+		| VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+}
+
+uint32_t VulkanGpuProfiler::RegisterScope(const char* name)
+{
+	std::lock_guard<std::mutex> lock(StatsMutex);
+	for (uint32_t i = 0; i < (uint32_t)Stats.size(); ++i)
+	{
+		if (Stats[i].Name == name)
+			return i;
+	}
+	GpuScopeStats scope;
+	scope.Name = name;
+	Stats.push_back(scope);
+	Resolved.push_back(0);
+	return (uint32_t)Stats.size() - 1;
+}
+
+void VulkanGpuProfiler::BeginFrame(VkCommandBuffer commandBuffer, uint32_t slot)
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	RecordingSlot = UINT32_MAX;
+	if (!IsEnabled() || slot >= Frames.size())
+		return;
+
+	FrameQueries& frame = Frames[slot];
+	if (frame.Pending)
+		ResolveFrame(slot);
+
+	// queries must be reset before they are written again
+	vk.CmdResetQueryPool(commandBuffer, frame.Timestamps, 0, MaxScopesPerFrame * 2);
+	if (frame.Statistics)
+		vk.CmdResetQueryPool(commandBuffer, frame.Statistics, 0, MaxScopesPerFrame);
+
+	frame.Scopes.clear();
+	frame.TimestampCount = 0;
+	frame.StatisticsCount = 0;
+	frame.Pending = true;
+	RecordingSlot = slot;
+}
+
+void VulkanGpuProfiler::BeginScope(VkCommandBuffer commandBuffer, uint32_t scopeId, bool statistics, VkPipelineStageFlagBits stage)
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	if (RecordingSlot == UINT32_MAX)
+		return;
+	FrameQueries& frame = Frames[RecordingSlot];
+	// out of queries, the scope is not measured this frame
+	if (frame.TimestampCount + 2 > MaxScopesPerFrame * 2)
+		return;
+
+	ScopeQueries scope = {};
+	scope.ScopeId = scopeId;
+	scope.TimestampQuery = frame.TimestampCount;
+	scope.StatisticsQuery = UINT32_MAX;
+	scope.Ended = false;
+	frame.TimestampCount += 2;
+	vk.CmdWriteTimestamp(commandBuffer, stage, frame.Timestamps, scope.TimestampQuery);
+
+	if (statistics && frame.Statistics)
+	{
+		scope.StatisticsQuery = frame.StatisticsCount++;
+		vk.CmdBeginQuery(commandBuffer, frame.Statistics, scope.StatisticsQuery, 0);
+	}
+	frame.Scopes.push_back(scope);
+}
+
+void VulkanGpuProfiler::EndScope(VkCommandBuffer commandBuffer, uint32_t scopeId, VkPipelineStageFlagBits stage)
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	if (RecordingSlot == UINT32_MAX)
+		return;
+	FrameQueries& frame = Frames[RecordingSlot];
+
+	// the innermost open scope with that id
+	for (std::size_t i = frame.Scopes.size(); i-- > 0;)
+	{
+		ScopeQueries& scope = frame.Scopes[i];
+		if (scope.ScopeId != scopeId || scope.Ended)
+			continue;
+
+		if (scope.StatisticsQuery != UINT32_MAX)
+			vk.CmdEndQuery(commandBuffer, frame.Statistics, scope.StatisticsQuery);
+		vk.CmdWriteTimestamp(commandBuffer, stage, frame.Timestamps, scope.TimestampQuery + 1);
+		scope.Ended = true;
+		return;
+	}
+}
+
+bool VulkanGpuProfiler::ResolveFrame(uint32_t slot)
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	if (!IsEnabled() || slot >= Frames.size() || !Frames[slot].Pending)
+		return false;
+	FrameQueries& frame = Frames[slot];
+	frame.Pending = false;
+	{
+		std::lock_guard<std::mutex> lock(StatsMutex);
+		std::fill(Resolved.begin(), Resolved.end(), (uint8_t)0);
+	}
+	if (frame.TimestampCount == 0)
+		return false;
+
+	VkDevice device = Vulkan.GetLogicalDevice();
+	const VkQueryResultFlags flags = VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT;
+	std::vector<uint64_t>& results = ResultBuffer;
+
+	// scopes that were never ended leave their queries unavailable, NOT_READY only means that
+	VkResult result = vk.GetQueryPoolResults(device, frame.Timestamps, 0, frame.TimestampCount
+		, frame.TimestampCount * 2 * sizeof(uint64_t), results.data(), 2 * sizeof(uint64_t), flags);
+	if (result != VK_SUCCESS && result != VK_NOT_READY)
+		return false;
+
+	std::lock_guard<std::mutex> lock(StatsMutex);
+	for (const ScopeQueries& scope : frame.Scopes)
+	{
+		const uint64_t* begin = &results[scope.TimestampQuery * 2];
+		const uint64_t* end = begin + 2;
+		if (!begin[1] || !end[1] || scope.ScopeId >= Stats.size())
+			continue;
+
+		GpuScopeStats& stats = Stats[scope.ScopeId];
+		stats.LastMs = (double)((end[0] - begin[0]) & TimestampMask) * TimestampPeriodMs;
+		_Accumulate(stats.AverageMs, stats.LastMs);
+		++stats.Samples;
+		Resolved[scope.ScopeId] = 1;
+	}
+
+	if (frame.StatisticsCount > 0)
+	{
+		const uint32_t stride = STATISTICS_COUNT + 1;
+		result = vk.GetQueryPoolResults(device, frame.Statistics, 0, frame.StatisticsCount
+			, frame.StatisticsCount * stride * sizeof(uint64_t), results.data(), stride * sizeof(uint64_t), flags);
+		if (result == VK_SUCCESS || result == VK_NOT_READY)
+		{
+			for (const ScopeQueries& scope : frame.Scopes)
+			{
+				if (scope.StatisticsQuery == UINT32_MAX || scope.ScopeId >= Stats.size())
+					continue;
+				const uint64_t* values = &results[scope.StatisticsQuery * stride];
+				if (!values[STATISTICS_COUNT])
+					continue;
+
+				GpuScopeStats& stats = Stats[scope.ScopeId];
+				stats.HasStatistics = true;
+				_Accumulate(stats.InputAssemblyPrimitives, (double)values[0]);
+				_Accumulate(stats.VertexShaderInvocations, (double)values[1]);
+				_Accumulate(stats.ClippingPrimitives, (double)values[2]);
+				_Accumulate(stats.FragmentShaderInvocations, (double)values[3]);
+				_Accumulate(stats.ComputeShaderInvocations, (double)values[4]);
+			}
+		}
+	}
+	return true;
+}
+
+bool VulkanGpuProfiler::GetLastMs(uint32_t scopeId, double& ms) const
+{
+	std::lock_guard<std::mutex> lock(StatsMutex);
+	if (scopeId >= Stats.size() || !Resolved[scopeId])
+		return false;
+	ms = Stats[scopeId].LastMs;
+	return true;
+}
+
+std::vector<GpuScopeStats> VulkanGpuProfiler::GetScopeStats() const
+{
+	std::lock_guard<std::mutex> lock(StatsMutex);
+	return Stats;
+}
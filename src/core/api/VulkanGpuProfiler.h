@@ -0,0 +1,103 @@
+#ifndef VULKAN_GPU_PROFILER_HPP
+#define VULKAN_GPU_PROFILER_HPP
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "defines.h"
+
+class VulkanLib;
+
+// Moving averages of a named scope, the statistics are per frame counts and only filled for
+// scopes that asked for them on a gpu with pipelineStatisticsQuery
+struct GpuScopeStats
+{
+	std::string Name;
+	double AverageMs = 0.0;
+	double LastMs = 0.0;
+	uint64_t Samples = 0;
+	bool HasStatistics = false;
+	double InputAssemblyPrimitives = 0.0;
+	double VertexShaderInvocations = 0.0;
+	double ClippingPrimitives = 0.0;
+	double FragmentShaderInvocations = 0.0;
+	double ComputeShaderInvocations = 0.0;
+};
+
+// Timestamps (and optionally pipeline statistics) around named scopes of the graphics queue.
+// Each frame slot has its own query pools, a slot is read back once its frame is done on the
+// gpu, right before the slot is recorded again, so reading never waits.
+//   uint32_t pass = profiler.RegisterScope("opaque");// once
+//   profiler.BeginFrame(cmd, slot);// first thing in the frame, resets the slot's queries
+//   profiler.BeginScope(cmd, pass); ... profiler.EndScope(cmd, pass);
+class VulkanGpuProfiler
+{
+	static constexpr double SMOOTHING = 0.05;
+	static constexpr uint32_t STATISTICS_COUNT = 5;// see _StatisticFlags
+
+	struct ScopeQueries
+	{
+		uint32_t ScopeId;
+		uint32_t TimestampQuery;// begin, the end is the next one
+		uint32_t StatisticsQuery;// UINT32_MAX without statistics
+		bool Ended;
+	};
+
+	struct FrameQueries
+	{
+		VkQueryPool Timestamps;
+		VkQueryPool Statistics;
+		std::vector<ScopeQueries> Scopes;// in BeginScope order
+		uint32_t TimestampCount;
+		uint32_t StatisticsCount;
+		bool Pending;// recorded and not read back yet
+	};
+
+	const VulkanLib& Vulkan;
+	uint32_t MaxScopesPerFrame;
+	double TimestampPeriodMs;
+	uint64_t TimestampMask;// timestampValidBits of the graphics queue
+	bool PipelineStatistics;
+	std::vector<FrameQueries> Frames;
+	uint32_t RecordingSlot;// slot of the last BeginFrame
+	std::vector<uint64_t> ResultBuffer;
+	// scope stats are written by the thread rendering the frames and read from anywhere
+	mutable std::mutex StatsMutex;
+	std::vector<GpuScopeStats> Stats;
+	std::vector<uint8_t> Resolved;// by scope id, measured by the last ResolveFrame
+
+	static void _Accumulate(double& average, double sample);
+	static VkQueryPipelineStatisticFlags _StatisticFlags();
+
+public:
+	DISABLE_COPY(VulkanGpuProfiler)
+	// slotCount: frame slots the caller cycles through. Statistics are dropped when the gpu
+	// doesn't support them
+	VulkanGpuProfiler(const VulkanLib& vulkan, uint32_t slotCount, uint32_t maxScopesPerFrame = 32, bool pipelineStatistics = false);
+	~VulkanGpuProfiler();
+
+	// false without timestamp support on the graphics queue, the calls below do nothing then
+	bool IsEnabled() const { return !Frames.empty(); }
+	// ids are stable, call it once per scope name and keep the id around
+	uint32_t RegisterScope(const char* name);
+	// reads the slot back if it wasn't yet and resets its queries, outside any render pass.
+	// Scopes can be recorded in this and any later submitted command buffer of the frame
+	void BeginFrame(VkCommandBuffer commandBuffer, uint32_t slot);
+	// timestamps from TOP_OF_PIPE to BOTTOM_OF_PIPE by default. Statistics scopes can't nest
+	// and must begin and end in the same subpass (or both outside render passes)
+	void BeginScope(VkCommandBuffer commandBuffer, uint32_t scopeId, bool statistics = false
+		, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+	void EndScope(VkCommandBuffer commandBuffer, uint32_t scopeId, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+	// the frame that last recorded the slot must be done on the gpu. Returns false if there was
+	// nothing to read. Updates the averages and the LastMs of the scopes in the frame, scopes
+	// whose queries had no result keep their old values
+	bool ResolveFrame(uint32_t slot);
+	// LastMs of one scope, false when the last ResolveFrame didn't measure it: ms is left alone
+	// then, the old LastMs belongs to an older frame
+	bool GetLastMs(uint32_t scopeId, double& ms) const;
+	std::vector<GpuScopeStats> GetScopeStats() const;
+};
+
+#endif //VULKAN_GPU_PROFILER_HPP
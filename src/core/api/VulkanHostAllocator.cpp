@@ -0,0 +1,231 @@
+#include "VulkanHostAllocator.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace
+{
+	// in front of every allocation, Free and Reallocation only get the pointer
+	struct AllocationHeader
+	{
+		void* Base;// what malloc returned, null for arena allocations
+		uint64_t Size;
+		struct ThreadArena* Arena;
+		uint32_t Scope;
+	};
+	constexpr std::size_t HEADER_SIZE = 32;
+	constexpr std::size_t MIN_ALIGNMENT = 16;
+	static_assert(sizeof(AllocationHeader) <= HEADER_SIZE, "the header doesn't fit");
+
+	// One block with the arena memory behind it, malloc'd so the allocation tracker doesn't count it.
+	// Not a thread_local itself: a command scope allocation can outlive its thread, the free then
+	// still has to reach the arena
+	struct ThreadArena
+	{
+		static constexpr uint32_t EXITED = 1u << 31;
+
+		std::size_t Offset = 0;// owner thread only
+		std::atomic<uint32_t> State{ 0 };// live allocations, EXITED once the thread is gone. A free can come from another thread
+		uint8_t* Memory = nullptr;
+	};
+
+	ThreadArena* _CreateArena()
+	{
+		void* block = malloc(sizeof(ThreadArena) + VulkanHostAllocator::ARENA_SIZE);
+		if (!block)
+			return nullptr;
+		ThreadArena* arena = new (block) ThreadArena;
+		arena->Memory = static_cast<uint8_t*>(block) + sizeof(ThreadArena);
+		return arena;
+	}
+
+	// state: after the caller's change. Whoever sees the last allocation of an exited thread go frees the arena
+	void _ReleaseArenaIfDone(ThreadArena* arena, uint32_t state)
+	{
+		if (state == ThreadArena::EXITED)
+		{
+			arena->~ThreadArena();
+			free(arena);
+		}
+	}
+
+	struct ThreadArenaOwner
+	{
+		ThreadArena* Arena = nullptr;
+		bool Exited = false;// callbacks from later thread_local destructors go to the heap
+
+		~ThreadArenaOwner()
+		{
+			Exited = true;
+			if (Arena)
+				_ReleaseArenaIfDone(Arena, Arena->State.fetch_or(ThreadArena::EXITED, std::memory_order_acq_rel) | ThreadArena::EXITED);
+			Arena = nullptr;
+		}
+	};
+
+	thread_local ThreadArenaOwner ArenaOwner;
+
+	uint8_t* _AlignUp(uint8_t* pointer, std::size_t alignment)
+	{
+		return reinterpret_cast<uint8_t*>((reinterpret_cast<uintptr_t>(pointer) + alignment - 1) & ~(uintptr_t)(alignment - 1));
+	}
+
+	AllocationHeader* _GetHeader(void* memory)
+	{
+		return reinterpret_cast<AllocationHeader*>(static_cast<uint8_t*>(memory) - HEADER_SIZE);
+	}
+
+	void _UpdatePeak(std::atomic<uint64_t>& peak, uint64_t value)
+	{
+		uint64_t current = peak.load(std::memory_order_relaxed);
+		while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed))
+		{
+		}
+	}
+}
+
+VulkanHostAllocator::VulkanHostAllocator()
+	: Scopes{}
+	, InternalBytes{ 0 }
+	, ArenaAllocations{ 0 }
+	, ArenaFallbacks{ 0 }
+	, Callbacks{}
+{
+	Callbacks.pUserData = this;
+	Callbacks.pfnAllocation = &VulkanHostAllocator::_OnAllocation;
+	Callbacks.pfnReallocation = &VulkanHostAllocator::_OnReallocation;
+	Callbacks.pfnFree = &VulkanHostAllocator::_OnFree;
+	Callbacks.pfnInternalAllocation = &VulkanHostAllocator::_OnInternalAllocation;
+	Callbacks.pfnInternalFree = &VulkanHostAllocator::_OnInternalFree;
+}
+
+void* VulkanHostAllocator::_Allocate(std::size_t size, std::size_t alignment, VkSystemAllocationScope scope)
+{
+	if (size == 0)
+		return nullptr;
+
+	alignment = std::max(alignment, MIN_ALIGNMENT);
+	std::size_t total = size + alignment + HEADER_SIZE;
+	uint8_t* memory = nullptr;
+	ThreadArena* arena = nullptr;
+	void* base = nullptr;
+
+	if (scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND)
+	{
+		if (!ArenaOwner.Arena && !ArenaOwner.Exited)
+			ArenaOwner.Arena = _CreateArena();
+		ThreadArena* threadArena = ArenaOwner.Arena;
+		// everything in the arena is gone, start over from the beginning
+		if (threadArena && threadArena->State.load(std::memory_order_acquire) == 0)
+			threadArena->Offset = 0;
+
+		if (threadArena && threadArena->Offset + total <= ARENA_SIZE)
+		{
+			memory = _AlignUp(threadArena->Memory + threadArena->Offset + HEADER_SIZE, alignment);
+			threadArena->Offset = (std::size_t)(memory + size - threadArena->Memory);
+			threadArena->State.fetch_add(1, std::memory_order_relaxed);
+			arena = threadArena;
+			ArenaAllocations.fetch_add(1, std::memory_order_relaxed);
+		}
+		else
+		{
+			ArenaFallbacks.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	if (!memory)
+	{
+		base = malloc(total);
+		if (!base)
+			return nullptr;// the driver turns it into VK_ERROR_OUT_OF_HOST_MEMORY
+		memory = _AlignUp(static_cast<uint8_t*>(base) + HEADER_SIZE, alignment);
+	}
+
+	AllocationHeader* header = _GetHeader(memory);
+	header->Base = base;
+	header->Size = size;
+	header->Arena = arena;
+	header->Scope = (uint32_t)scope < HostAllocationStats::SCOPE_COUNT ? (uint32_t)scope : (uint32_t)VK_SYSTEM_ALLOCATION_SCOPE_OBJECT;
+
+	ScopeCounters& counters = Scopes[header->Scope];
+	counters.LiveAllocations.fetch_add(1, std::memory_order_relaxed);
+	counters.TotalAllocations.fetch_add(1, std::memory_order_relaxed);
+	_UpdatePeak(counters.PeakBytes, counters.LiveBytes.fetch_add(size, std::memory_order_relaxed) + size);
+	return memory;
+}
+
+void VulkanHostAllocator::_Free(void* memory)
+{
+	if (!memory)
+		return;
+
+	AllocationHeader* header = _GetHeader(memory);
+	ScopeCounters& counters = Scopes[header->Scope];
+	counters.LiveAllocations.fetch_sub(1, std::memory_order_relaxed);
+	counters.LiveBytes.fetch_sub(header->Size, std::memory_order_relaxed);
+
+	if (header->Arena)
+	{
+		ThreadArena* arena = header->Arena;
+		_ReleaseArenaIfDone(arena, arena->State.fetch_sub(1, std::memory_order_acq_rel) - 1);
+	}
+	else
+		free(header->Base);
+}
+
+VKAPI_ATTR void* VKAPI_CALL VulkanHostAllocator::_OnAllocation(void* userData, std::size_t size, std::size_t alignment, VkSystemAllocationScope scope)
+{
+	return static_cast<VulkanHostAllocator*>(userData)->_Allocate(size, alignment, scope);
+}
+
+VKAPI_ATTR void* VKAPI_CALL VulkanHostAllocator::_OnReallocation(void* userData, void* original, std::size_t size, std::size_t alignment, VkSystemAllocationScope scope)
+{
+	VulkanHostAllocator* allocator = static_cast<VulkanHostAllocator*>(userData);
+	if (!original)
+		return allocator->_Allocate(size, alignment, scope);
+	if (size == 0)
+	{
+		allocator->_Free(original);
+		return nullptr;
+	}
+
+	// the original must survive a failed reallocation
+	void* memory = allocator->_Allocate(size, alignment, scope);
+	if (!memory)
+		return nullptr;
+	memcpy(memory, original, (std::size_t)std::min<uint64_t>(size, _GetHeader(original)->Size));
+	allocator->_Free(original);
+	return memory;
+}
+
+VKAPI_ATTR void VKAPI_CALL VulkanHostAllocator::_OnFree(void* userData, void* memory)
+{
+	static_cast<VulkanHostAllocator*>(userData)->_Free(memory);
+}
+
+VKAPI_ATTR void VKAPI_CALL VulkanHostAllocator::_OnInternalAllocation(void* userData, std::size_t size, VkInternalAllocationType, VkSystemAllocationScope)
+{
+	static_cast<VulkanHostAllocator*>(userData)->InternalBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+VKAPI_ATTR void VKAPI_CALL VulkanHostAllocator::_OnInternalFree(void* userData, std::size_t size, VkInternalAllocationType, VkSystemAllocationScope)
+{
+	static_cast<VulkanHostAllocator*>(userData)->InternalBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+HostAllocationStats VulkanHostAllocator::GetStats() const
+{
+	HostAllocationStats stats;
+	for (uint32_t i = 0; i < HostAllocationStats::SCOPE_COUNT; ++i)
+	{
+		stats.Scopes[i].LiveAllocations = Scopes[i].LiveAllocations.load(std::memory_order_relaxed);
+		stats.Scopes[i].LiveBytes = Scopes[i].LiveBytes.load(std::memory_order_relaxed);
+		stats.Scopes[i].PeakBytes = Scopes[i].PeakBytes.load(std::memory_order_relaxed);
+		stats.Scopes[i].TotalAllocations = Scopes[i].TotalAllocations.load(std::memory_order_relaxed);
+	}
+	stats.InternalBytes = InternalBytes.load(std::memory_order_relaxed);
+	stats.ArenaAllocations = ArenaAllocations.load(std::memory_order_relaxed);
+	stats.ArenaFallbacks = ArenaFallbacks.load(std::memory_order_relaxed);
+	return stats;
+}
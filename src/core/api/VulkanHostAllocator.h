@@ -0,0 +1,69 @@
+#ifndef VULKAN_HOST_ALLOCATOR_HPP
+#define VULKAN_HOST_ALLOCATOR_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vulkan/vulkan.h>
+#include "defines.h"
+
+// per VkSystemAllocationScope
+struct HostAllocationScopeStats
+{
+	uint64_t LiveAllocations = 0;
+	uint64_t LiveBytes = 0;
+	uint64_t PeakBytes = 0;// high-water mark of LiveBytes
+	uint64_t TotalAllocations = 0;// allocations and reallocations so far, diff it across frames to see the churn
+};
+
+struct HostAllocationStats
+{
+	static constexpr uint32_t SCOPE_COUNT = 5;
+	HostAllocationScopeStats Scopes[SCOPE_COUNT];// indexed by VkSystemAllocationScope
+	uint64_t InternalBytes = 0;// allocated by the driver itself, we are only notified (executable memory)
+	uint64_t ArenaAllocations = 0;// command scope allocations served from the thread arenas
+	uint64_t ArenaFallbacks = 0;// command scope allocations that didn't fit and went to the heap
+};
+
+// The VkAllocationCallbacks every vkCreate/vkDestroy of the engine passes. Counts what the driver
+// allocates on the host per scope. Command scope allocations only live for the duration of the
+// call that makes them (vkCreateGraphicsPipelines, vkQueueSubmit...), those come from a bump
+// arena owned by the calling thread that rewinds once everything in it is freed, so the frame
+// loop doesn't hit the heap for them. Callbacks can come from any thread
+class VulkanHostAllocator
+{
+	struct ScopeCounters
+	{
+		std::atomic<uint64_t> LiveAllocations{ 0 };
+		std::atomic<uint64_t> LiveBytes{ 0 };
+		std::atomic<uint64_t> PeakBytes{ 0 };
+		std::atomic<uint64_t> TotalAllocations{ 0 };
+	};
+
+	ScopeCounters Scopes[HostAllocationStats::SCOPE_COUNT];
+	std::atomic<uint64_t> InternalBytes;
+	std::atomic<uint64_t> ArenaAllocations;
+	std::atomic<uint64_t> ArenaFallbacks;
+	VkAllocationCallbacks Callbacks;
+
+	void* _Allocate(std::size_t size, std::size_t alignment, VkSystemAllocationScope scope);
+	void _Free(void* memory);
+
+	static VKAPI_ATTR void* VKAPI_CALL _OnAllocation(void* userData, std::size_t size, std::size_t alignment, VkSystemAllocationScope scope);
+	static VKAPI_ATTR void* VKAPI_CALL _OnReallocation(void* userData, void* original, std::size_t size, std::size_t alignment, VkSystemAllocationScope scope);
+	static VKAPI_ATTR void VKAPI_CALL _OnFree(void* userData, void* memory);
+	static VKAPI_ATTR void VKAPI_CALL _OnInternalAllocation(void* userData, std::size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+	static VKAPI_ATTR void VKAPI_CALL _OnInternalFree(void* userData, std::size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+
+public:
+	static constexpr std::size_t ARENA_SIZE = 256 * 1024;// per thread
+
+	DISABLE_COPY(VulkanHostAllocator)
+	VulkanHostAllocator();
+
+	// must outlive every object created with it, instance and device included
+	const VkAllocationCallbacks* GetCallbacks() const { return &Callbacks; }
+	HostAllocationStats GetStats() const;
+};
+
+#endif //VULKAN_HOST_ALLOCATOR_HPP
@@ -0,0 +1,148 @@
+#include "VulkanLateLatchBuffer.h"
+#include <cstring>
+#include "core/debugger/public/Logger.h"
+#include "core/api/VulkanLib.h"
+
+VulkanLateLatchBuffer::VulkanLateLatchBuffer(const VulkanLib& vulkan, VkDeviceSize blockSize, uint32_t slotCount, VkShaderStageFlags stages)
+	: Vulkan{ vulkan }
+	, BlockSize{ blockSize }
+	, SlotCount{ slotCount > 0 ? slotCount : 1 }
+	, Buffer{ VK_NULL_HANDLE }
+	, Memory{ VK_NULL_HANDLE }
+	, Data{ nullptr }
+	, SetLayout{ VK_NULL_HANDLE }
+	, DescriptorPool{ VK_NULL_HANDLE }
+	, DescriptorSet{ VK_NULL_HANDLE }
+{
+	// dynamic offsets must be multiples of the alignment
+	VkPhysicalDeviceProperties gpuProperties;
+	Vulkan.GetInstanceDispatch().GetPhysicalDeviceProperties(Vulkan.GetGpu(), &gpuProperties);
+	VkDeviceSize alignment = gpuProperties.limits.minUniformBufferOffsetAlignment;
+	if (alignment > 0)
+		BlockSize = (BlockSize + alignment - 1) / alignment * alignment;
+
+	_CreateBuffer();
+	_CreateDescriptorSet(stages);
+}
+
+VulkanLateLatchBuffer::~VulkanLateLatchBuffer()
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	// the frames in flight still read it, destroying the pool frees the set
+	VkDevice device = Vulkan.GetLogicalDevice();
+	VkDescriptorPool descriptorPool = DescriptorPool;
+	VkDescriptorSetLayout setLayout = SetLayout;
+	const VkAllocationCallbacks* allocator = Vulkan.GetAllocator();
+	Vulkan.GetDeletionQueue().Push([dispatch = &vk, device, allocator, descriptorPool, setLayout]()
+	{
+		dispatch->DestroyDescriptorPool(device, descriptorPool, allocator);
+		dispatch->DestroyDescriptorSetLayout(device, setLayout, allocator);
+	});
+	// freeing the memory unmaps it
+	Vulkan.GetDeletionQueue().DestroyBuffer(Buffer, Memory);
+}
+
+void VulkanLateLatchBuffer::_CreateBuffer()
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	VkDevice device = Vulkan.GetLogicalDevice();
+	VkDeviceSize size = BlockSize * SlotCount;
+
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VK_CHECK(vk.CreateBuffer(device, &bufferInfo, Vulkan.GetAllocator(), &Buffer));
+
+	VkMemoryRequirements memRequirements;
+	vk.GetBufferMemoryRequirements(device, Buffer, &memRequirements);
+
+	// host visible is fine for a few hundred bytes read once per draw, on most gpus it is also device local (BAR)
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = Vulkan.FindMemoryType(memRequirements.memoryTypeBits
+		, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	if (allocInfo.memoryTypeIndex == UINT32_MAX)
+		allocInfo.memoryTypeIndex = Vulkan.FindMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	if (allocInfo.memoryTypeIndex == UINT32_MAX)
+		LOG_ERR("No host visible memory for the late latch buffer\n")
+
+	VK_CHECK(vk.AllocateMemory(device, &allocInfo, Vulkan.GetAllocator(), &Memory));
+	VK_CHECK(vk.BindBufferMemory(device, Buffer, Memory, 0));
+
+	void* data = nullptr;
+	VK_CHECK(vk.MapMemory(device, Memory, 0, size, 0, &data));
+	Data = static_cast<uint8_t*>(data);
+	memset(Data, 0, (std::size_t)size);
+}
+
+void VulkanLateLatchBuffer::_CreateDescriptorSet(VkShaderStageFlags stages)
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	VkDevice device = Vulkan.GetLogicalDevice();
+
+	VkDescriptorSetLayoutBinding binding = {};
+	binding.binding = 0;
+	binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	binding.descriptorCount = 1;
+	binding.stageFlags = stages;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &binding;
+	VK_CHECK(vk.CreateDescriptorSetLayout(device, &layoutInfo, Vulkan.GetAllocator(), &SetLayout));
+
+	VkDescriptorPoolSize poolSize = {};
+	poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	poolSize.descriptorCount = 1;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	VK_CHECK(vk.CreateDescriptorPool(device, &poolInfo, Vulkan.GetAllocator(), &DescriptorPool));
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = DescriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &SetLayout;
+	VK_CHECK(vk.AllocateDescriptorSets(device, &allocInfo, &DescriptorSet));
+
+	// one descriptor for the whole ring, the frame's region is picked with the dynamic offset
+	VkDescriptorBufferInfo bufferInfo = {};
+	bufferInfo.buffer = Buffer;
+	bufferInfo.offset = 0;
+	bufferInfo.range = BlockSize;
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = DescriptorSet;
+	write.dstBinding = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	write.pBufferInfo = &bufferInfo;
+	vk.UpdateDescriptorSets(device, 1, &write, 0, nullptr);
+}
+
+void VulkanLateLatchBuffer::Bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t setIndex, uint64_t frameValue) const
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	uint32_t offset = (uint32_t)(BlockSize * (frameValue % SlotCount));
+	vk.CmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, setIndex, 1, &DescriptorSet, 1, &offset);
+}
+
+void VulkanLateLatchBuffer::Write(uint64_t frameValue, const void* data, VkDeviceSize size)
+{
+	if (size > BlockSize)
+	{
+		LOG_ERR("Late latch write of %llu bytes, the block has %llu\n", (unsigned long long)size, (unsigned long long)BlockSize)
+		return;
+	}
+	memcpy(Data + BlockSize * (frameValue % SlotCount), data, (std::size_t)size);
+}
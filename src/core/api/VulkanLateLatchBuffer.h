@@ -0,0 +1,46 @@
+#ifndef VULKAN_LATE_LATCH_BUFFER_HPP
+#define VULKAN_LATE_LATCH_BUFFER_HPP
+
+#include <cstdint>
+#include <vulkan/vulkan.h>
+#include "defines.h"
+
+class VulkanLib;
+
+// Small uniform block (camera, view...) that is written after the frame was recorded, right
+// before its vkQueueSubmit. The command buffer only binds the frame's region through a dynamic
+// offset, the draws read whatever is there when the gpu gets to them.
+// One region per frame in a ring, the memory is persistently mapped and coherent: the submit
+// makes the host writes visible, no flush needed
+class VulkanLateLatchBuffer
+{
+	const VulkanLib& Vulkan;
+	VkDeviceSize BlockSize;// aligned to minUniformBufferOffsetAlignment
+	uint32_t SlotCount;
+	VkBuffer Buffer;
+	VkDeviceMemory Memory;
+	uint8_t* Data;// persistently mapped
+	VkDescriptorSetLayout SetLayout;
+	VkDescriptorPool DescriptorPool;
+	VkDescriptorSet DescriptorSet;
+
+	void _CreateBuffer();
+	void _CreateDescriptorSet(VkShaderStageFlags stages);
+
+public:
+	DISABLE_COPY(VulkanLateLatchBuffer)
+	// slotCount regions of blockSize bytes, a region can be written again once the frame
+	// slotCount frames before is done on the gpu (see GetOldestFrameUsingSlot)
+	VulkanLateLatchBuffer(const VulkanLib& vulkan, VkDeviceSize blockSize, uint32_t slotCount, VkShaderStageFlags stages = VK_SHADER_STAGE_VERTEX_BIT);
+	~VulkanLateLatchBuffer();
+
+	// set layout with a single dynamic uniform buffer at binding 0
+	VkDescriptorSetLayout GetSetLayout() const { return SetLayout; }
+	// records the binding of the region frameValue will write
+	void Bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t setIndex, uint64_t frameValue) const;
+	void Write(uint64_t frameValue, const void* data, VkDeviceSize size);
+	// the frame that must be finished before frameValue can be recorded, 0 when none
+	uint64_t GetOldestFrameUsingSlot(uint64_t frameValue) const { return frameValue > SlotCount ? frameValue - SlotCount : 0; }
+};
+
+#endif //VULKAN_LATE_LATCH_BUFFER_HPP
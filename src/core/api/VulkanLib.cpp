@@ -2,45 +2,86 @@
 #include "VulkanLib.h"
 #include <map>
 #include <vector>
+#include <algorithm>
 #include <cstring>
 #include <climits>
 #include <string>
 #include <glm/glm.hpp>
 #include "core/os/Win32Window.h"
 #include "core/debugger/public/Logger.h"
-#undef NOMINMAX;
+#undef NOMINMAX
 
-VulkanLib::VulkanLib(Win32Window& window)
-: VulkanInstance {nullptr}
+VulkanLib::VulkanLib(Win32Window* window)
+: HostAllocator{}
+, VulkanInstance {nullptr}
 , PhysicalGpu{ VK_NULL_HANDLE }
 , LogicalDevice{ nullptr }
+, InstanceDispatch{}
+, Dispatch{}
 , WindowSurface{ nullptr }
 , CommandPool{ nullptr }
+, PipelineCache{ VK_NULL_HANDLE }
 , GraphicsQueueIndex{-1}
 , GraphicsQueue{ nullptr }
 , PresentationQueueIndex{-1}
 , PresentationQueue{ nullptr }
+, TransferQueueIndex{-1}
+, TransferQueue{ nullptr }
+, ComputeQueueIndex{-1}
+, ComputeQueue{ nullptr }
 , ValLayers{}
+, Deletions{}
+, QueueMutexes{}
 , Window32Api{ window }
-, RequiredGpuDeviceExtensions{ VK_KHR_SWAPCHAIN_EXTENSION_NAME }
-, RequiredVkIntanceExtensions{ VK_KHR_WIN32_SURFACE_EXTENSION_NAME
-					, VK_KHR_SURFACE_EXTENSION_NAME }
+, RequiredGpuDeviceExtensions{ window ? std::vector<const char*>{ VK_KHR_SWAPCHAIN_EXTENSION_NAME } : std::vector<const char*>{} }
+, EnabledGpuDeviceExtensions{}
+, RequiredVkIntanceExtensions{}
+, InstanceApiVersion{ VK_API_VERSION_1_0 }
+, Capabilities{}
+, EnabledFeatures{}
+, EnabledFeatures12{}
+#ifdef VK_KHR_dynamic_rendering
+, EnabledDynamicRenderingFeatures{}
+#endif
 {
+#ifdef _WIN32
+	if (Window32Api)
+	{
+		RequiredVkIntanceExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
+		RequiredVkIntanceExtensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
+	}
+#endif
 	if (ValLayers.EnableValidationLayers)
 		RequiredVkIntanceExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 }
 
 VulkanLib::~VulkanLib()
 {
-	vkDestroyCommandPool(LogicalDevice, CommandPool, nullptr);
+	// whatever is still waiting for the gpu goes now, the device must be idle at this point
+	Deletions.FlushAll();
+	// both are created through the device commands, they only exist when those loaded
+	if (PipelineCache && Dispatch.DestroyPipelineCache)
+		Dispatch.DestroyPipelineCache(LogicalDevice, PipelineCache, GetAllocator());
+	if (CommandPool && Dispatch.DestroyCommandPool)
+		Dispatch.DestroyCommandPool(LogicalDevice, CommandPool, GetAllocator());
 	ValLayers.CleanUpValidationLayers(VulkanInstance);
-	vkDestroyDevice(LogicalDevice, nullptr);
-	vkDestroySurfaceKHR(VulkanInstance,WindowSurface, nullptr);
-	vkDestroyInstance(VulkanInstance, NULL);
+	// the device commands may have failed to load after the device was created, the loader's
+	// trampoline can destroy it without them
+	if (LogicalDevice)
+		(Dispatch.DestroyDevice ? Dispatch.DestroyDevice : vkDestroyDevice)(LogicalDevice, GetAllocator());
+	if (WindowSurface)
+		InstanceDispatch.DestroySurfaceKHR(VulkanInstance,WindowSurface, nullptr);// the window creates it with the default allocator
+	(InstanceDispatch.DestroyInstance ? InstanceDispatch.DestroyInstance : vkDestroyInstance)(VulkanInstance, GetAllocator());
 }
 
 
 void VulkanLib::Init(const VkApplicationInfo& appInfo)
+{
+	InitInstance(appInfo);
+	InitDevice();
+}
+
+void VulkanLib::InitInstance(const VkApplicationInfo& appInfo)
 {
 	// Check for validation support if validation layers are enabled
 	if (!ValLayers.CheckValidationLayerSupport())
@@ -50,9 +91,18 @@ void VulkanLib::Init(const VkApplicationInfo& appInfo)
 
 	// If validation Layers are enabled and we have succesfully created a vulkan instance, then we set up Debug messenger
 	ValLayers.SetUpDebugMessenger(VulkanInstance);
+}
 
-	Window32Api.CreateWindowSurface(VulkanInstance,&WindowSurface);
+void VulkanLib::InitDevice()
+{
+#ifdef _WIN32
+	if (Window32Api)
+		Window32Api->CreateWindowSurface(VulkanInstance,&WindowSurface);
+#endif
 	SelectPhysicalDevice(VulkanInstance, WindowSurface);
+	FindTransferQueueFamily(PhysicalGpu);
+	FindComputeQueueFamily(PhysicalGpu);
+	QueryDeviceCapabilities(PhysicalGpu);
 	CreateLogicalDevice(PhysicalGpu);
 	CreateQueues(LogicalDevice);
 	CreateCommandPool(LogicalDevice);
@@ -68,10 +118,20 @@ void VulkanLib::CreateVulkanInstance(const VkApplicationInfo& appInfo)
 	vkEnumerateInstanceExtensionProperties( nullptr, &extensionCount, availableVulkanInstanceExtensions.data());
 	ValLayers.LogVulkanExtensions(availableVulkanInstanceExtensions, RequiredVkIntanceExtensions);
 
+	// A 1.0 loader fails instance creation if we ask for a newer api, so ask at most for what
+	// the loader supports. vkEnumerateInstanceVersion doesn't exist in 1.0 loaders
+	auto enumerateInstanceVersion = (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion");
+	if (enumerateInstanceVersion)
+		enumerateInstanceVersion(&InstanceApiVersion);
+
+	VkApplicationInfo clampedAppInfo = appInfo;
+	clampedAppInfo.apiVersion = std::min(appInfo.apiVersion, InstanceApiVersion);
+	InstanceApiVersion = clampedAppInfo.apiVersion;
+
 	// Instance create info
 	VkInstanceCreateInfo createInf = {};
 	createInf.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
-	createInf.pApplicationInfo = &appInfo;
+	createInf.pApplicationInfo = &clampedAppInfo;
 	createInf.enabledExtensionCount = (uint32_t)RequiredVkIntanceExtensions.size();
 	createInf.ppEnabledExtensionNames = RequiredVkIntanceExtensions.data();
 	createInf.pNext = nullptr;
@@ -83,16 +143,18 @@ void VulkanLib::CreateVulkanInstance(const VkApplicationInfo& appInfo)
 		createInf.pNext = &ValLayers.DebugMessengerCreateInfo;
 	}
 
-	VK_CHECK(vkCreateInstance(&createInf, nullptr, &VulkanInstance), " cant't find a compatilbe Vulkan installable client\n");
+	VK_CHECK(vkCreateInstance(&createInf, GetAllocator(), &VulkanInstance), " cant't find a compatilbe Vulkan installable client\n");
+	if (!InstanceDispatch.Load(VulkanInstance))
+		LOG_ERR("Failed to load the instance commands\n")
 
 }
 
 bool VulkanLib::HasPhysicalDeviceRequiredExtensionSupport(VkPhysicalDevice gpu)
 {
 	uint32_t extensionCount = {};
-	vkEnumerateDeviceExtensionProperties(gpu, nullptr, &extensionCount, nullptr);
+	InstanceDispatch.EnumerateDeviceExtensionProperties(gpu, nullptr, &extensionCount, nullptr);
 	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
-	vkEnumerateDeviceExtensionProperties(gpu, nullptr, &extensionCount, availableExtensions.data());
+	InstanceDispatch.EnumerateDeviceExtensionProperties(gpu, nullptr, &extensionCount, availableExtensions.data());
 	ValLayers.LogGpuExtensions( availableExtensions, RequiredGpuDeviceExtensions);
 	
 	for (const char* deviceExtensionName : RequiredGpuDeviceExtensions)
@@ -112,13 +174,28 @@ bool VulkanLib::HasPhysicalDeviceRequiredExtensionSupport(VkPhysicalDevice gpu)
 	return true;
 }
 
+bool VulkanLib::HasPhysicalDeviceExtension(VkPhysicalDevice gpu, const char* extensionName)
+{
+	uint32_t extensionCount = {};
+	InstanceDispatch.EnumerateDeviceExtensionProperties(gpu, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	InstanceDispatch.EnumerateDeviceExtensionProperties(gpu, nullptr, &extensionCount, availableExtensions.data());
+
+	for (const VkExtensionProperties& extension : availableExtensions)
+	{
+		if (std::strcmp(extension.extensionName, extensionName) == 0)
+			return true;
+	}
+	return false;
+}
+
 bool VulkanLib::CheckSwapChainSupport(VkPhysicalDevice gpu, VkSurfaceKHR windowSurface)
 {
 	uint32_t formatCount;
-	vkGetPhysicalDeviceSurfaceFormatsKHR(gpu, windowSurface, &formatCount, nullptr);
+	InstanceDispatch.GetPhysicalDeviceSurfaceFormatsKHR(gpu, windowSurface, &formatCount, nullptr);
 
 	uint32_t presentModeCount;
-	vkGetPhysicalDeviceSurfacePresentModesKHR(gpu, windowSurface, &presentModeCount, nullptr);
+	InstanceDispatch.GetPhysicalDeviceSurfacePresentModesKHR(gpu, windowSurface, &presentModeCount, nullptr);
 
 	return (formatCount > 0 && presentModeCount > 0);
 }
@@ -127,27 +204,26 @@ bool VulkanLib::CheckSwapChainSupport(VkPhysicalDevice gpu, VkSurfaceKHR windowS
 void VulkanLib::SelectPhysicalDevice(VkInstance vulkanInstance, VkSurfaceKHR windowSurface)
 {
 	uint32_t deviceCount = { 0 };
-	vkEnumeratePhysicalDevices(vulkanInstance, &deviceCount, nullptr);
+	InstanceDispatch.EnumeratePhysicalDevices(vulkanInstance, &deviceCount, nullptr);
 
 	if (deviceCount == 0) LOG_ERR("Failed to find GPUs with vulkan support!\n");
 
 	std::vector<VkPhysicalDevice> gpuDevices(deviceCount);
-	vkEnumeratePhysicalDevices(vulkanInstance, &deviceCount, gpuDevices.data());
+	InstanceDispatch.EnumeratePhysicalDevices(vulkanInstance, &deviceCount, gpuDevices.data());
 
 	// Score GPUs/devices by features and properties and select the Best one base on score
 	std::multimap<float, std::pair<VkPhysicalDevice,std::string>> gpusAvailable = {};
 	for (const VkPhysicalDevice& gpu : gpuDevices)
 	{
 		VkPhysicalDeviceProperties gpuProperties;
-		vkGetPhysicalDeviceProperties(gpu,&gpuProperties);
+		InstanceDispatch.GetPhysicalDeviceProperties(gpu,&gpuProperties);
 
 		VkPhysicalDeviceFeatures gpuFeatures;
-		vkGetPhysicalDeviceFeatures(gpu, &gpuFeatures);
+		InstanceDispatch.GetPhysicalDeviceFeatures(gpu, &gpuFeatures);
 		
-		if (gpuFeatures.geometryShader // we cannot function without geometry shader
-			&& GetRequiredQueueFamilyIndices(gpu, windowSurface)// Must support desire queues and surface creation
+		if (GetRequiredQueueFamilyIndices(gpu, windowSurface)// Must support desire queues and surface creation
 			&& HasPhysicalDeviceRequiredExtensionSupport(gpu) // Must support the device extensions we required
-			&& CheckSwapChainSupport(gpu, windowSurface)// Make sure the gpu has at least one surface format and present modes available
+			&& (IsHeadless() || CheckSwapChainSupport(gpu, windowSurface))// Make sure the gpu has at least one surface format and present modes available
 			&& gpuFeatures.samplerAnisotropy)// nice to have, but we want to force it
 		{
 			// if supports the minimu requirements then we score it based on extra prperties and features
@@ -156,6 +232,11 @@ void VulkanLib::SelectPhysicalDevice(VkInstance vulkanInstance, VkSurfaceKHR win
 			{
 				score += 1;
 			}
+			// newer api versions light up faster paths (timeline semaphores, descriptor indexing...)
+			if (gpuProperties.apiVersion >= VK_API_VERSION_1_2)
+			{
+				score += 0.5f;
+			}
 			
 			//get a value between 0 and 1 based on the max image dimension 2D
 			score += (float)gpuProperties.limits.maxImageDimension2D / std::numeric_limits<uint32_t>::max();
@@ -177,6 +258,124 @@ void VulkanLib::SelectPhysicalDevice(VkInstance vulkanInstance, VkSurfaceKHR win
 	LOG_TRACE("GPU selected:%s\n", (--gpusAvailable.end())->second.second.c_str())
 }
 
+void VulkanLib::QueryDeviceCapabilities(VkPhysicalDevice gpu)
+{
+	VkPhysicalDeviceProperties gpuProperties;
+	InstanceDispatch.GetPhysicalDeviceProperties(gpu, &gpuProperties);
+
+	VkPhysicalDeviceFeatures gpuFeatures;
+	InstanceDispatch.GetPhysicalDeviceFeatures(gpu, &gpuFeatures);
+
+	Capabilities = {};
+	Capabilities.ApiVersion = std::min(gpuProperties.apiVersion, InstanceApiVersion);
+	Capabilities.GeometryShader = gpuFeatures.geometryShader == VK_TRUE;
+	Capabilities.PipelineStatisticsQuery = gpuFeatures.pipelineStatisticsQuery == VK_TRUE;
+	EnabledGpuDeviceExtensions = RequiredGpuDeviceExtensions;
+
+	// Only the 1.0 features are enabled in EnabledFeatures.features, the rest of the chain
+	// is filled below with the features we actually use, never with everything supported
+	EnabledFeatures = {};
+	EnabledFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	EnabledFeatures.features.samplerAnisotropy = VK_TRUE;
+	EnabledFeatures.features.geometryShader = gpuFeatures.geometryShader;
+	EnabledFeatures.features.pipelineStatisticsQuery = gpuFeatures.pipelineStatisticsQuery;// gpu profiler
+	EnabledFeatures12 = {};
+	EnabledFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+	// vkGetPhysicalDeviceFeatures2 is core in 1.1, below that we stay in the 1.0 baseline
+	if (Capabilities.ApiVersion < VK_API_VERSION_1_1)
+	{
+		LOG_TRACE("Vulkan 1.0 device, running the baseline paths\n")
+		return;
+	}
+
+	void** nextFeature = &EnabledFeatures.pNext;
+
+	// Query what the gpu supports
+	VkPhysicalDeviceFeatures2 supportedFeatures = {};
+	supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	VkPhysicalDeviceVulkan12Features supportedFeatures12 = {};
+	supportedFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	void** nextSupported = &supportedFeatures.pNext;
+
+	if (Capabilities.ApiVersion >= VK_API_VERSION_1_2)
+	{
+		*nextSupported = &supportedFeatures12;
+		nextSupported = &supportedFeatures12.pNext;
+	}
+
+#ifdef VK_KHR_dynamic_rendering
+	VkPhysicalDeviceDynamicRenderingFeaturesKHR supportedDynamicRendering = {};
+	supportedDynamicRendering.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+#ifdef VK_API_VERSION_1_3
+	bool dynamicRenderingIsCore = Capabilities.ApiVersion >= VK_API_VERSION_1_3;
+#else
+	bool dynamicRenderingIsCore = false;
+#endif
+	// the extension also depends on create_renderpass2 and depth_stencil_resolve, core in 1.2
+	bool dynamicRenderingAvailable = dynamicRenderingIsCore
+		|| (Capabilities.ApiVersion >= VK_API_VERSION_1_2 && HasPhysicalDeviceExtension(gpu, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME));
+	if (dynamicRenderingAvailable)
+	{
+		*nextSupported = &supportedDynamicRendering;
+		nextSupported = &supportedDynamicRendering.pNext;
+	}
+#endif
+
+	InstanceDispatch.GetPhysicalDeviceFeatures2(gpu, &supportedFeatures);
+
+	if (Capabilities.ApiVersion >= VK_API_VERSION_1_2)
+	{
+		// GPU-CPU sync with a single counter instead of fences per frame
+		Capabilities.TimelineSemaphore = supportedFeatures12.timelineSemaphore == VK_TRUE;
+		EnabledFeatures12.timelineSemaphore = supportedFeatures12.timelineSemaphore;
+
+		// bindless: big partially bound descriptor arrays indexed from the shaders
+		Capabilities.DescriptorIndexing = supportedFeatures12.descriptorIndexing
+			&& supportedFeatures12.runtimeDescriptorArray
+			&& supportedFeatures12.descriptorBindingPartiallyBound
+			&& supportedFeatures12.descriptorBindingVariableDescriptorCount
+			&& supportedFeatures12.shaderSampledImageArrayNonUniformIndexing;
+		if (Capabilities.DescriptorIndexing)
+		{
+			EnabledFeatures12.descriptorIndexing = VK_TRUE;
+			EnabledFeatures12.runtimeDescriptorArray = VK_TRUE;
+			EnabledFeatures12.descriptorBindingPartiallyBound = VK_TRUE;
+			EnabledFeatures12.descriptorBindingVariableDescriptorCount = VK_TRUE;
+			EnabledFeatures12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+			EnabledFeatures12.descriptorBindingSampledImageUpdateAfterBind = supportedFeatures12.descriptorBindingSampledImageUpdateAfterBind;
+		}
+
+		Capabilities.BufferDeviceAddress = supportedFeatures12.bufferDeviceAddress == VK_TRUE;
+		EnabledFeatures12.bufferDeviceAddress = supportedFeatures12.bufferDeviceAddress;
+
+		Capabilities.DrawIndirectCount = supportedFeatures12.drawIndirectCount == VK_TRUE;
+		EnabledFeatures12.drawIndirectCount = supportedFeatures12.drawIndirectCount;
+
+		*nextFeature = &EnabledFeatures12;
+		nextFeature = &EnabledFeatures12.pNext;
+	}
+
+#ifdef VK_KHR_dynamic_rendering
+	EnabledDynamicRenderingFeatures = {};
+	EnabledDynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+	if (dynamicRenderingAvailable && supportedDynamicRendering.dynamicRendering)
+	{
+		Capabilities.DynamicRendering = true;
+		EnabledDynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+		*nextFeature = &EnabledDynamicRenderingFeatures;
+		nextFeature = &EnabledDynamicRenderingFeatures.pNext;
+		if (!dynamicRenderingIsCore)
+			EnabledGpuDeviceExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+	}
+#endif
+
+	LOG_TRACE("Device api %d.%d timelineSemaphore:%d descriptorIndexing:%d bufferDeviceAddress:%d dynamicRendering:%d drawIndirectCount:%d\n"
+		, VK_VERSION_MAJOR(Capabilities.ApiVersion), VK_VERSION_MINOR(Capabilities.ApiVersion)
+		, Capabilities.TimelineSemaphore, Capabilities.DescriptorIndexing, Capabilities.BufferDeviceAddress
+		, Capabilities.DynamicRendering, Capabilities.DrawIndirectCount)
+}
+
 
 
 void VulkanLib::CreateLogicalDevice(VkPhysicalDevice physicalGpu)
@@ -186,45 +385,54 @@ void VulkanLib::CreateLogicalDevice(VkPhysicalDevice physicalGpu)
 	   This is required even if there is only a single queue */
 	float priority = 1.0f;
 
-	// Graphics queue create info
-	VkDeviceQueueCreateInfo graphicsQueueCreateInfo = {};
-	graphicsQueueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-	graphicsQueueCreateInfo.queueFamilyIndex = GraphicsQueueIndex;
-	graphicsQueueCreateInfo.queueCount = 1;
-	graphicsQueueCreateInfo.pQueuePriorities = &priority;
-	
-	// Presentation queue create info
-	VkDeviceQueueCreateInfo presentationQueueCreateInfo = {};
-	presentationQueueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-	presentationQueueCreateInfo.queueFamilyIndex = PresentationQueueIndex;
-	presentationQueueCreateInfo.queueCount = 1;
-	presentationQueueCreateInfo.pQueuePriorities = &priority;
-
-	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos {graphicsQueueCreateInfo, presentationQueueCreateInfo};
-
-	// Specify the device features the device offer, we are going to use 
-	// Note:we based our device selection before in SelectPhysicalDevice
-	VkPhysicalDeviceFeatures deviceFeatures = {};
-	deviceFeatures.samplerAnisotropy = VK_TRUE;
-	deviceFeatures.geometryShader = VK_TRUE;
+	// one create info per distinct family, the specification doesn't allow repeating a family
+	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+	for (int familyIndex : { GraphicsQueueIndex, PresentationQueueIndex, TransferQueueIndex, ComputeQueueIndex })
+	{
+		bool alreadyAdded = false;
+		for (const VkDeviceQueueCreateInfo& queueInfo : queueCreateInfos)
+			alreadyAdded |= queueInfo.queueFamilyIndex == (uint32_t)familyIndex;
+		if (alreadyAdded)
+			continue;
+
+		VkDeviceQueueCreateInfo queueCreateInfo = {};
+		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		queueCreateInfo.queueFamilyIndex = familyIndex;
+		queueCreateInfo.queueCount = 1;
+		queueCreateInfo.pQueuePriorities = &priority;
+		queueCreateInfos.push_back(queueCreateInfo);
+	}
 
+	// The features we are going to use were picked in QueryDeviceCapabilities
 	VkDeviceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-	// if the presentation queue and graphics queue have same index family set count to 1 and one of the index
-	// validation layers will warn that the specification require that a list of index families should be different
-	createInfo.queueCreateInfoCount = (GraphicsQueueIndex == PresentationQueueIndex) ? 1 : queueCreateInfos.size();
-	createInfo.pQueueCreateInfos = (GraphicsQueueIndex == PresentationQueueIndex) ? &graphicsQueueCreateInfo : queueCreateInfos.data();
-	createInfo.pEnabledFeatures = &deviceFeatures;
-	createInfo.enabledExtensionCount = RequiredGpuDeviceExtensions.size();
-	createInfo.ppEnabledExtensionNames = RequiredGpuDeviceExtensions.data();
-
-	VK_CHECK(vkCreateDevice(physicalGpu, &createInfo, nullptr, &LogicalDevice));
+	createInfo.queueCreateInfoCount = (uint32_t)queueCreateInfos.size();
+	createInfo.pQueueCreateInfos = queueCreateInfos.data();
+	createInfo.enabledExtensionCount = EnabledGpuDeviceExtensions.size();
+	createInfo.ppEnabledExtensionNames = EnabledGpuDeviceExtensions.data();
+	// 1.1+ devices take the whole feature chain through pNext, pEnabledFeatures must be null then
+	if (Capabilities.ApiVersion >= VK_API_VERSION_1_1)
+	{
+		createInfo.pNext = &EnabledFeatures;
+		createInfo.pEnabledFeatures = nullptr;
+	}
+	else
+	{
+		createInfo.pEnabledFeatures = &EnabledFeatures.features;
+	}
+
+	VK_CHECK(InstanceDispatch.CreateDevice(physicalGpu, &createInfo, GetAllocator(), &LogicalDevice));
+	if (!Dispatch.Load(InstanceDispatch, LogicalDevice))
+		LOG_ERR("Failed to load the device commands\n")
+	Deletions.SetDevice(LogicalDevice, GetAllocator(), &Dispatch);
 }
 
 void VulkanLib::CreateQueues( VkDevice logicalDevice)
 {
-	vkGetDeviceQueue(logicalDevice, GraphicsQueueIndex, 0, &GraphicsQueue);
-	vkGetDeviceQueue(logicalDevice, PresentationQueueIndex, 0, &PresentationQueue);
+	Dispatch.GetDeviceQueue(logicalDevice, GraphicsQueueIndex, 0, &GraphicsQueue);
+	Dispatch.GetDeviceQueue(logicalDevice, PresentationQueueIndex, 0, &PresentationQueue);
+	Dispatch.GetDeviceQueue(logicalDevice, TransferQueueIndex, 0, &TransferQueue);
+	Dispatch.GetDeviceQueue(logicalDevice, ComputeQueueIndex, 0, &ComputeQueue);
 }
 
 void VulkanLib::CreateCommandPool(VkDevice logicalDevice)
@@ -234,21 +442,65 @@ void VulkanLib::CreateCommandPool(VkDevice logicalDevice)
 	poolInfo.queueFamilyIndex = GraphicsQueueIndex;
 	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 	
-	VK_CHECK(vkCreateCommandPool(logicalDevice, &poolInfo, nullptr, &CommandPool));
+	VK_CHECK(Dispatch.CreateCommandPool(logicalDevice, &poolInfo, GetAllocator(), &CommandPool));
+}
+
+void VulkanLib::CreatePipelineCache(const std::vector<char>& initialData)
+{
+	// the header says which gpu and driver wrote it. Drivers must reject foreign data themselves
+	// but some crash on it, so it is only passed on when it is ours (VkPipelineCacheHeaderVersionOne)
+	VkPhysicalDeviceProperties gpuProperties;
+	InstanceDispatch.GetPhysicalDeviceProperties(PhysicalGpu, &gpuProperties);
+	bool valid = initialData.size() >= 16 + VK_UUID_SIZE;
+	if (valid)
+	{
+		uint32_t header[4];
+		memcpy(header, initialData.data(), sizeof(header));
+		// header[0] is the header length, VkPipelineCacheHeaderVersionOne is 32 bytes
+		valid = header[0] >= 16 + VK_UUID_SIZE && header[0] <= initialData.size()
+			&& header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+			&& header[2] == gpuProperties.vendorID
+			&& header[3] == gpuProperties.deviceID
+			&& memcmp(initialData.data() + 16, gpuProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+	}
+	if (!valid && !initialData.empty())
+		LOG_WARN("Pipeline cache from another gpu or driver, starting empty\n")
+
+	VkPipelineCacheCreateInfo cacheInfo = {};
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheInfo.initialDataSize = valid ? initialData.size() : 0;
+	cacheInfo.pInitialData = valid ? initialData.data() : nullptr;
+	VK_CHECK(Dispatch.CreatePipelineCache(LogicalDevice, &cacheInfo, GetAllocator(), &PipelineCache));
+}
+
+std::vector<char> VulkanLib::GetPipelineCacheData() const
+{
+	std::vector<char> data;
+	if (!PipelineCache)
+		return data;
+
+	std::size_t size = 0;
+	VK_CHECK(Dispatch.GetPipelineCacheData(LogicalDevice, PipelineCache, &size, nullptr));
+	data.resize(size);
+	VK_CHECK(Dispatch.GetPipelineCacheData(LogicalDevice, PipelineCache, &size, data.data()));
+	data.resize(size);
+	return data;
 }
 
 
 bool VulkanLib::GetRequiredQueueFamilyIndices( VkPhysicalDevice physicalGpu, VkSurfaceKHR windowSurface)
 {
 	uint32_t queueFamilyCount = { 0 };
-	vkGetPhysicalDeviceQueueFamilyProperties(physicalGpu, &queueFamilyCount, nullptr);
+	InstanceDispatch.GetPhysicalDeviceQueueFamilyProperties(physicalGpu, &queueFamilyCount, nullptr);
 	
 	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-	vkGetPhysicalDeviceQueueFamilyProperties(physicalGpu, &queueFamilyCount, queueFamilies.data());
+	InstanceDispatch.GetPhysicalDeviceQueueFamilyProperties(physicalGpu, &queueFamilyCount, queueFamilies.data());
 
 	// we just need one queue for graphics and other for presentation
 	bool graphicsSupportFound = false;
 	bool presentationSupportFound = false;
+	// headless: nothing is presented, the "present" queue is the graphics queue (queue waits still use it)
+	bool headless = IsHeadless();
 
 	// we need to find a graphics queue and presentation queue
 	for (int i = 0; i < queueFamilies.size(); ++i)
@@ -263,8 +515,9 @@ bool VulkanLib::GetRequiredQueueFamilyIndices( VkPhysicalDevice physicalGpu, VkS
 				graphicsSupportFound = true;
 				GraphicsQueueIndex = i;
 			}
-			VkBool32 presentSupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(physicalGpu, i, windowSurface, &presentSupport);
+			VkBool32 presentSupport = headless && (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT);
+			if (!headless)
+				InstanceDispatch.GetPhysicalDeviceSurfaceSupportKHR(physicalGpu, i, windowSurface, &presentSupport);
 			if ( presentSupport)
 			{
 				// found a queue family that support presenting images
@@ -278,12 +531,109 @@ bool VulkanLib::GetRequiredQueueFamilyIndices( VkPhysicalDevice physicalGpu, VkS
 	return graphicsSupportFound && presentationSupportFound;
 }
 
+void VulkanLib::FindTransferQueueFamily(VkPhysicalDevice physicalGpu)
+{
+	uint32_t queueFamilyCount = { 0 };
+	InstanceDispatch.GetPhysicalDeviceQueueFamilyProperties(physicalGpu, &queueFamilyCount, nullptr);
+
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	InstanceDispatch.GetPhysicalDeviceQueueFamilyProperties(physicalGpu, &queueFamilyCount, queueFamilies.data());
+
+	// A family with transfer but neither graphics nor compute is usually the copy engine (DMA),
+	// uploads there run next to rendering instead of being queued behind it.
+	// Graphics and compute queues can always copy even if they don't report the transfer bit
+	TransferQueueIndex = GraphicsQueueIndex;
+	for (int i = 0; i < queueFamilies.size(); ++i)
+	{
+		VkQueueFlags flags = queueFamilies[i].queueFlags;
+		if (queueFamilies[i].queueCount > 0
+			&& (flags & VK_QUEUE_TRANSFER_BIT)
+			&& !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+		{
+			TransferQueueIndex = i;
+			break;
+		}
+	}
+
+	LOG_TRACE("Transfer queue family:%d (%s)\n", TransferQueueIndex, TransferQueueIndex != GraphicsQueueIndex ? "dedicated" : "shared with graphics")
+}
+
+void VulkanLib::FindComputeQueueFamily(VkPhysicalDevice physicalGpu)
+{
+	uint32_t queueFamilyCount = { 0 };
+	InstanceDispatch.GetPhysicalDeviceQueueFamilyProperties(physicalGpu, &queueFamilyCount, nullptr);
+
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	InstanceDispatch.GetPhysicalDeviceQueueFamilyProperties(physicalGpu, &queueFamilyCount, queueFamilies.data());
+
+	// A compute family without graphics is scheduled independently from the graphics queue,
+	// so culling, particles or post-processing can run while the previous frame rasterizes.
+	// Without one compute shares the graphics family, which supports compute on every desktop gpu
+	ComputeQueueIndex = GraphicsQueueIndex;
+	for (int i = 0; i < queueFamilies.size(); ++i)
+	{
+		VkQueueFlags flags = queueFamilies[i].queueFlags;
+		if (queueFamilies[i].queueCount > 0
+			&& (flags & VK_QUEUE_COMPUTE_BIT)
+			&& !(flags & VK_QUEUE_GRAPHICS_BIT))
+		{
+			ComputeQueueIndex = i;
+			break;
+		}
+	}
+
+	LOG_TRACE("Compute queue family:%d (%s)\n", ComputeQueueIndex, ComputeQueueIndex != GraphicsQueueIndex ? "async" : "shared with graphics")
+}
+
+uint32_t VulkanLib::FindMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const
+{
+	VkPhysicalDeviceMemoryProperties memProperties = {};
+	InstanceDispatch.GetPhysicalDeviceMemoryProperties(PhysicalGpu, &memProperties);
+
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; ++i)
+	{
+		if ((typeBits & (1u << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+			return i;
+	}
+	return UINT32_MAX;
+}
+
+std::mutex& VulkanLib::_GetQueueMutex(VkQueue queue) const
+{
+	// roles sharing a VkQueue map to the mutex of the first of them
+	const VkQueue queues[QUEUE_ROLE_COUNT] = { GraphicsQueue, PresentationQueue, TransferQueue, ComputeQueue };
+	for (uint32_t i = 0; i < QUEUE_ROLE_COUNT; ++i)
+	{
+		if (queues[i] == queue)
+			return QueueMutexes[i];
+	}
+	return QueueMutexes[0];
+}
+
+VkResult VulkanLib::QueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo* submits, VkFence fence) const
+{
+	std::lock_guard<std::mutex> lock(_GetQueueMutex(queue));
+	return Dispatch.QueueSubmit(queue, submitCount, submits, fence);
+}
+
+VkResult VulkanLib::QueuePresent(const VkPresentInfoKHR& presentInfo) const
+{
+	std::lock_guard<std::mutex> lock(_GetQueueMutex(PresentationQueue));
+	return Dispatch.QueuePresentKHR(PresentationQueue, &presentInfo);
+}
+
+VkResult VulkanLib::QueueWaitIdle(VkQueue queue) const
+{
+	std::lock_guard<std::mutex> lock(_GetQueueMutex(queue));
+	return Dispatch.QueueWaitIdle(queue);
+}
+
 VkFormat VulkanLib::FindSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) 
 {
 	for (VkFormat format : candidates)
 	{
 		VkFormatProperties props;
-		vkGetPhysicalDeviceFormatProperties(PhysicalGpu, format, &props);
+		InstanceDispatch.GetPhysicalDeviceFormatProperties(PhysicalGpu, format, &props);
 
 		if (tiling == VK_IMAGE_TILING_LINEAR && (props.linearTilingFeatures & features) == features) {
 			return format;
@@ -294,4 +644,5 @@ VkFormat VulkanLib::FindSupportedFormat(const std::vector<VkFormat>& candidates,
 		}
 	}
 	LOG_ERR("failed to find supported format!\n")
+	return VK_FORMAT_UNDEFINED;// release builds don't throw
 }
\ No newline at end of file
@@ -2,55 +2,130 @@
 #define VULKAN_LIB_HPP
 
 #include <vector>
+#include <mutex>
+#ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
+#endif
 #include <vulkan/vulkan.h>
 #include "core/debugger/private/VulkanValidationLayers.h"
+#include "core/api/VulkanCapabilities.h"
+#include "core/api/DeletionQueue.h"
+#include "core/api/VulkanHostAllocator.h"
+#include "core/api/VulkanDispatch.h"
 
 class Win32Window;
 
 class VulkanLib
 {
+	// first so it is destroyed last, everything below is created with its callbacks
+	VulkanHostAllocator HostAllocator;
 	VkInstance VulkanInstance;// encapsulates access to Vulkan library on the system
 	VkPhysicalDevice PhysicalGpu; // this is the gpu we choose
 	VkDevice LogicalDevice;// Logical device is the medium through we comunicate with the physical device
+	VulkanInstanceDispatch InstanceDispatch;// the instance's commands, loaded right after it is created
+	VulkanDispatch Dispatch;// the device's commands, loaded right after it is created
 
 	VkSurfaceKHR WindowSurface;
 	VkCommandPool CommandPool;
+	VkPipelineCache PipelineCache;// every pipeline goes through it, see CreatePipelineCache
 
 	int GraphicsQueueIndex;
 	VkQueue GraphicsQueue;
 	int PresentationQueueIndex;
 	VkQueue PresentationQueue;
+	int TransferQueueIndex;// a transfer-only family if the gpu has one, the graphics family otherwise
+	VkQueue TransferQueue;
+	int ComputeQueueIndex;// a compute family without graphics if the gpu has one (async compute)
+	VkQueue ComputeQueue;
 	
 	vkLayers::VulkanValidationLayer ValLayers;
-	Win32Window& Window32Api;
+	// mutable: resources owned through a const VulkanLib& are still retired through it
+	mutable DeletionQueue Deletions;
+	// vkQueueSubmit/vkQueuePresentKHR need external sync, the main thread (uploads) and the
+	// present thread can both reach the same VkQueue. One mutex per distinct queue: a present
+	// blocked in the driver only holds up submits to its own queue. Graphics, present, transfer, compute
+	static constexpr uint32_t QUEUE_ROLE_COUNT = 4;
+	mutable std::mutex QueueMutexes[QUEUE_ROLE_COUNT];
+	Win32Window* Window32Api;// null when headless: no surface, no swap chain, no present queue
 
 	const std::vector<const char*> RequiredGpuDeviceExtensions;// physical device required extensions
+	std::vector<const char*> EnabledGpuDeviceExtensions;// required plus the optional ones the gpu supports
     std::vector<const char*> RequiredVkIntanceExtensions;
 
+	uint32_t InstanceApiVersion;
+	VulkanCapabilities Capabilities;
+	// features we turn on at device creation, chained through pNext
+	VkPhysicalDeviceFeatures2 EnabledFeatures;
+	VkPhysicalDeviceVulkan12Features EnabledFeatures12;
+#ifdef VK_KHR_dynamic_rendering
+	VkPhysicalDeviceDynamicRenderingFeaturesKHR EnabledDynamicRenderingFeatures;
+#endif
+
+	std::mutex& _GetQueueMutex(VkQueue queue) const;
+
 public:
 
-	VulkanLib(Win32Window& window);
+	// without a window the library runs headless, any gpu that can do graphics is accepted
+	// (lavapipe, SwiftShader on machines without a display)
+	VulkanLib(Win32Window* window);
 	~VulkanLib();
 	void Init(const VkApplicationInfo& info);
+	// Init in two halves: the instance doesn't need the window to exist yet, so it can be
+	// created on another thread while the window is. The device half needs its surface
+	void InitInstance(const VkApplicationInfo& info);
+	void InitDevice();
 	void CreateVulkanInstance(const VkApplicationInfo& info);
 	void SelectPhysicalDevice(VkInstance vulkanInstance, VkSurfaceKHR windowSurface);
 	bool GetRequiredQueueFamilyIndices(VkPhysicalDevice physicalGpu, VkSurfaceKHR windowSurface);
+	void FindTransferQueueFamily(VkPhysicalDevice physicalGpu);
+	void FindComputeQueueFamily(VkPhysicalDevice physicalGpu);
 	bool HasPhysicalDeviceRequiredExtensionSupport(VkPhysicalDevice gpu);
 	bool CheckSwapChainSupport(VkPhysicalDevice gpu,VkSurfaceKHR windowSurface);
+	bool HasPhysicalDeviceExtension(VkPhysicalDevice gpu, const char* extensionName);
+	void QueryDeviceCapabilities(VkPhysicalDevice gpu);
 	void CreateLogicalDevice( VkPhysicalDevice physicalGpu);
 	void CreateQueues(VkDevice logicalDevice);
 	void CreateCommandPool(VkDevice logicalDevice);
+	// initialData comes from GetPipelineCacheData of an earlier run, it is dropped when it was
+	// written by another gpu or driver. Without a call pipelines are created without a cache
+	void CreatePipelineCache(const std::vector<char>& initialData);
+	VkPipelineCache GetPipelineCache() const { return PipelineCache; }
+	std::vector<char> GetPipelineCacheData() const;
 	VkFormat FindSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
+	// first memory type allowed by typeBits that has all the properties, UINT32_MAX if none
+	uint32_t FindMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const;
 	VkDevice GetLogicalDevice() const { return LogicalDevice; }
 	VkInstance GetInstance()const  { return VulkanInstance; }
 	VkPhysicalDevice GetGpu() const{ return PhysicalGpu; }
 	VkSurfaceKHR GetSurface()const { return WindowSurface; }
+	bool IsHeadless() const { return Window32Api == nullptr; }
 	VkCommandPool GetCommandPool() const { return CommandPool; }
 	VkQueue GetGraphicsQueue() const { return GraphicsQueue; }
 	VkQueue GetPresentQueue() const { return PresentationQueue; }
+	VkQueue GetTransferQueue() const { return TransferQueue; }
+	VkQueue GetComputeQueue() const { return ComputeQueue; }
 	int GetGraphicsQueueIndex() const { return GraphicsQueueIndex; }
 	int GetPresentationQueueIndex() const { return PresentationQueueIndex; }
+	int GetTransferQueueIndex() const { return TransferQueueIndex; }
+	// when true resources written by the transfer queue change owner before the graphics queue uses them
+	bool HasDedicatedTransferQueue() const { return TransferQueueIndex != GraphicsQueueIndex; }
+	int GetComputeQueueIndex() const { return ComputeQueueIndex; }
+	// when true compute work runs next to rendering, buffers shared by both queues are simplest
+	// created VK_SHARING_MODE_CONCURRENT over the compute and graphics families
+	bool HasDedicatedComputeQueue() const { return ComputeQueueIndex != GraphicsQueueIndex; }
+	const VulkanCapabilities& GetCapabilities() const { return Capabilities; }
+	DeletionQueue& GetDeletionQueue() const { return Deletions; }
+	// every device level call goes through it, see VulkanDispatch
+	const VulkanDispatch& GetDispatch() const { return Dispatch; }
+	// instance and physical device calls, see VulkanInstanceDispatch
+	const VulkanInstanceDispatch& GetInstanceDispatch() const { return InstanceDispatch; }
+	// pass it to every vkCreate/vkAllocate and the matching vkDestroy/vkFree
+	const VkAllocationCallbacks* GetAllocator() const { return HostAllocator.GetCallbacks(); }
+	HostAllocationStats GetHostAllocationStats() const { return HostAllocator.GetStats(); }
+	// every submit, present and queue wait goes through these
+	VkResult QueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo* submits, VkFence fence) const;
+	VkResult QueuePresent(const VkPresentInfoKHR& presentInfo) const;
+	VkResult QueueWaitIdle(VkQueue queue) const;
 
 };
 
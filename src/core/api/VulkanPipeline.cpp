@@ -6,7 +6,7 @@
 #include "core/api/pipelineConfigs/IVulkanPipelineConfiguration.h"
 #include "core/api/VertexBuffer.h"
 
-VulkanPipeline::VulkanPipeline( const VulkanLib& vulkan, const IVulkanPipelineConfigurationInfo& pipeLineConfigInfo, VertexBuffer* vertexBuffer)
+VulkanPipeline::VulkanPipeline( const VulkanLib& vulkan, const IVulkanPipelineConfigurationInfo& pipeLineConfigInfo, VertexBuffer* vertexBuffer, const ShaderList* shaders)
 	: Vulkan{vulkan}
 	, GraphicsPipeline{nullptr}
 	, VertexShaderModule{nullptr}
@@ -15,18 +15,23 @@ VulkanPipeline::VulkanPipeline( const VulkanLib& vulkan, const IVulkanPipelineCo
 	ASSERT_NOT_NULL(pipeLineConfigInfo.PipelineLayout, "Pipeline layout missing!\n");
 	ASSERT_NOT_NULL(pipeLineConfigInfo.Renderpass, "Render pass config info missing!\n");
 
-	CreateGraphicsPipeline(pipeLineConfigInfo,vertexBuffer);
+	CreateGraphicsPipeline(pipeLineConfigInfo,vertexBuffer,shaders);
 }
 
 VulkanPipeline::~VulkanPipeline()
 {
-	vkDestroyPipeline(Vulkan.GetLogicalDevice(), GraphicsPipeline,nullptr);
+	// frames in flight may still have it bound
+	Vulkan.GetDeletionQueue().DestroyPipeline(GraphicsPipeline);
 }
 
 
-void VulkanPipeline::CreateGraphicsPipeline(const IVulkanPipelineConfigurationInfo& pipeConfig, VertexBuffer* vertexBuffer)
+void VulkanPipeline::CreateGraphicsPipeline(const IVulkanPipelineConfigurationInfo& pipeConfig, VertexBuffer* vertexBuffer, const ShaderList* preloadedShaders)
 {
-	ShaderList shaders = ShaderLoader::loadShaders("glslShaders/vertex.spv", "glslShaders/fragment.spv");
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	ShaderList loadedShaders;
+	if (!preloadedShaders)
+		loadedShaders = LoadShaders();
+	const ShaderList& shaders = preloadedShaders ? *preloadedShaders : loadedShaders;
 	//TODO: create enums for the indices in shaders vector
 	VkShaderModule_T* vertexShaderModule = CreateShaderModule(shaders.at(0));
 	VkShaderModule_T* fragmentShaderModule = CreateShaderModule(shaders.at(1));
@@ -97,21 +102,28 @@ void VulkanPipeline::CreateGraphicsPipeline(const IVulkanPipelineConfigurationIn
 	graphicsPipelineCreateInfo.basePipelineIndex = -1;
 	graphicsPipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-	VK_CHECK(vkCreateGraphicsPipelines(Vulkan.GetLogicalDevice(), nullptr, 1, &graphicsPipelineCreateInfo, nullptr, &GraphicsPipeline));
+	VK_CHECK(vk.CreateGraphicsPipelines(Vulkan.GetLogicalDevice(), Vulkan.GetPipelineCache(), 1, &graphicsPipelineCreateInfo, Vulkan.GetAllocator(), &GraphicsPipeline));
 
 	//clean shaders
-	vkDestroyShaderModule(Vulkan.GetLogicalDevice(), vertexShaderModule, nullptr);
-	vkDestroyShaderModule(Vulkan.GetLogicalDevice(), fragmentShaderModule, nullptr);
+	vk.DestroyShaderModule(Vulkan.GetLogicalDevice(), vertexShaderModule, Vulkan.GetAllocator());
+	vk.DestroyShaderModule(Vulkan.GetLogicalDevice(), fragmentShaderModule, Vulkan.GetAllocator());
+}
+
+ShaderList VulkanPipeline::LoadShaders()
+{
+	return ShaderLoader::loadShaders("glslShaders/vertex.spv", "glslShaders/fragment.spv");
 }
 
 void VulkanPipeline::BindPipeline(VkCommandBuffer_T* cmdBuffer)
 {
-	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,GraphicsPipeline );
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	vk.CmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,GraphicsPipeline );
 }
 
 
 VkShaderModule_T* VulkanPipeline::CreateShaderModule(const std::vector<char>& code  )
 {
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
 	VkShaderModuleCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
 	createInfo.codeSize = code.size();
@@ -119,7 +131,7 @@ VkShaderModule_T* VulkanPipeline::CreateShaderModule(const std::vector<char>& co
 
 	VkShaderModule_T* shaderModule = {nullptr};
 
-	VK_CHECK(vkCreateShaderModule(Vulkan.GetLogicalDevice(), &createInfo, nullptr, &shaderModule));
+	VK_CHECK(vk.CreateShaderModule(Vulkan.GetLogicalDevice(), &createInfo, Vulkan.GetAllocator(), &shaderModule));
 
 	return shaderModule;
 }
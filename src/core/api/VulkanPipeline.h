@@ -3,6 +3,7 @@
 #include <vector>
 #include <vulkan/vulkan.h>
 #include "defines.h"
+#include "core/utils/ShaderLoader.h"
 
 class VulkanLib;
 class IVulkanPipelineConfigurationInfo;
@@ -17,10 +18,13 @@ class VulkanPipeline
 public:
 	
 	DISABLE_COPY( VulkanPipeline)
-	VulkanPipeline(const VulkanLib& vulkan,const IVulkanPipelineConfigurationInfo& pipeLineConfigInfo, VertexBuffer* vertexbuffer = nullptr );
+	// shaders from LoadShaders, read from disk when null
+	VulkanPipeline(const VulkanLib& vulkan,const IVulkanPipelineConfigurationInfo& pipeLineConfigInfo, VertexBuffer* vertexbuffer = nullptr, const ShaderList* shaders = nullptr );
 	~VulkanPipeline();
+	// the spir-v of the pipeline, doesn't need a device so it can be loaded ahead on any thread
+	static ShaderList LoadShaders();
 	VkShaderModule_T* CreateShaderModule(const std::vector<char>& code);
-	void CreateGraphicsPipeline(const IVulkanPipelineConfigurationInfo& pipeConfig, VertexBuffer* vb = nullptr);
+	void CreateGraphicsPipeline(const IVulkanPipelineConfigurationInfo& pipeConfig, VertexBuffer* vb = nullptr, const ShaderList* shaders = nullptr);
 	void BindPipeline(VkCommandBuffer_T* cmdBuffer);
 };
 
@@ -0,0 +1,118 @@
+#include "VulkanSubmitBatch.h"
+#include "core/debugger/public/Logger.h"
+#include "core/api/VulkanLib.h"
+
+VulkanSubmitBatch::VulkanSubmitBatch()
+	: WaitSemaphores{}
+	, WaitStages{}
+	, WaitValues{}
+	, CommandBuffers{}
+	, SignalSemaphores{}
+	, SignalValues{}
+	, Submits{}
+	, SubmitInfos{}
+	, TimelineInfos{}
+	, HasTimelineValues{ false }
+{
+}
+
+VulkanSubmitBatch::SubmitRange& VulkanSubmitBatch::_NewSubmit()
+{
+	SubmitRange submit = {};
+	submit.FirstWait = (uint32_t)WaitSemaphores.size();
+	submit.FirstCommandBuffer = (uint32_t)CommandBuffers.size();
+	submit.FirstSignal = (uint32_t)SignalSemaphores.size();
+	Submits.push_back(submit);
+	return Submits.back();
+}
+
+VulkanSubmitBatch::SubmitRange& VulkanSubmitBatch::_CurrentSubmit()
+{
+	if (Submits.empty())
+		return _NewSubmit();
+	return Submits.back();
+}
+
+void VulkanSubmitBatch::AddWait(VkSemaphore semaphore, VkPipelineStageFlags waitStage, uint64_t value)
+{
+	SubmitRange* submit = &_CurrentSubmit();
+	if (submit->CommandBufferCount > 0 || submit->SignalCount > 0)
+		submit = &_NewSubmit();
+
+	WaitSemaphores.push_back(semaphore);
+	WaitStages.push_back(waitStage);
+	WaitValues.push_back(value);
+	HasTimelineValues |= value != 0;
+	++submit->WaitCount;
+}
+
+void VulkanSubmitBatch::AddCommandBuffer(VkCommandBuffer commandBuffer)
+{
+	SubmitRange* submit = &_CurrentSubmit();
+	if (submit->SignalCount > 0)
+		submit = &_NewSubmit();
+
+	CommandBuffers.push_back(commandBuffer);
+	++submit->CommandBufferCount;
+}
+
+void VulkanSubmitBatch::AddSignal(VkSemaphore semaphore, uint64_t value)
+{
+	SubmitRange& submit = _CurrentSubmit();
+	SignalSemaphores.push_back(semaphore);
+	SignalValues.push_back(value);
+	HasTimelineValues |= value != 0;
+	++submit.SignalCount;
+}
+
+void VulkanSubmitBatch::Flush(const VulkanLib& vulkan, VkQueue queue, VkFence fence)
+{
+	// the pointers below go into the vectors, nothing can be added from here on
+	SubmitInfos.resize(Submits.size());
+	TimelineInfos.resize(Submits.size());
+
+	for (std::size_t i = 0; i < Submits.size(); ++i)
+	{
+		const SubmitRange& submit = Submits[i];
+
+		VkSubmitInfo& submitInfo = SubmitInfos[i];
+		submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.waitSemaphoreCount = submit.WaitCount;
+		submitInfo.pWaitSemaphores = WaitSemaphores.data() + submit.FirstWait;
+		submitInfo.pWaitDstStageMask = WaitStages.data() + submit.FirstWait;
+		submitInfo.commandBufferCount = submit.CommandBufferCount;
+		submitInfo.pCommandBuffers = CommandBuffers.data() + submit.FirstCommandBuffer;
+		submitInfo.signalSemaphoreCount = submit.SignalCount;
+		submitInfo.pSignalSemaphores = SignalSemaphores.data() + submit.FirstSignal;
+
+		if (HasTimelineValues)
+		{
+			// values for binary semaphores are ignored
+			VkTimelineSemaphoreSubmitInfo& timelineInfo = TimelineInfos[i];
+			timelineInfo = {};
+			timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+			timelineInfo.waitSemaphoreValueCount = submit.WaitCount;
+			timelineInfo.pWaitSemaphoreValues = WaitValues.data() + submit.FirstWait;
+			timelineInfo.signalSemaphoreValueCount = submit.SignalCount;
+			timelineInfo.pSignalSemaphoreValues = SignalValues.data() + submit.FirstSignal;
+			submitInfo.pNext = &timelineInfo;
+		}
+	}
+
+	// with nothing to submit this still signals the fence once the queue gets there
+	VK_CHECK(vulkan.QueueSubmit(queue, (uint32_t)SubmitInfos.size(), SubmitInfos.data(), fence));
+	Reset();
+}
+
+void VulkanSubmitBatch::Reset()
+{
+	WaitSemaphores.clear();
+	WaitStages.clear();
+	WaitValues.clear();
+	CommandBuffers.clear();
+	SignalSemaphores.clear();
+	SignalValues.clear();
+	Submits.clear();
+	HasTimelineValues = false;
+}
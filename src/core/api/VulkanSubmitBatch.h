@@ -0,0 +1,58 @@
+#ifndef VULKAN_SUBMIT_BATCH_HPP
+#define VULKAN_SUBMIT_BATCH_HPP
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "defines.h"
+
+class VulkanLib;
+
+// Gathers the work of a frame for one queue and sends it with a single vkQueueSubmit.
+// Waits, command buffers and signals are added in execution order. A new VkSubmitInfo is only
+// started when the order requires it: a wait after command buffers (so the earlier ones don't wait
+// too) or a command buffer after a signal (so the signal doesn't wait for it).
+// The vectors keep their capacity between frames, steady state frames don't allocate.
+class VulkanSubmitBatch
+{
+	struct SubmitRange
+	{
+		uint32_t FirstWait;
+		uint32_t WaitCount;
+		uint32_t FirstCommandBuffer;
+		uint32_t CommandBufferCount;
+		uint32_t FirstSignal;
+		uint32_t SignalCount;
+	};
+
+	std::vector<VkSemaphore> WaitSemaphores;
+	std::vector<VkPipelineStageFlags> WaitStages;
+	std::vector<uint64_t> WaitValues;
+	std::vector<VkCommandBuffer> CommandBuffers;
+	std::vector<VkSemaphore> SignalSemaphores;
+	std::vector<uint64_t> SignalValues;
+	std::vector<SubmitRange> Submits;
+	std::vector<VkSubmitInfo> SubmitInfos;
+	std::vector<VkTimelineSemaphoreSubmitInfo> TimelineInfos;
+	bool HasTimelineValues;// only then VkTimelineSemaphoreSubmitInfo is chained, 1.0 devices don't know it
+
+	SubmitRange& _NewSubmit();
+	SubmitRange& _CurrentSubmit();
+
+public:
+	DISABLE_COPY(VulkanSubmitBatch)
+	VulkanSubmitBatch();
+
+	// value is only used by timeline semaphores
+	void AddWait(VkSemaphore semaphore, VkPipelineStageFlags waitStage, uint64_t value = 0);
+	void AddCommandBuffer(VkCommandBuffer commandBuffer);
+	void AddSignal(VkSemaphore semaphore, uint64_t value = 0);
+
+	// one vkQueueSubmit for everything added since the last flush, the fence is signaled when it completes
+	void Flush(const VulkanLib& vulkan, VkQueue queue, VkFence fence = VK_NULL_HANDLE);
+	void Reset();
+	bool Empty() const { return Submits.empty(); }
+	uint32_t GetSubmitInfoCount() const { return (uint32_t)Submits.size(); }
+};
+
+#endif //VULKAN_SUBMIT_BATCH_HPP
@@ -1,16 +1,20 @@
+#define NOMINMAX
 #include "VulkanSwapChain.h"
 
 
 #include <cassert>
+#include <algorithm>
 #include "core/debugger/public/Logger.h"
+#include "core/debugger/public/CpuProfiler.h"
 #include "VulkanLib.h"
 
-VulkanSwapChain::VulkanSwapChain(VulkanLib& vulkan,VkExtent2D windowExtent)
+VulkanSwapChain::VulkanSwapChain(VulkanLib& vulkan,VkExtent2D windowExtent, const SwapChainSettings& settings)
 	: Vulkan{vulkan}
 	, WindowExtent{ windowExtent }
 	, SwapChainExtent{}
 	, SwapChain{}
 	, SwapChainImageFormat {}
+	, PresentMode{ VK_PRESENT_MODE_FIFO_KHR }
 	, DepthImages{}
 	, SwapChainImages{}
 	, DepthImageViews{}
@@ -18,11 +22,23 @@ VulkanSwapChain::VulkanSwapChain(VulkanLib& vulkan,VkExtent2D windowExtent)
 	, RenderPass{}
 	, DepthImageMemorys{}
 	, FrameBuffers{}
+	, Headless{ vulkan.IsHeadless() }
+	, OffscreenImageMemorys{}
+	, NextOffscreenImage{ 0 }
+	, Settings{ settings }
+	, FramesInFlight{ 0 }
 	, CurrentFrame{0}
 	, ImageAvailableSemaphores{}
 	, RenderFinishedSemaphores{}
+	, UseTimelineSemaphore{ vulkan.GetCapabilities().TimelineSemaphore }
+	, FrameTimeline{ VK_NULL_HANDLE }
 	, InFlightFences {}
-	, ImagesInFlight{}
+	, SubmittedFrameValue{ 0 }
+	, CompletedFrameValue{ 0 }
+	, FrameSlotValues{}
+	, ImageFrameValues{}
+	, FrameBatch{}
+	, LateLatchCallback{}
 {
 	_CreateSwapChain();
 	_CreateImageViews();
@@ -35,53 +51,64 @@ VulkanSwapChain::VulkanSwapChain(VulkanLib& vulkan,VkExtent2D windowExtent)
 
 VulkanSwapChain::~VulkanSwapChain()
 {
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
 
 	VkDevice logicalDevice = Vulkan.GetLogicalDevice();
 
 	for (auto imageView : SwapChainImageViews)
 	{
-		vkDestroyImageView(logicalDevice, imageView, nullptr);
+		vk.DestroyImageView(logicalDevice, imageView, Vulkan.GetAllocator());
 	}
 	SwapChainImageViews.clear();
 	
 
-	vkDestroySwapchainKHR(logicalDevice, SwapChain, nullptr);
+	if (SwapChain != VK_NULL_HANDLE)
+		vk.DestroySwapchainKHR(logicalDevice, SwapChain, Vulkan.GetAllocator());
+	for (std::size_t i = 0; i < OffscreenImageMemorys.size(); ++i)
+	{
+		vk.DestroyImage(logicalDevice, SwapChainImages[i], Vulkan.GetAllocator());
+		vk.FreeMemory(logicalDevice, OffscreenImageMemorys[i], Vulkan.GetAllocator());
+	}
 
 	for (int i = 0; i < DepthImages.size(); ++i)
 	{
-		vkDestroyImageView(logicalDevice, DepthImageViews[i],nullptr);
-		vkDestroyImage(logicalDevice, DepthImages[i], nullptr);
-		vkFreeMemory(logicalDevice, DepthImageMemorys[i], nullptr);
+		vk.DestroyImageView(logicalDevice, DepthImageViews[i], Vulkan.GetAllocator());
+		vk.DestroyImage(logicalDevice, DepthImages[i], Vulkan.GetAllocator());
+		vk.FreeMemory(logicalDevice, DepthImageMemorys[i], Vulkan.GetAllocator());
 	}
 
 	for (auto framebuffer : FrameBuffers)
 	{
-		vkDestroyFramebuffer(logicalDevice, framebuffer, nullptr);
+		vk.DestroyFramebuffer(logicalDevice, framebuffer, Vulkan.GetAllocator());
 	}
-	vkDestroyRenderPass(logicalDevice, RenderPass, nullptr);
+	vk.DestroyRenderPass(logicalDevice, RenderPass, Vulkan.GetAllocator());
 
-	for (int i = 0; i < MAX_FRAMES_TO_BE_PROCESSED; ++i)
-	{
-		vkDestroySemaphore(logicalDevice, RenderFinishedSemaphores[i], nullptr);
-		vkDestroySemaphore(logicalDevice, ImageAvailableSemaphores[i], nullptr);
-		vkDestroyFence(logicalDevice, InFlightFences[i], nullptr);
-	}
+	_DestroyFrameSlots();
+	vk.DestroySemaphore(logicalDevice, FrameTimeline, Vulkan.GetAllocator());
 
 }
 
 void VulkanSwapChain::_CreateSwapChain()
 {
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	if (Headless)
+	{
+		_CreateOffscreenImages();
+		return;
+	}
+
 	//Check if currentExtent has been set if not we need to set it manually
+	const VulkanInstanceDispatch& vki = Vulkan.GetInstanceDispatch();
 	VkSurfaceCapabilitiesKHR capabilities = {};
-	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(Vulkan.GetGpu(), Vulkan.GetSurface(), &capabilities);
+	vki.GetPhysicalDeviceSurfaceCapabilitiesKHR(Vulkan.GetGpu(), Vulkan.GetSurface(), &capabilities);
 	//resolution of images in the swap chain
 	SwapChainExtent = (capabilities.currentExtent.width == -1 || capabilities.currentExtent.height == -1)
 		? SwapChainExtent = WindowExtent : SwapChainExtent = capabilities.currentExtent;
 	// Querry which formats are available in this gpu and choose the appropiate one
 	uint32_t formatCount = {};
-	vkGetPhysicalDeviceSurfaceFormatsKHR(Vulkan.GetGpu(), Vulkan.GetSurface(), &formatCount, nullptr);
+	vki.GetPhysicalDeviceSurfaceFormatsKHR(Vulkan.GetGpu(), Vulkan.GetSurface(), &formatCount, nullptr);
 	std::vector<VkSurfaceFormatKHR> availableSurfaceFormats(formatCount);
-	vkGetPhysicalDeviceSurfaceFormatsKHR(Vulkan.GetGpu(), Vulkan.GetSurface(), &formatCount, availableSurfaceFormats.data());
+	vki.GetPhysicalDeviceSurfaceFormatsKHR(Vulkan.GetGpu(), Vulkan.GetSurface(), &formatCount, availableSurfaceFormats.data());
 	
 	VkSurfaceFormatKHR surfaceFormat = {};
 	for (const VkSurfaceFormatKHR& surfaceformat : availableSurfaceFormats)
@@ -94,24 +121,22 @@ void VulkanSwapChain::_CreateSwapChain()
 
 	// Choose the best avaliable presenting mode
 	uint32_t presentModeCount = {};
-	vkGetPhysicalDeviceSurfacePresentModesKHR(Vulkan.GetGpu(), Vulkan.GetSurface(), &presentModeCount,nullptr);
+	vki.GetPhysicalDeviceSurfacePresentModesKHR(Vulkan.GetGpu(), Vulkan.GetSurface(), &presentModeCount,nullptr);
 	std::vector<VkPresentModeKHR> availablePresentModes(presentModeCount);
-	vkGetPhysicalDeviceSurfacePresentModesKHR(Vulkan.GetGpu(), Vulkan.GetSurface(), &presentModeCount, availablePresentModes.data());
-
-	VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+	vki.GetPhysicalDeviceSurfacePresentModesKHR(Vulkan.GetGpu(), Vulkan.GetSurface(), &presentModeCount, availablePresentModes.data());
 
-	for (VkPresentModeKHR mode : availablePresentModes)
-	{
-		if (mode == VK_PRESENT_MODE_MAILBOX_KHR)
-			presentMode = mode;
-	}
+	PresentMode = _ChoosePresentMode(availablePresentModes);
+	LOG_TRACE("Present mode:%d\n", PresentMode)
 
 	// Image count, triple buffering, double buffering we need to check the minimum supported and maximum
-	uint32_t minImageCount = capabilities.maxImageCount > 0 ? capabilities.maxImageCount : 3;
+	// maxImageCount == 0 means there is no maximum
+	uint32_t minImageCount = std::max(Settings.ImageCount, capabilities.minImageCount);
+	if (capabilities.maxImageCount > 0)
+		minImageCount = std::min(minImageCount, capabilities.maxImageCount);
 
 	VkSwapchainCreateInfoKHR swapChainCreateInfo = {};
 	swapChainCreateInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-	swapChainCreateInfo.minImageCount = 4;
+	swapChainCreateInfo.minImageCount = minImageCount;
 	swapChainCreateInfo.surface = Vulkan.GetSurface();
 	swapChainCreateInfo.imageFormat = surfaceFormat.format;
 	swapChainCreateInfo.imageColorSpace = surfaceFormat.colorSpace;
@@ -122,7 +147,7 @@ void VulkanSwapChain::_CreateSwapChain()
 	// parameter use indicate if we want to use the alpha channel to blend the window with other windows
 	// in the window system. We don't want to 99% of the time
 	swapChainCreateInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-	swapChainCreateInfo.presentMode = presentMode;
+	swapChainCreateInfo.presentMode = PresentMode;
 	swapChainCreateInfo.clipped = VK_TRUE; // clipp pixels that we don't see e.g: other window in front of our window
 															   
 	/* If the presentation queue and the graphics queue are not the same then we need
@@ -140,22 +165,88 @@ void VulkanSwapChain::_CreateSwapChain()
 		swapChainCreateInfo.pQueueFamilyIndices = queueFamilyIndices;
 	}
 	// SwapChain can become invalid or unoptimize when the app is running e.g: window resize
-	// in that case we will need to recreate from scratch the swap chain and give a reference
-	// to the old swapChain
-	swapChainCreateInfo.oldSwapchain = VK_NULL_HANDLE;
+	// or we switch the present mode. We hand the old swapChain to the new one so the driver
+	// can reuse its resources and keep presenting the old images until the new ones are ready
+	VkSwapchainKHR oldSwapChain = SwapChain;
+	swapChainCreateInfo.oldSwapchain = oldSwapChain;
 
-	VK_CHECK(vkCreateSwapchainKHR(Vulkan.GetLogicalDevice(), &swapChainCreateInfo, nullptr, &SwapChain));
+	VK_CHECK(vk.CreateSwapchainKHR(Vulkan.GetLogicalDevice(), &swapChainCreateInfo, Vulkan.GetAllocator(), &SwapChain));
+
+	// the old swap chain is retired now, it goes away once the frames presenting from it are done
+	if (oldSwapChain != VK_NULL_HANDLE)
+	{
+		VkDevice device = Vulkan.GetLogicalDevice();
+		const VkAllocationCallbacks* allocator = Vulkan.GetAllocator();
+		Vulkan.GetDeletionQueue().Push([dispatch = &vk, device, allocator, oldSwapChain]()
+		{
+			dispatch->DestroySwapchainKHR(device, oldSwapChain, allocator);
+		});
+	}
 
 	//get handles to the Images the are allocated with the swap chain and destroy when the swap chain is destroyed
 	uint32_t imageCount {0};
-	vkGetSwapchainImagesKHR(Vulkan.GetLogicalDevice(),SwapChain,&imageCount,nullptr);
+	vk.GetSwapchainImagesKHR(Vulkan.GetLogicalDevice(),SwapChain,&imageCount,nullptr);
 	SwapChainImages.resize(imageCount);
-	vkGetSwapchainImagesKHR(Vulkan.GetLogicalDevice(), SwapChain, &imageCount, SwapChainImages.data());
+	vk.GetSwapchainImagesKHR(Vulkan.GetLogicalDevice(), SwapChain, &imageCount, SwapChainImages.data());
 
 }
 
+void VulkanSwapChain::_CreateOffscreenImages()
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	VkDevice device = Vulkan.GetLogicalDevice();
+	SwapChainExtent = WindowExtent;
+	// same formats a surface would give us, so pipelines and shaders behave the same
+	SwapChainImageFormat = Vulkan.FindSupportedFormat(
+		{ VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_R8G8B8A8_UNORM }
+		, VK_IMAGE_TILING_OPTIMAL
+		, VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT);
+	PresentMode = VK_PRESENT_MODE_FIFO_KHR;// nothing is presented, only reported
+
+	uint32_t imageCount = std::max(1u, Settings.ImageCount);
+	SwapChainImages.resize(imageCount);
+	OffscreenImageMemorys.resize(imageCount);
+	NextOffscreenImage = 0;
+
+	for (uint32_t i = 0; i < imageCount; ++i)
+	{
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent.width = SwapChainExtent.width;
+		imageInfo.extent.height = SwapChainExtent.height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = SwapChainImageFormat;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		// transfer src so tests and benchmarks can read the frames back
+		imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VK_CHECK(vk.CreateImage(device, &imageInfo, Vulkan.GetAllocator(), &SwapChainImages[i]));
+
+		VkMemoryRequirements memRequirements;
+		vk.GetImageMemoryRequirements(device, SwapChainImages[i], &memRequirements);
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = memRequirements.size;
+		allocInfo.memoryTypeIndex = Vulkan.FindMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		if (allocInfo.memoryTypeIndex == UINT32_MAX)
+			LOG_ERR("No device local memory for the offscreen images\n")
+
+		VK_CHECK(vk.AllocateMemory(device, &allocInfo, Vulkan.GetAllocator(), &OffscreenImageMemorys[i]));
+		VK_CHECK(vk.BindImageMemory(device, SwapChainImages[i], OffscreenImageMemorys[i], 0));
+	}
+	LOG_TRACE("Headless, %d offscreen images %dx%d\n", imageCount, SwapChainExtent.width, SwapChainExtent.height)
+}
+
 void VulkanSwapChain::_CreateImageViews()
 {
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
 	SwapChainImageViews.resize(SwapChainImages.size());
 
 	for (int i = 0; i < SwapChainImages.size(); ++i)
@@ -175,47 +266,91 @@ void VulkanSwapChain::_CreateImageViews()
 		createInfo.subresourceRange.layerCount = 1;
 		createInfo.subresourceRange.baseArrayLayer = 0;
 
-		VK_CHECK(vkCreateImageView(Vulkan.GetLogicalDevice(), &createInfo, nullptr, &SwapChainImageViews[i]));
+		VK_CHECK(vk.CreateImageView(Vulkan.GetLogicalDevice(), &createInfo, Vulkan.GetAllocator(), &SwapChainImageViews[i]));
 	}
 }
 
-void VulkanSwapChain::CleanupSwapChain() 
+void VulkanSwapChain::_RetireSwapChainResources()
 {
-	VkDevice device = Vulkan.GetLogicalDevice();
-	for (size_t i = 0; i <FrameBuffers.size(); i++) {
-		vkDestroyFramebuffer(device, FrameBuffers[i], nullptr);
-	}
-
-	vkDestroyRenderPass(device, RenderPass, nullptr);
+	// frames in flight still render to these, hand them to the deletion queue
+	DeletionQueue& deletionQueue = Vulkan.GetDeletionQueue();
+	for (VkFramebuffer framebuffer : FrameBuffers)
+		deletionQueue.DestroyFramebuffer(framebuffer);
+	for (VkImageView imageView : SwapChainImageViews)
+		deletionQueue.DestroyImageView(imageView);
+	for (std::size_t i = 0; i < DepthImages.size(); ++i)
+		deletionQueue.DestroyImage(DepthImages[i], DepthImageViews[i], DepthImageMemorys[i]);
+	// swap chain images belong to the swap chain, offscreen ones are ours
+	for (std::size_t i = 0; i < OffscreenImageMemorys.size(); ++i)
+		deletionQueue.DestroyImage(SwapChainImages[i], VK_NULL_HANDLE, OffscreenImageMemorys[i]);
+	OffscreenImageMemorys.clear();
+
+	FrameBuffers.clear();
+	SwapChainImageViews.clear();
+	DepthImages.clear();
+	DepthImageViews.clear();
+	DepthImageMemorys.clear();
+}
 
-	for (size_t i = 0; i < SwapChainImageViews.size(); i++) {
-		vkDestroyImageView(device, SwapChainImageViews[i], nullptr);
+VkPresentModeKHR VulkanSwapChain::_ChoosePresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) const
+{
+	std::vector<VkPresentModeKHR> preferredModes;
+	switch (Settings.PresentMode)
+	{
+	case PRESENT_MODE_POLICY::LOW_LATENCY: preferredModes = { VK_PRESENT_MODE_MAILBOX_KHR }; break;
+	case PRESENT_MODE_POLICY::POWER_SAVING: preferredModes = {}; break;
+	case PRESENT_MODE_POLICY::UNCAPPED: preferredModes = { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR }; break;
+	case PRESENT_MODE_POLICY::ADAPTIVE: preferredModes = { VK_PRESENT_MODE_FIFO_RELAXED_KHR }; break;
 	}
 
-	for (auto imageView : DepthImageViews)
+	for (VkPresentModeKHR preferred : preferredModes)
 	{
-		vkDestroyImageView(device, imageView, nullptr);
+		for (VkPresentModeKHR mode : availablePresentModes)
+		{
+			if (mode == preferred)
+				return mode;
+		}
 	}
-
-	vkDestroySwapchainKHR(device, SwapChain, nullptr);
+	// FIFO is the only mode the spec requires
+	return VK_PRESENT_MODE_FIFO_KHR;
 }
 
 
-void VulkanSwapChain::RecreateSwapChain()
+void VulkanSwapChain::RecreateSwapChain(VkExtent2D windowExtent)
 {
-	
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	WindowExtent = windowExtent;
+	VkFormat previousImageFormat = SwapChainImageFormat;
+
+	_RetireSwapChainResources();
 	_CreateSwapChain();
 	_CreateImageViews();
 	_CreateDepthImageViews();
-	_CreateRenderPass();
-	// recreate graphics pipeline
-	_CreateFrameBuffers();	
-
-
+	// the render pass only depends on the attachment formats, keeping it keeps the
+	// pipelines created against it valid
+	if (SwapChainImageFormat != previousImageFormat)
+	{
+		LOG_WARN("Swap chain format changed, pipelines must be recreated\n")
+		VkDevice device = Vulkan.GetLogicalDevice();
+		VkRenderPass oldRenderPass = RenderPass;
+		const VkAllocationCallbacks* allocator = Vulkan.GetAllocator();
+		Vulkan.GetDeletionQueue().Push([dispatch = &vk, device, allocator, oldRenderPass]()
+		{
+			dispatch->DestroyRenderPass(device, oldRenderPass, allocator);
+		});
+		_CreateRenderPass();
+	}
+	_CreateFrameBuffers();
+	// the new images have not been rendered yet
+	ImageFrameValues.assign(SwapChainImages.size(), 0);
+	// the image count may have changed and frames in flight can't exceed it
+	if (_ClampFramesInFlight() != FramesInFlight)
+		SetFramesInFlight(Settings.FramesInFlight);
 }
 
 void VulkanSwapChain::_CreateDepthImageViews()
 {
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
 	VkFormat depthFormat = Vulkan.FindSupportedFormat(
 		{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
 		VK_IMAGE_TILING_OPTIMAL,
@@ -244,17 +379,17 @@ void VulkanSwapChain::_CreateDepthImageViews()
 		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		imageInfo.flags = 0;
 
-		VK_CHECK(vkCreateImage(Vulkan.GetLogicalDevice(), &imageInfo, nullptr, &DepthImages[i])," failed to create image!\n");
+		VK_CHECK(vk.CreateImage(Vulkan.GetLogicalDevice(), &imageInfo, Vulkan.GetAllocator(), &DepthImages[i])," failed to create image!\n");
 
 		VkMemoryRequirements memRequirements;
-		vkGetImageMemoryRequirements(Vulkan.GetLogicalDevice(), DepthImages[i], &memRequirements);
+		vk.GetImageMemoryRequirements(Vulkan.GetLogicalDevice(), DepthImages[i], &memRequirements);
 
 		VkMemoryAllocateInfo allocInfo{};
 		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 		allocInfo.allocationSize = memRequirements.size;
 
 		VkPhysicalDeviceMemoryProperties memProperties;
-		vkGetPhysicalDeviceMemoryProperties(Vulkan.GetGpu(), &memProperties);
+		Vulkan.GetInstanceDispatch().GetPhysicalDeviceMemoryProperties(Vulkan.GetGpu(), &memProperties);
 		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
 		{
 			if ((memRequirements.memoryTypeBits & (1 << i)) &&
@@ -264,9 +399,9 @@ void VulkanSwapChain::_CreateDepthImageViews()
 			}
 		}
 
-		VK_CHECK(vkAllocateMemory(Vulkan.GetLogicalDevice(), &allocInfo, nullptr, &DepthImageMemorys[i])," failed to allocate image memory!\n");
+		VK_CHECK(vk.AllocateMemory(Vulkan.GetLogicalDevice(), &allocInfo, Vulkan.GetAllocator(), &DepthImageMemorys[i])," failed to allocate image memory!\n");
 
-		VK_CHECK(vkBindImageMemory(Vulkan.GetLogicalDevice(), DepthImages[i], DepthImageMemorys[i], 0), " bind image memory!\n");
+		VK_CHECK(vk.BindImageMemory(Vulkan.GetLogicalDevice(), DepthImages[i], DepthImageMemorys[i], 0), " bind image memory!\n");
 
 		VkImageViewCreateInfo viewInfo{};
 		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -279,13 +414,14 @@ void VulkanSwapChain::_CreateDepthImageViews()
 		viewInfo.subresourceRange.baseArrayLayer = 0;
 		viewInfo.subresourceRange.layerCount = 1;
 
-		VK_CHECK(vkCreateImageView(Vulkan.GetLogicalDevice(), &viewInfo, nullptr, &DepthImageViews[i]),"failed to create texture image view!\n");
+		VK_CHECK(vk.CreateImageView(Vulkan.GetLogicalDevice(), &viewInfo, Vulkan.GetAllocator(), &DepthImageViews[i]),"failed to create texture image view!\n");
 	}
 }
 
 
 void VulkanSwapChain::_CreateRenderPass()
 {
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
 	/*
 	   RENDER_PASS :- specify array of attachments and how they will be used eg: color attach, depth,stencil...
 	                - specify layout location in which framebuffer attachment to use
@@ -306,7 +442,8 @@ void VulkanSwapChain::_CreateRenderPass()
 	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	// offscreen images are left ready to be copied out
+	colorAttachment.finalLayout = Headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
 	//We will use one depth/stencil attachment
 	VkAttachmentDescription depthStencilAttachment = {};
@@ -366,11 +503,12 @@ void VulkanSwapChain::_CreateRenderPass()
 	renderPassInfo.dependencyCount = 1;
 	renderPassInfo.pDependencies = &dependency;
 
-	VK_CHECK(vkCreateRenderPass(Vulkan.GetLogicalDevice(), &renderPassInfo, nullptr, &RenderPass));
+	VK_CHECK(vk.CreateRenderPass(Vulkan.GetLogicalDevice(), &renderPassInfo, Vulkan.GetAllocator(), &RenderPass));
 }
 
 void VulkanSwapChain::_CreateFrameBuffers()
 {
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
 	FrameBuffers.resize(SwapChainImages.size());
 	
 	for (int i = 0; i < FrameBuffers.size(); ++i)
@@ -386,32 +524,173 @@ void VulkanSwapChain::_CreateFrameBuffers()
 		framebuffCreateInf.height = SwapChainExtent.height;
 		framebuffCreateInf.layers = 1;
 
-		VK_CHECK(vkCreateFramebuffer(Vulkan.GetLogicalDevice(), &framebuffCreateInf, nullptr, &FrameBuffers[i]));
+		VK_CHECK(vk.CreateFramebuffer(Vulkan.GetLogicalDevice(), &framebuffCreateInf, Vulkan.GetAllocator(), &FrameBuffers[i]));
 	}
 }
 
 void VulkanSwapChain::_CreateSyncronizationObjects()
 {
-	ImageAvailableSemaphores.resize(MAX_FRAMES_TO_BE_PROCESSED);
-	RenderFinishedSemaphores.resize(MAX_FRAMES_TO_BE_PROCESSED);
-	InFlightFences.resize(MAX_FRAMES_TO_BE_PROCESSED);
-	ImagesInFlight.resize(SwapChainImages.size(),VK_NULL_HANDLE);
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	ImageFrameValues.assign(SwapChainImages.size(), 0);
+
+	//CPU-GPU
+	if (UseTimelineSemaphore)
+	{
+		// one counter for all the frames, the gpu sets it to the frame value when the frame is done
+		VkSemaphoreTypeCreateInfo timelineInfo = {};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		timelineInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo timelineSemaphoreInfo = {};
+		timelineSemaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		timelineSemaphoreInfo.pNext = &timelineInfo;
+
+		VK_CHECK(vk.CreateSemaphore(Vulkan.GetLogicalDevice(), &timelineSemaphoreInfo, Vulkan.GetAllocator(), &FrameTimeline));
+	}
 
+	FramesInFlight = _ClampFramesInFlight();
+	_CreateFrameSlots();
+}
+
+void VulkanSwapChain::_CreateFrameSlots()
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	ImageAvailableSemaphores.resize(FramesInFlight);
+	RenderFinishedSemaphores.resize(FramesInFlight);
+	FrameSlotValues.assign(FramesInFlight, 0);
+	CurrentFrame = 0;
 
 	VkSemaphoreCreateInfo semaphoreInfo = {};
 	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-	//CPU-GPU
+	for (uint32_t i = 0; i < FramesInFlight; ++i)
+	{
+		VK_CHECK(vk.CreateSemaphore(Vulkan.GetLogicalDevice(), &semaphoreInfo, Vulkan.GetAllocator(), &ImageAvailableSemaphores[i]));
+		VK_CHECK(vk.CreateSemaphore(Vulkan.GetLogicalDevice(), &semaphoreInfo, Vulkan.GetAllocator(), &RenderFinishedSemaphores[i]));
+	}
+
+	if (UseTimelineSemaphore)
+		return;
+
 	VkFenceCreateInfo fenceInfo = {};
 	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
 	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;// avoid unsignal initial state
-	
-	for (int i = 0; i < MAX_FRAMES_TO_BE_PROCESSED; ++i)
+
+	InFlightFences.resize(FramesInFlight);
+	for (uint32_t i = 0; i < FramesInFlight; ++i)
+	{
+		VK_CHECK(vk.CreateFence(Vulkan.GetLogicalDevice(), &fenceInfo, Vulkan.GetAllocator(), &InFlightFences[i]));
+	}
+}
+
+void VulkanSwapChain::_DestroyFrameSlots()
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	VkDevice logicalDevice = Vulkan.GetLogicalDevice();
+	for (std::size_t i = 0; i < ImageAvailableSemaphores.size(); ++i)
 	{
-		VK_CHECK(vkCreateSemaphore(Vulkan.GetLogicalDevice(), &semaphoreInfo, nullptr, &ImageAvailableSemaphores[i]));
-		VK_CHECK(vkCreateSemaphore(Vulkan.GetLogicalDevice(), &semaphoreInfo, nullptr, &RenderFinishedSemaphores[i]));
-		VK_CHECK(vkCreateFence(Vulkan.GetLogicalDevice(), &fenceInfo, nullptr, &InFlightFences[i]));
+		vk.DestroySemaphore(logicalDevice, RenderFinishedSemaphores[i], Vulkan.GetAllocator());
+		vk.DestroySemaphore(logicalDevice, ImageAvailableSemaphores[i], Vulkan.GetAllocator());
 	}
+	for (VkFence fence : InFlightFences)
+	{
+		vk.DestroyFence(logicalDevice, fence, Vulkan.GetAllocator());
+	}
+	ImageAvailableSemaphores.clear();
+	RenderFinishedSemaphores.clear();
+	InFlightFences.clear();
+}
+
+uint32_t VulkanSwapChain::_ClampFramesInFlight() const
+{
+	uint32_t imageCount = static_cast<uint32_t>(SwapChainImages.size());
+	return std::max(1u, std::min(Settings.FramesInFlight, imageCount));
+}
+
+void VulkanSwapChain::SetFramesInFlight(uint32_t framesInFlight)
+{
+	Settings.FramesInFlight = framesInFlight;
+	uint32_t clampedFramesInFlight = _ClampFramesInFlight();
+	if (clampedFramesInFlight == FramesInFlight)
+		return;
+
+	// Only the per frame slot objects are rebuilt. The frames using them must be done and the
+	// presentation engine may still wait on the render finished semaphores, so drain the present queue
+	WaitForFrameValue(SubmittedFrameValue);
+	Vulkan.QueueWaitIdle(Vulkan.GetPresentQueue());
+
+	_DestroyFrameSlots();
+	FramesInFlight = clampedFramesInFlight;
+	_CreateFrameSlots();
+	LOG_TRACE("Frames in flight:%d\n", FramesInFlight)
+}
+
+bool VulkanSwapChain::ApplySettings(const SwapChainSettings& settings)
+{
+	bool recreate = settings.ImageCount != Settings.ImageCount
+		|| settings.PresentMode != Settings.PresentMode;
+	Settings.ImageCount = settings.ImageCount;
+	Settings.PresentMode = settings.PresentMode;
+	SetFramesInFlight(settings.FramesInFlight);
+	return recreate;
+}
+
+uint64_t VulkanSwapChain::GetCompletedFrameValue()
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	if (UseTimelineSemaphore)
+	{
+		VK_CHECK(vk.GetSemaphoreCounterValue(Vulkan.GetLogicalDevice(), FrameTimeline, &CompletedFrameValue));
+		return CompletedFrameValue;
+	}
+
+	// frames finish in submission order, the newest signaled fence tells how far the gpu got
+	for (std::size_t i = 0; i < InFlightFences.size(); ++i)
+	{
+		if (FrameSlotValues[i] > CompletedFrameValue
+			&& vk.GetFenceStatus(Vulkan.GetLogicalDevice(), InFlightFences[i]) == VK_SUCCESS)
+		{
+			CompletedFrameValue = FrameSlotValues[i];
+		}
+	}
+	return CompletedFrameValue;
+}
+
+void VulkanSwapChain::WaitForFrameValue(uint64_t frameValue)
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	// a value that was never submitted never completes: the timeline wait would block forever
+	// and the fence path below would take it as done
+	assert(frameValue <= SubmittedFrameValue);
+	if (frameValue <= CompletedFrameValue || frameValue > SubmittedFrameValue)
+		return;
+
+	// the "wait" zones add up to the queue waits of a frame, see HitchDetector
+	PROFILE_SCOPE("wait gpu frame");
+	if (UseTimelineSemaphore)
+	{
+		VkSemaphoreWaitInfo waitInfo = {};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &FrameTimeline;
+		waitInfo.pValues = &frameValue;
+		VK_CHECK(vk.WaitSemaphores(Vulkan.GetLogicalDevice(), &waitInfo, UINT64_MAX));
+		CompletedFrameValue = frameValue;
+		return;
+	}
+
+	// a frame value still in flight is owned by one of the frame slots, if no slot has it
+	// the slot was reused and the frame waited on already
+	for (std::size_t i = 0; i < InFlightFences.size(); ++i)
+	{
+		if (FrameSlotValues[i] == frameValue)
+		{
+			vk.WaitForFences(Vulkan.GetLogicalDevice(), 1, &InFlightFences[i], VK_TRUE, UINT64_MAX);
+			break;
+		}
+	}
+	CompletedFrameValue = frameValue;
 }
 
 VkFramebuffer VulkanSwapChain::GetFrameBuffer(int index) const 
@@ -420,57 +699,90 @@ VkFramebuffer VulkanSwapChain::GetFrameBuffer(int index) const
 	return FrameBuffers.at(index); 
 }
 
-VkResult VulkanSwapChain::AdquireNextImage(uint32_t* index)
+VkResult VulkanSwapChain::AdquireNextImage(uint32_t* index, uint64_t timeout)
 {
-	vkWaitForFences(Vulkan.GetLogicalDevice(), 1, &InFlightFences[CurrentFrame], VK_TRUE, UINT64_MAX);
-
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	// wait until the gpu is done with the frame that used this frame slot last time
+	WaitForFrameValue(FrameSlotValues[CurrentFrame]);
+	// and destroy whatever the finished frames were still using
+	Vulkan.GetDeletionQueue().Flush(GetCompletedFrameValue());
+
+	// round robin, SubmitCommandBuffers waits for the frame that rendered the image last
+	if (Headless)
+	{
+		*index = NextOffscreenImage;
+		NextOffscreenImage = (NextOffscreenImage + 1) % (uint32_t)SwapChainImages.size();
+		return VK_SUCCESS;
+	}
 
-	return vkAcquireNextImageKHR(Vulkan.GetLogicalDevice(), SwapChain, UINT64_MAX, ImageAvailableSemaphores[CurrentFrame], VK_NULL_HANDLE, index);
+	PROFILE_SCOPE("wait acquire");
+	return vk.AcquireNextImageKHR(Vulkan.GetLogicalDevice(), SwapChain, timeout, ImageAvailableSemaphores[CurrentFrame], VK_NULL_HANDLE, index);
 }
 
 VkResult VulkanSwapChain::SubmitCommandBuffers(const VkCommandBuffer* cmdBuffer, uint32_t* imageIndex)
 {
-	//Check if a previouse frame is using this image(i.e there is its fence to wait on)
-	if (ImagesInFlight[*imageIndex] != VK_NULL_HANDLE)
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	//Check if a previouse frame is using this image(i.e there is its frame value to wait on)
+	WaitForFrameValue(ImageFrameValues[*imageIndex]);
+
+	const uint64_t frameValue = ++SubmittedFrameValue;
+	Vulkan.GetDeletionQueue().SetSubmittedFrameValue(frameValue);
+	FrameSlotValues[CurrentFrame] = frameValue;
+	ImageFrameValues[*imageIndex] = frameValue;
+
+	// Only the frame command buffer waits for the image, passes added before it to the batch
+	// can run while the presentation engine still holds the image
+	// headless there is no presentation engine to sync with
+	if (!Headless)
+		FrameBatch.AddWait(ImageAvailableSemaphores[CurrentFrame], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+	FrameBatch.AddCommandBuffer(*cmdBuffer);
+	if (!Headless)
+		FrameBatch.AddSignal(RenderFinishedSemaphores[CurrentFrame]);
+
+	VkFence frameFence = VK_NULL_HANDLE;
+	if (UseTimelineSemaphore)
 	{
-		vkWaitForFences(Vulkan.GetLogicalDevice(), 1, &ImagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
+		FrameBatch.AddSignal(FrameTimeline, frameValue);
+	}
+	else
+	{
+		frameFence = InFlightFences[CurrentFrame];
+		vk.ResetFences(Vulkan.GetLogicalDevice(), 1, &frameFence);
 	}
-	ImagesInFlight[*imageIndex] = InFlightFences[CurrentFrame];
-
-
-	VkSemaphore waitSemaphores[] = { ImageAvailableSemaphores[CurrentFrame] };
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-
-	VkSemaphore signalSemaphores[] = { RenderFinishedSemaphores[CurrentFrame] };
 
-	VkSubmitInfo submitInfo = {};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = waitSemaphores;
-	submitInfo.pWaitDstStageMask = waitStages;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = cmdBuffer;
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = signalSemaphores;
+	if (LateLatchCallback)
+		LateLatchCallback(frameValue);
 
-	vkResetFences(Vulkan.GetLogicalDevice(), 1, &InFlightFences[CurrentFrame]);
+	// one vkQueueSubmit for the whole frame
+	FrameBatch.Flush(Vulkan, Vulkan.GetGraphicsQueue(), frameFence);
 
-	VK_CHECK(vkQueueSubmit(Vulkan.GetGraphicsQueue(), 1, &submitInfo, InFlightFences[CurrentFrame]));
+	if (Headless)
+	{
+		CurrentFrame = (CurrentFrame + 1) % FramesInFlight;
+		return VK_SUCCESS;
+	}
 
+	VkSemaphore renderFinished = RenderFinishedSemaphores[CurrentFrame];
 	VkSwapchainKHR swapChains[] = { SwapChain };
 
 	VkPresentInfoKHR presentInfo = {};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = signalSemaphores;
+	presentInfo.pWaitSemaphores = &renderFinished;
 	presentInfo.swapchainCount = 1;
 	presentInfo.pSwapchains = swapChains; // pretty much always 1
 	presentInfo.pResults = nullptr;
 	presentInfo.pImageIndices = imageIndex;
 
-	return vkQueuePresentKHR(Vulkan.GetPresentQueue(), &presentInfo);
+	// blocks in fifo mode once the presentation engine is a few images behind
+	VkResult result;
+	{
+		PROFILE_SCOPE("wait present");
+		result = Vulkan.QueuePresent(presentInfo);
+	}
 
-	CurrentFrame = (CurrentFrame + 1) % MAX_FRAMES_TO_BE_PROCESSED;
+	CurrentFrame = (CurrentFrame + 1) % FramesInFlight;
+	return result;
 }
 
 
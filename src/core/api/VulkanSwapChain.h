@@ -1,11 +1,30 @@
 #ifndef VULKAN_SWAP_CHAIN_HPP
 #define VULKAN_SWAP_CHAIN_HPP
 
+#include <functional>
 #include <vector>
 #include <vulkan/vulkan.h>
+#include "core/api/VulkanSubmitBatch.h"
 
 class VulkanLib;
 
+// How we want images presented, each policy falls back to FIFO that is always available
+enum class PRESENT_MODE_POLICY
+{
+	LOW_LATENCY,// MAILBOX: no tearing, newest frame replaces the queued one
+	POWER_SAVING,// FIFO: vsync, the gpu idles between frames
+	UNCAPPED,// IMMEDIATE: no vsync, benchmark runs
+	ADAPTIVE// FIFO_RELAXED: vsync but late frames are shown straight away
+};
+
+// Runtime knobs to trade latency for throughput, clamped to what the surface allows
+struct SwapChainSettings
+{
+	uint32_t ImageCount = 3;// swap chain images we ask for
+	uint32_t FramesInFlight = 2;// frames the cpu can record ahead of the gpu, at most ImageCount
+	PRESENT_MODE_POLICY PresentMode = PRESENT_MODE_POLICY::LOW_LATENCY;
+};
+
 class VulkanSwapChain
 {
 	VulkanLib& Vulkan;
@@ -13,43 +32,101 @@ class VulkanSwapChain
 	VkExtent2D SwapChainExtent;
 	VkSwapchainKHR SwapChain;
 	VkFormat SwapChainImageFormat;
+	VkPresentModeKHR PresentMode;
 	std::vector<VkImage> DepthImages;
 	std::vector<VkImage> SwapChainImages;
 	std::vector<VkImageView> DepthImageViews;
 	std::vector<VkImageView> SwapChainImageViews;
 	std::vector<VkDeviceMemory> DepthImageMemorys;
 	std::vector<VkFramebuffer> FrameBuffers;
+	// Headless: no VkSwapchainKHR, SwapChainImages is a ring of offscreen images we own. Acquire
+	// takes the next one and present does nothing, everything else is shared with the window path
+	bool Headless;
+	std::vector<VkDeviceMemory> OffscreenImageMemorys;
+	uint32_t NextOffscreenImage;
 	VkRenderPass RenderPass;
+	SwapChainSettings Settings;
 	//Sync objects
 	// Allow multiple frames to be in flight but bound the amount of work that piles
-	static constexpr int MAX_FRAMES_TO_BE_PROCESSED = 2;
+	uint32_t FramesInFlight;
 	std::size_t CurrentFrame;
 	// GPU-GPU syncronization, each frame needs its own set of semaphores 
 	std::vector<VkSemaphore> ImageAvailableSemaphores;
 	std::vector<VkSemaphore> RenderFinishedSemaphores;
 	//CPU - GPU syncronization  Inflight means currently being rendering/presented to the monitor
+	// Every submitted frame gets an increasing frame value. When the device supports it a single
+	// timeline semaphore is signaled with that value, otherwise each frame slot has its own fence
+	bool UseTimelineSemaphore;
+	VkSemaphore FrameTimeline;
 	std::vector<VkFence> InFlightFences;
-	std::vector<VkFence> ImagesInFlight;
+	uint64_t SubmittedFrameValue;// value of the last frame sent to the gpu
+	uint64_t CompletedFrameValue;// last value we know the gpu has finished
+	std::vector<uint64_t> FrameSlotValues;// frame value last submitted from each frame slot
+	std::vector<uint64_t> ImageFrameValues;// frame value last rendering to each swap chain image
+	// everything the frame sends to the graphics queue, flushed with one vkQueueSubmit before the present
+	VulkanSubmitBatch FrameBatch;
+	// writes the late latched data of the frame right before its submit, see SetLateLatchCallback
+	std::function<void(uint64_t)> LateLatchCallback;
 public:
 	~VulkanSwapChain();
-	VulkanSwapChain(VulkanLib& vulkan,VkExtent2D windowExtend);
+	VulkanSwapChain(VulkanLib& vulkan,VkExtent2D windowExtend, const SwapChainSettings& settings = {});
 	VkExtent2D GetSwapChainExtent() const { return SwapChainExtent; }
 	VkRenderPass GetRenderPass() const { return RenderPass; }
 	VkFramebuffer GetFrameBuffer(int index) const; 
-	VkResult AdquireNextImage(uint32_t* index);
+	// the color image of a framebuffer, headless images end in TRANSFER_SRC_OPTIMAL to be read back
+	VkImage GetImage(uint32_t index) const { return SwapChainImages.at(index); }
+	VkFormat GetImageFormat() const { return SwapChainImageFormat; }
+	bool IsHeadless() const { return Headless; }
+	// timeout in nanoseconds, VK_TIMEOUT/VK_NOT_READY leave the frame slot untouched and the call can be retried
+	VkResult AdquireNextImage(uint32_t* index, uint64_t timeout = UINT64_MAX);
+	// Adds the frame command buffer (the one rendering to the swap chain image) to the frame batch,
+	// submits the whole batch and presents
 	VkResult SubmitCommandBuffers(const VkCommandBuffer* cmdBuffer, uint32_t* ImageIndex);
-	void CleanupSwapChain();
+	// Work of this frame that goes before the frame command buffer: other passes, waits on other
+	// queues... none of it waits for the swap chain image, only the frame command buffer does
+	VulkanSubmitBatch& GetFrameBatch() { return FrameBatch; }
+	// Called from SubmitCommandBuffers with the frame value of the frame being submitted, after it was
+	// recorded and immediately before vkQueueSubmit: the last moment the cpu can change what the gpu reads
+	void SetLateLatchCallback(std::function<void(uint64_t)> callback) { LateLatchCallback = std::move(callback); }
 	std::size_t ImageCount() const { return SwapChainImages.size(); }
-	void RecreateSwapChain();
+	// No device idle: the old swap chain is handed to the new one and the old images, views
+	// and framebuffers are destroyed through the deletion queue once the frames using them finish
+	void RecreateSwapChain(VkExtent2D windowExtent);
+	// returns true when the swap chain must be recreated for the settings to take effect,
+	// a frames in flight change is applied straight away
+	bool ApplySettings(const SwapChainSettings& settings);
+	void SetFramesInFlight(uint32_t framesInFlight);
+	uint32_t GetFramesInFlight() const { return FramesInFlight; }
+	// frame slot of the frame being built, resources indexed by it are free again after AdquireNextImage
+	std::size_t GetCurrentFrame() const { return CurrentFrame; }
+	// frame value AdquireNextImage waits on before the current frame slot can be reused
+	uint64_t GetCurrentFrameSlotValue() const { return FrameSlotValues[CurrentFrame]; }
+	VkPresentModeKHR GetPresentMode() const { return PresentMode; }
+	// GPU progress, other subsystems (uploads, deletion queues...) can tag work with
+	// GetSubmittedFrameValue() and know it is done once GetCompletedFrameValue() reaches it
+	bool UsesTimelineSemaphore() const { return UseTimelineSemaphore; }
+	VkSemaphore GetFrameTimeline() const { return FrameTimeline; }
+	uint64_t GetSubmittedFrameValue() const { return SubmittedFrameValue; }
+	// the value the next SubmitCommandBuffers gives its frame, only meaningful on the thread submitting frames
+	uint64_t GetNextFrameValue() const { return SubmittedFrameValue + 1; }
+	uint64_t GetCompletedFrameValue();
+	// frameValue must have been submitted already, see GetSubmittedFrameValue
+	void WaitForFrameValue(uint64_t frameValue);
 
 private:
 	void _CreateSwapChain();
+	void _CreateOffscreenImages();
+	void _RetireSwapChainResources();
+	VkPresentModeKHR _ChoosePresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) const;
 	void _CreateImageViews();
 	void _CreateDepthImageViews();
 	// framebuffer attachments that will be used while rendering
 	void _CreateRenderPass();
 	void _CreateFrameBuffers();
 	void _CreateSyncronizationObjects();
+	void _CreateFrameSlots();
+	void _DestroyFrameSlots();
+	uint32_t _ClampFramesInFlight() const;
 };
 
 #endif //VULKAN_SWAP_CHAIN_HPP
\ No newline at end of file
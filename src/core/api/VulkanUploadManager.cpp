@@ -0,0 +1,432 @@
+#include "VulkanUploadManager.h"
+
+#include <cstring>
+#include <stdexcept>
+#include "core/debugger/public/Logger.h"
+#include "VulkanLib.h"
+
+// Barrier that takes a copy to its first use. When the resource changes queue family the same
+// barrier is recorded twice, as release on the transfer queue and as acquire on the graphics queue
+static VkBufferMemoryBarrier MakeBufferBarrier(VkBuffer buffer, const VkBufferCopy& region, VkAccessFlags srcAccess, VkAccessFlags dstAccess, uint32_t srcFamily, uint32_t dstFamily)
+{
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = dstAccess;
+	barrier.srcQueueFamilyIndex = srcFamily;
+	barrier.dstQueueFamilyIndex = dstFamily;
+	barrier.buffer = buffer;
+	barrier.offset = region.dstOffset;
+	barrier.size = region.size;
+	return barrier;
+}
+
+static VkImageMemoryBarrier MakeImageBarrier(VkImage image, const VkImageSubresourceRange& range, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess, uint32_t srcFamily, uint32_t dstFamily)
+{
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = dstAccess;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	barrier.srcQueueFamilyIndex = srcFamily;
+	barrier.dstQueueFamilyIndex = dstFamily;
+	barrier.image = image;
+	barrier.subresourceRange = range;
+	return barrier;
+}
+
+VulkanUploadManager::VulkanUploadManager(const VulkanLib& vulkan, VkDeviceSize stagingSize)
+	: Vulkan{ vulkan }
+	, StagingSize{ stagingSize }
+	, StagingBuffer{ VK_NULL_HANDLE }
+	, StagingMemory{ VK_NULL_HANDLE }
+	, StagingData{ nullptr }
+	, StagingHead{ 0 }
+	, StagingTail{ 0 }
+	, TransferCommandPool{ VK_NULL_HANDLE }
+	, GraphicsCommandPool{ VK_NULL_HANDLE }
+	, Batches{}
+	, NextBatch{ 0 }
+	, PendingBuffers{}
+	, PendingImages{}
+	, BufferBarriers{}
+	, ImageBarriers{}
+	, Lock{}
+{
+	_CreateStagingBuffer();
+	_CreateCommandObjects();
+}
+
+VulkanUploadManager::~VulkanUploadManager()
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	WaitIdle();
+
+	VkDevice device = Vulkan.GetLogicalDevice();
+	for (Batch& batch : Batches)
+	{
+		vk.DestroyFence(device, batch.Done, Vulkan.GetAllocator());
+		vk.DestroySemaphore(device, batch.Released, Vulkan.GetAllocator());
+	}
+	// destroying the pools frees their command buffers
+	vk.DestroyCommandPool(device, TransferCommandPool, Vulkan.GetAllocator());
+	vk.DestroyCommandPool(device, GraphicsCommandPool, Vulkan.GetAllocator());
+
+	vk.UnmapMemory(device, StagingMemory);
+	vk.DestroyBuffer(device, StagingBuffer, Vulkan.GetAllocator());
+	vk.FreeMemory(device, StagingMemory, Vulkan.GetAllocator());
+}
+
+void VulkanUploadManager::_CreateStagingBuffer()
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	VkDevice device = Vulkan.GetLogicalDevice();
+
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = StagingSize;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;// only the transfer queue reads it
+
+	VK_CHECK(vk.CreateBuffer(device, &bufferInfo, Vulkan.GetAllocator(), &StagingBuffer));
+
+	VkMemoryRequirements memRequirements;
+	vk.GetBufferMemoryRequirements(device, StagingBuffer, &memRequirements);
+
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = Vulkan.FindMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	if (allocInfo.memoryTypeIndex == UINT32_MAX)
+		LOG_ERR("No host visible memory for the staging buffer\n")
+
+	VK_CHECK(vk.AllocateMemory(device, &allocInfo, Vulkan.GetAllocator(), &StagingMemory));
+	VK_CHECK(vk.BindBufferMemory(device, StagingBuffer, StagingMemory, 0));
+
+	// mapped for the whole life of the manager, coherent so no flushes are needed
+	void* data = nullptr;
+	VK_CHECK(vk.MapMemory(device, StagingMemory, 0, StagingSize, 0, &data));
+	StagingData = static_cast<uint8_t*>(data);
+}
+
+void VulkanUploadManager::_CreateCommandObjects()
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	VkDevice device = Vulkan.GetLogicalDevice();
+	bool dedicatedTransfer = Vulkan.HasDedicatedTransferQueue();
+
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = Vulkan.GetTransferQueueIndex();
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	VK_CHECK(vk.CreateCommandPool(device, &poolInfo, Vulkan.GetAllocator(), &TransferCommandPool));
+
+	if (dedicatedTransfer)
+	{
+		poolInfo.queueFamilyIndex = Vulkan.GetGraphicsQueueIndex();
+		VK_CHECK(vk.CreateCommandPool(device, &poolInfo, Vulkan.GetAllocator(), &GraphicsCommandPool));
+	}
+
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = 1;
+
+	VkSemaphoreCreateInfo semaphoreInfo = {};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	VkFenceCreateInfo fenceInfo = {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	for (Batch& batch : Batches)
+	{
+		batch = {};
+		allocInfo.commandPool = TransferCommandPool;
+		VK_CHECK(vk.AllocateCommandBuffers(device, &allocInfo, &batch.TransferCommands));
+		if (dedicatedTransfer)
+		{
+			allocInfo.commandPool = GraphicsCommandPool;
+			VK_CHECK(vk.AllocateCommandBuffers(device, &allocInfo, &batch.AcquireCommands));
+			VK_CHECK(vk.CreateSemaphore(device, &semaphoreInfo, Vulkan.GetAllocator(), &batch.Released));
+		}
+		VK_CHECK(vk.CreateFence(device, &fenceInfo, Vulkan.GetAllocator(), &batch.Done));
+	}
+}
+
+VkDeviceSize VulkanUploadManager::_ReserveStaging(VkDeviceSize size, VkDeviceSize alignment)
+{
+	// not a LOG_ERR, release builds would copy past the end of the staging buffer
+	if (size > StagingSize)
+		throw std::length_error("Upload bigger than the staging buffer, create the upload manager with a bigger staging size");
+
+	for (;;)
+	{
+		// an upload that doesn't fit before the end of the ring skips the rest and starts at 0
+		VkDeviceSize position = StagingHead % StagingSize;
+		VkDeviceSize offset = (position + alignment - 1) / alignment * alignment;
+		VkDeviceSize skipped = offset - position;
+		if (offset + size > StagingSize)
+		{
+			skipped = StagingSize - position;
+			offset = 0;
+		}
+		if (StagingHead + skipped + size - StagingTail <= StagingSize)
+		{
+			StagingHead += skipped + size;
+			return offset;
+		}
+
+		// a batch finished since the last upload
+		if (_RetireBatches(false))
+			continue;
+		// the space is held by queued uploads or by batches still on the gpu, only the oldest is waited for
+		Flush();
+		if (!_RetireBatches(true))
+		{
+			// nothing queued and nothing on the gpu, only the skipped end of the ring was in the way
+			StagingHead = 0;
+			StagingTail = 0;
+		}
+	}
+}
+
+void VulkanUploadManager::_WaitBatch(Batch& batch)
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	if (!batch.InFlight)
+		return;
+	VK_CHECK(vk.WaitForFences(Vulkan.GetLogicalDevice(), 1, &batch.Done, VK_TRUE, UINT64_MAX));
+	batch.InFlight = false;
+	// callers go from the oldest batch to the newest, the tail only moves forward
+	StagingTail = batch.StagingEnd;
+}
+
+bool VulkanUploadManager::_RetireBatches(bool waitOldest)
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	// batches are used in turn, the next one is the oldest
+	bool retired = false;
+	for (uint32_t i = 0; i < BATCH_COUNT; ++i)
+	{
+		Batch& batch = Batches[(NextBatch + i) % BATCH_COUNT];
+		if (!batch.InFlight)
+			continue;
+		if (waitOldest)
+		{
+			_WaitBatch(batch);
+			return true;
+		}
+		if (vk.GetFenceStatus(Vulkan.GetLogicalDevice(), batch.Done) != VK_SUCCESS)
+			break;
+		_WaitBatch(batch);
+		retired = true;
+	}
+	return retired;
+}
+
+void VulkanUploadManager::UploadBuffer(VkBuffer destination, const void* data, VkDeviceSize size, VkDeviceSize dstOffset, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+{
+	std::lock_guard<std::recursive_mutex> lock(Lock);
+	VkDeviceSize stagingOffset = _ReserveStaging(size, 4);
+	std::memcpy(StagingData + stagingOffset, data, (std::size_t)size);
+
+	BufferUpload upload = {};
+	upload.Destination = destination;
+	upload.Region.srcOffset = stagingOffset;
+	upload.Region.dstOffset = dstOffset;
+	upload.Region.size = size;
+	upload.DstStage = dstStage;
+	upload.DstAccess = dstAccess;
+	PendingBuffers.push_back(upload);
+	// grown here rather than by the flush in the frame loop
+	BufferBarriers.reserve(PendingBuffers.size());
+}
+
+void VulkanUploadManager::UploadImage(VkImage destination, const void* data, VkDeviceSize size, VkExtent3D extent, VkImageAspectFlags aspect, VkImageLayout finalLayout, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+{
+	std::lock_guard<std::recursive_mutex> lock(Lock);
+	// buffer offsets of image copies must be a multiple of the texel size and of 4, 16 covers every format
+	VkDeviceSize stagingOffset = _ReserveStaging(size, 16);
+	std::memcpy(StagingData + stagingOffset, data, (std::size_t)size);
+
+	ImageUpload upload = {};
+	upload.Destination = destination;
+	upload.Region.bufferOffset = stagingOffset;
+	upload.Region.bufferRowLength = 0;// tightly packed
+	upload.Region.bufferImageHeight = 0;
+	upload.Region.imageSubresource.aspectMask = aspect;
+	upload.Region.imageSubresource.mipLevel = 0;
+	upload.Region.imageSubresource.baseArrayLayer = 0;
+	upload.Region.imageSubresource.layerCount = 1;
+	upload.Region.imageOffset = { 0, 0, 0 };
+	upload.Region.imageExtent = extent;
+	upload.Range.aspectMask = aspect;
+	upload.Range.baseMipLevel = 0;
+	upload.Range.levelCount = 1;
+	upload.Range.baseArrayLayer = 0;
+	upload.Range.layerCount = 1;
+	upload.FinalLayout = finalLayout;
+	upload.DstStage = dstStage;
+	upload.DstAccess = dstAccess;
+	PendingImages.push_back(upload);
+	ImageBarriers.reserve(PendingImages.size());
+}
+
+void VulkanUploadManager::_RecordTransfer(VkCommandBuffer commandBuffer, bool releaseOwnership)
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	// images come in UNDEFINED, move them to a layout we can copy to
+	ImageBarriers.clear();
+	for (const ImageUpload& upload : PendingImages)
+	{
+		ImageBarriers.push_back(MakeImageBarrier(upload.Destination, upload.Range
+			, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+			, 0, VK_ACCESS_TRANSFER_WRITE_BIT
+			, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED));
+	}
+	if (!ImageBarriers.empty())
+	{
+		vk.CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0
+			, 0, nullptr, 0, nullptr, (uint32_t)ImageBarriers.size(), ImageBarriers.data());
+	}
+
+	for (const BufferUpload& upload : PendingBuffers)
+		vk.CmdCopyBuffer(commandBuffer, StagingBuffer, upload.Destination, 1, &upload.Region);
+	for (const ImageUpload& upload : PendingImages)
+		vk.CmdCopyBufferToImage(commandBuffer, StagingBuffer, upload.Destination, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &upload.Region);
+
+	// Same family: one barrier straight to the first use.
+	// Dedicated transfer family: release to the graphics family, the access masks of the other
+	// side are ignored by a release and the graphics queue finishes the job in _RecordAcquire
+	uint32_t srcFamily = releaseOwnership ? (uint32_t)Vulkan.GetTransferQueueIndex() : VK_QUEUE_FAMILY_IGNORED;
+	uint32_t dstFamily = releaseOwnership ? (uint32_t)Vulkan.GetGraphicsQueueIndex() : VK_QUEUE_FAMILY_IGNORED;
+	VkPipelineStageFlags dstStages = 0;
+
+	BufferBarriers.clear();
+	for (const BufferUpload& upload : PendingBuffers)
+	{
+		BufferBarriers.push_back(MakeBufferBarrier(upload.Destination, upload.Region
+			, VK_ACCESS_TRANSFER_WRITE_BIT, releaseOwnership ? 0 : upload.DstAccess, srcFamily, dstFamily));
+		dstStages |= upload.DstStage;
+	}
+
+	ImageBarriers.clear();
+	for (const ImageUpload& upload : PendingImages)
+	{
+		ImageBarriers.push_back(MakeImageBarrier(upload.Destination, upload.Range
+			, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, upload.FinalLayout
+			, VK_ACCESS_TRANSFER_WRITE_BIT, releaseOwnership ? 0 : upload.DstAccess, srcFamily, dstFamily));
+		dstStages |= upload.DstStage;
+	}
+
+	// a transfer-only queue doesn't know about graphics stages
+	vk.CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT
+		, releaseOwnership ? (VkPipelineStageFlags)VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : dstStages, 0
+		, 0, nullptr
+		, (uint32_t)BufferBarriers.size(), BufferBarriers.data()
+		, (uint32_t)ImageBarriers.size(), ImageBarriers.data());
+}
+
+void VulkanUploadManager::_RecordAcquire(VkCommandBuffer commandBuffer)
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	// must match the release barriers, apart from the access masks of the transfer side
+	uint32_t srcFamily = (uint32_t)Vulkan.GetTransferQueueIndex();
+	uint32_t dstFamily = (uint32_t)Vulkan.GetGraphicsQueueIndex();
+	VkPipelineStageFlags dstStages = 0;
+
+	BufferBarriers.clear();
+	for (const BufferUpload& upload : PendingBuffers)
+	{
+		BufferBarriers.push_back(MakeBufferBarrier(upload.Destination, upload.Region, 0, upload.DstAccess, srcFamily, dstFamily));
+		dstStages |= upload.DstStage;
+	}
+
+	ImageBarriers.clear();
+	for (const ImageUpload& upload : PendingImages)
+	{
+		ImageBarriers.push_back(MakeImageBarrier(upload.Destination, upload.Range
+			, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, upload.FinalLayout
+			, 0, upload.DstAccess, srcFamily, dstFamily));
+		dstStages |= upload.DstStage;
+	}
+
+	vk.CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStages, 0
+		, 0, nullptr
+		, (uint32_t)BufferBarriers.size(), BufferBarriers.data()
+		, (uint32_t)ImageBarriers.size(), ImageBarriers.data());
+}
+
+void VulkanUploadManager::Flush()
+{
+	const VulkanDispatch& vk = Vulkan.GetDispatch();
+	std::lock_guard<std::recursive_mutex> lock(Lock);
+	if (!HasPendingUploads())
+		return;
+
+	VkDevice device = Vulkan.GetLogicalDevice();
+	bool releaseOwnership = Vulkan.HasDedicatedTransferQueue();
+
+	Batch& batch = Batches[NextBatch];
+	NextBatch = (NextBatch + 1) % BATCH_COUNT;
+	// only blocks when BATCH_COUNT flushes are still on the gpu
+	_WaitBatch(batch);
+	VK_CHECK(vk.ResetFences(device, 1, &batch.Done));
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	VK_CHECK(vk.BeginCommandBuffer(batch.TransferCommands, &beginInfo));
+	_RecordTransfer(batch.TransferCommands, releaseOwnership);
+	VK_CHECK(vk.EndCommandBuffer(batch.TransferCommands));
+
+	VkSubmitInfo transferSubmit = {};
+	transferSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	transferSubmit.commandBufferCount = 1;
+	transferSubmit.pCommandBuffers = &batch.TransferCommands;
+	if (releaseOwnership)
+	{
+		transferSubmit.signalSemaphoreCount = 1;
+		transferSubmit.pSignalSemaphores = &batch.Released;
+	}
+	VK_CHECK(Vulkan.QueueSubmit(Vulkan.GetTransferQueue(), 1, &transferSubmit, releaseOwnership ? VK_NULL_HANDLE : batch.Done));
+
+	if (releaseOwnership)
+	{
+		// Graphics submits made after this one are ordered after the acquire,
+		// so frames never wait on the copies themselves, only on this tiny command buffer
+		VK_CHECK(vk.BeginCommandBuffer(batch.AcquireCommands, &beginInfo));
+		_RecordAcquire(batch.AcquireCommands);
+		VK_CHECK(vk.EndCommandBuffer(batch.AcquireCommands));
+
+		VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		VkSubmitInfo acquireSubmit = {};
+		acquireSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		acquireSubmit.waitSemaphoreCount = 1;
+		acquireSubmit.pWaitSemaphores = &batch.Released;
+		acquireSubmit.pWaitDstStageMask = &waitStage;
+		acquireSubmit.commandBufferCount = 1;
+		acquireSubmit.pCommandBuffers = &batch.AcquireCommands;
+		VK_CHECK(Vulkan.QueueSubmit(Vulkan.GetGraphicsQueue(), 1, &acquireSubmit, batch.Done));
+	}
+
+	batch.StagingEnd = StagingHead;
+	batch.InFlight = true;
+	PendingBuffers.clear();
+	PendingImages.clear();
+}
+
+bool VulkanUploadManager::HasPendingUploads()
+{
+	std::lock_guard<std::recursive_mutex> lock(Lock);
+	return !PendingBuffers.empty() || !PendingImages.empty();
+}
+
+void VulkanUploadManager::WaitIdle()
+{
+	std::lock_guard<std::recursive_mutex> lock(Lock);
+	for (uint32_t i = 0; i < BATCH_COUNT; ++i)
+		_WaitBatch(Batches[(NextBatch + i) % BATCH_COUNT]);
+}
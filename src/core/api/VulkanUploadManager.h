@@ -0,0 +1,106 @@
+#ifndef VULKAN_UPLOAD_MANAGER_HPP
+#define VULKAN_UPLOAD_MANAGER_HPP
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "defines.h"
+
+class VulkanLib;
+
+// Copies data into device local buffers and images from the transfer queue.
+// Uploads are only queued when requested, Flush() copies all of them with a single command
+// buffer, so loading many small meshes or textures costs one submit instead of one per resource.
+// The staging buffer is a ring, the space of a flush is reused as soon as its fence signaled.
+// When the gpu has a dedicated transfer family the resources are released from it and acquired
+// by the graphics family, so the graphics queue never waits for the copies to be recorded.
+// Thread safe, loading code on the main thread can upload while the present thread flushes
+class VulkanUploadManager
+{
+	struct BufferUpload
+	{
+		VkBuffer Destination;
+		VkBufferCopy Region;
+		VkPipelineStageFlags DstStage;
+		VkAccessFlags DstAccess;
+	};
+
+	struct ImageUpload
+	{
+		VkImage Destination;
+		VkBufferImageCopy Region;
+		VkImageSubresourceRange Range;
+		VkImageLayout FinalLayout;
+		VkPipelineStageFlags DstStage;
+		VkAccessFlags DstAccess;
+	};
+
+	// one flush on its way through the gpu
+	struct Batch
+	{
+		VkCommandBuffer TransferCommands;
+		VkCommandBuffer AcquireCommands;// graphics queue side of the ownership transfer
+		VkSemaphore Released;// transfer queue done, the graphics queue can acquire
+		VkFence Done;
+		VkDeviceSize StagingEnd;// StagingHead when it was flushed, the ring is free up to there once Done signaled
+		bool InFlight;
+	};
+
+	static constexpr uint32_t BATCH_COUNT = 3;
+
+	const VulkanLib& Vulkan;
+	VkDeviceSize StagingSize;
+	VkBuffer StagingBuffer;
+	VkDeviceMemory StagingMemory;
+	uint8_t* StagingData;// persistently mapped
+	// bytes handed out and given back since the start, the ring offset is modulo StagingSize
+	VkDeviceSize StagingHead;
+	VkDeviceSize StagingTail;
+	VkCommandPool TransferCommandPool;
+	VkCommandPool GraphicsCommandPool;
+	Batch Batches[BATCH_COUNT];
+	uint32_t NextBatch;
+	std::vector<BufferUpload> PendingBuffers;
+	std::vector<ImageUpload> PendingImages;
+	// kept between flushes, Flush runs in the frame loop and must not allocate
+	std::vector<VkBufferMemoryBarrier> BufferBarriers;
+	std::vector<VkImageMemoryBarrier> ImageBarriers;
+	// recursive: running out of staging space flushes from inside an upload
+	std::recursive_mutex Lock;
+
+	void _CreateStagingBuffer();
+	void _CreateCommandObjects();
+	VkDeviceSize _ReserveStaging(VkDeviceSize size, VkDeviceSize alignment);
+	void _WaitBatch(Batch& batch);
+	bool _RetireBatches(bool waitOldest);
+	void _RecordTransfer(VkCommandBuffer commandBuffer, bool releaseOwnership);
+	void _RecordAcquire(VkCommandBuffer commandBuffer);
+
+public:
+	DISABLE_COPY(VulkanUploadManager)
+	VulkanUploadManager(const VulkanLib& vulkan, VkDeviceSize stagingSize = 16 * 1024 * 1024);
+	~VulkanUploadManager();
+
+	// The data is copied to the staging buffer right away, the caller can free it on return.
+	// Throws std::length_error when size is bigger than the whole staging buffer.
+	// dstStage/dstAccess describe the first use of the resource on the graphics queue
+	void UploadBuffer(VkBuffer destination, const void* data, VkDeviceSize size, VkDeviceSize dstOffset = 0
+		, VkPipelineStageFlags dstStage = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+		, VkAccessFlags dstAccess = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT);
+	// whole mip 0 of a 2D image in UNDEFINED layout, left in finalLayout
+	void UploadImage(VkImage destination, const void* data, VkDeviceSize size, VkExtent3D extent
+		, VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT
+		, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+		, VkPipelineStageFlags dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+		, VkAccessFlags dstAccess = VK_ACCESS_SHADER_READ_BIT);
+
+	// Submits everything queued since the last flush. Graphics work submitted after this
+	// sees the uploaded data, nothing here blocks unless the staging buffer is full
+	void Flush();
+	// blocks until every flushed upload has completed
+	void WaitIdle();
+	bool HasPendingUploads();
+};
+
+#endif //VULKAN_UPLOAD_MANAGER_HPP
@@ -1,4 +1,4 @@
-#include "VulkanPipeLineDefaultConfiguration.h"
+#include "VulkanPipelineDefaultConfiguration.h"
 
 
 void VulkanPipelineDefaultConfiguration::CreatePipelineConfigInfo( uint32_t width, uint32_t height)
@@ -1,6 +1,6 @@
 #ifndef VULKAN_PIPELINE_DEFAULT_CONFIGURATION_HPP
 #define VULKAN_PIPELINE_DEFAULT_CONFIGURATION_HPP
-#include "IVulkanPipeLineConfiguration.h"
+#include "IVulkanPipelineConfiguration.h"
 
 class VulkanPipelineDefaultConfiguration : public IVulkanPipelineConfigurationInfo
 {
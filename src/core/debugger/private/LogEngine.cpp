@@ -4,7 +4,6 @@
 #include <cstdio>
 #include <cstdarg>
 #include <cassert>
-#include <string>
 #include "core/debugger/public/LoggListeners.h"
 
 LogEngine* LogEngine::LogEngineInstance = nullptr;
@@ -52,24 +51,30 @@ LogEngine* LogEngine::GetLogEngineInstance()
 	 va_list temp;
 	 va_copy(temp, args);
 
-	 int size =  _vscprintf(message, args);
+	 // formatted on the stack, logging from the frame loop mustn't hit the heap (see AllocationTracker)
+	 char stackBuffer[1024];
+	 int size = vsnprintf(stackBuffer, sizeof(stackBuffer), message, args);
+	 va_end(args);
 
-	std::vector<char> buffer ((uint32_t)size + 1);
+	 // only messages that don't fit allocate
+	 std::vector<char> heapBuffer;
+	 const char* text = stackBuffer;
+	 if (size >= (int)sizeof(stackBuffer))
+	 {
+		 heapBuffer.resize((uint32_t)size + 1);
+		 vsnprintf(heapBuffer.data(), heapBuffer.size(), message, temp);
+		 text = heapBuffer.data();
+	 }
+	 va_end(temp);
+	 if (size < 0)
+		 text = message;
 
-	vsnprintf(buffer.data(), buffer.size(), message, temp);
-	va_end(args);
-	
-	std::string str{ buffer.begin(),buffer.end() };
-	 
 	 for (int i = 0; i < LogListeners.size(); ++i)
 	 {
 		 ILogListener* l = LogListeners[i];
 		 if(l && l->active)
-			 l->LogMsg(type,  str.c_str());
+			 l->LogMsg(type, text);
 	 }
-
-
-
  }
 
  void LogEngine::RegisterListener(ILogListener* listener)
@@ -1,6 +1,6 @@
 #pragma once
 #ifdef LOG_ENGINE_INCLUDE
-#error don't include LogEngine.h use Logger.h instead
+#error do not include LogEngine.h, use Logger.h instead
 #endif
 #include "core/debugger/public/ILogListener.h"
 #include <vector>
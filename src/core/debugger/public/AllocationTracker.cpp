@@ -0,0 +1,365 @@
+#include "AllocationTracker.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#ifdef _WIN32
+#include <Windows.h>
+#include <DbgHelp.h>
+#else
+#include <execinfo.h>
+#endif
+
+namespace
+{
+	// written by its thread on every allocation, read by EndFrame. Plain statics: operator new
+	// runs before main and after the other statics are gone
+	struct ThreadSlot
+	{
+		std::atomic<const char*> Name;
+		std::atomic<uint64_t> Allocations;
+		std::atomic<uint64_t> Frees;
+		std::atomic<uint64_t> Bytes;
+		std::atomic<bool> InUse;// handed back when its thread exits, the counts just carry on
+	};
+
+	struct GuardHit
+	{
+		std::atomic<bool> Ready;// the stack is written
+		const char* ThreadName;
+		uint64_t FrameNumber;
+		std::size_t Size;
+		uint32_t FrameCount;
+		void* Frames[AllocationTracker::MAX_STACK_FRAMES];
+	};
+
+	ThreadSlot Slots[AllocationTracker::MAX_THREADS];
+	ThreadSlot ExitedThreads;// what threads free in their last thread_local destructors, not reported
+	std::atomic<uint32_t> SlotCount{ 0 };
+	std::atomic<uint64_t> CurrentFrame{ 0 };
+
+	// main thread only
+	ThreadAllocationCounts FrameCounts[AllocationTracker::MAX_THREADS];
+	ThreadAllocationCounts PreviousTotals[AllocationTracker::MAX_THREADS];
+	uint32_t FrameThreadCount = 0;
+	uint64_t FrameAllocations = 0;
+
+	GuardHit GuardHits[AllocationTracker::MAX_GUARD_HITS];
+	std::atomic<uint32_t> GuardHitCount{ 0 };
+
+	// trivial thread_locals, nothing to construct when the first allocation of a thread comes in
+	// (ThreadSlotOwner is, after CurrentSlot is set)
+	thread_local ThreadSlot* CurrentSlot = nullptr;
+	thread_local bool GuardArmed = false;
+	thread_local bool InHook = false;// capturing a stack can allocate
+
+	// the benchmark starts new threads for every scene, a slot whose thread exited is reused first
+	ThreadSlot* _AcquireSlot()
+	{
+		for (;;)
+		{
+			uint32_t count = std::min(SlotCount.load(std::memory_order_relaxed), AllocationTracker::MAX_THREADS);
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				bool inUse = false;
+				if (Slots[i].InUse.compare_exchange_strong(inUse, true, std::memory_order_acquire))
+					return &Slots[i];
+			}
+			uint32_t index = SlotCount.fetch_add(1, std::memory_order_relaxed);
+			if (index >= AllocationTracker::MAX_THREADS)
+				return nullptr;
+			// a scan on another thread can see the new slot first, it's its slot then
+			bool inUse = false;
+			if (Slots[index].InUse.compare_exchange_strong(inUse, true, std::memory_order_acquire))
+				return &Slots[index];
+		}
+	}
+
+	// hands the slot back when the thread exits. Constructed once the thread has its slot, the
+	// allocations of the registration find CurrentSlot set
+	struct ThreadSlotOwner
+	{
+		ThreadSlot* Slot = nullptr;
+		~ThreadSlotOwner()
+		{
+			Slot->Name.store(nullptr, std::memory_order_relaxed);
+			Slot->InUse.store(false, std::memory_order_release);
+			CurrentSlot = &ExitedThreads;
+		}
+	};
+
+	ThreadSlot* _GetSlot()
+	{
+		if (!CurrentSlot)
+		{
+			ThreadSlot* slot = _AcquireSlot();
+			if (!slot)
+			{
+				// all taken, shared with the other overflowing threads and never handed back
+				CurrentSlot = &Slots[AllocationTracker::MAX_THREADS - 1];
+				return CurrentSlot;
+			}
+			CurrentSlot = slot;
+			static thread_local ThreadSlotOwner owner;
+			owner.Slot = slot;
+		}
+		return CurrentSlot;
+	}
+
+	uint32_t _CaptureStack(void** frames, uint32_t maxFrames)
+	{
+		// drop _CaptureStack, _OnAllocation and operator new
+		constexpr uint32_t SKIPPED_FRAMES = 3;
+#ifdef _WIN32
+		return RtlCaptureStackBackTrace(SKIPPED_FRAMES, maxFrames, frames, nullptr);
+#else
+		void* all[AllocationTracker::MAX_STACK_FRAMES + SKIPPED_FRAMES];
+		int count = backtrace(all, (int)(maxFrames + SKIPPED_FRAMES));
+		uint32_t kept = count > (int)SKIPPED_FRAMES ? (uint32_t)count - SKIPPED_FRAMES : 0;
+		memcpy(frames, all + SKIPPED_FRAMES, kept * sizeof(void*));
+		return kept;
+#endif
+	}
+
+	void _OnAllocation(std::size_t size)
+	{
+		ThreadSlot* slot = _GetSlot();
+		slot->Allocations.fetch_add(1, std::memory_order_relaxed);
+		slot->Bytes.fetch_add(size, std::memory_order_relaxed);
+
+		if (!GuardArmed || InHook)
+			return;
+		InHook = true;
+		uint32_t index = GuardHitCount.fetch_add(1, std::memory_order_relaxed);
+		if (index < AllocationTracker::MAX_GUARD_HITS)
+		{
+			GuardHit& hit = GuardHits[index];
+			hit.ThreadName = slot->Name.load(std::memory_order_relaxed);
+			hit.FrameNumber = CurrentFrame.load(std::memory_order_relaxed);
+			hit.Size = size;
+			hit.FrameCount = _CaptureStack(hit.Frames, AllocationTracker::MAX_STACK_FRAMES);
+			hit.Ready.store(true, std::memory_order_release);
+		}
+		InHook = false;
+	}
+
+	void _OnFree(void* ptr)
+	{
+		if (ptr)
+			_GetSlot()->Frees.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void _WriteStack(FILE* file, void* const* frames, uint32_t frameCount)
+	{
+#ifdef _WIN32
+		HANDLE process = GetCurrentProcess();
+		static bool symbolsLoaded = SymInitialize(process, nullptr, TRUE) != FALSE;
+		for (uint32_t i = 0; i < frameCount; ++i)
+		{
+			DWORD64 address = (DWORD64)frames[i];
+			char buffer[sizeof(SYMBOL_INFO) + 256] = {};
+			SYMBOL_INFO* symbol = reinterpret_cast<SYMBOL_INFO*>(buffer);
+			symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+			symbol->MaxNameLen = 255;
+			DWORD64 displacement = 0;
+			IMAGEHLP_LINE64 line = {};
+			line.SizeOfStruct = sizeof(line);
+			DWORD lineDisplacement = 0;
+
+			if (symbolsLoaded && SymFromAddr(process, address, &displacement, symbol))
+			{
+				if (SymGetLineFromAddr64(process, address, &lineDisplacement, &line))
+					fprintf(file, "\t\t%s %s:%lu\n", symbol->Name, line.FileName, line.LineNumber);
+				else
+					fprintf(file, "\t\t%s+0x%llx\n", symbol->Name, (unsigned long long)displacement);
+			}
+			else
+				fprintf(file, "\t\t0x%llx\n", (unsigned long long)address);
+		}
+#else
+		// names need -rdynamic, otherwise addr2line on the module offsets
+		fflush(file);
+		backtrace_symbols_fd(const_cast<void* const*>(frames), (int)frameCount, fileno(file));
+#endif
+	}
+}
+
+void AllocationTracker::SetThreadName(const char* name)
+{
+	_GetSlot()->Name.store(name, std::memory_order_relaxed);
+}
+
+void AllocationTracker::EndFrame(uint64_t frameNumber)
+{
+	FrameThreadCount = std::min(SlotCount.load(std::memory_order_relaxed), MAX_THREADS);
+	FrameAllocations = 0;
+	for (uint32_t i = 0; i < FrameThreadCount; ++i)
+	{
+		ThreadAllocationCounts totals;
+		totals.Name = Slots[i].Name.load(std::memory_order_relaxed);
+		totals.Allocations = Slots[i].Allocations.load(std::memory_order_relaxed);
+		totals.Frees = Slots[i].Frees.load(std::memory_order_relaxed);
+		totals.Bytes = Slots[i].Bytes.load(std::memory_order_relaxed);
+
+		ThreadAllocationCounts& frame = FrameCounts[i];
+		frame.Name = totals.Name;
+		frame.Allocations = totals.Allocations - PreviousTotals[i].Allocations;
+		frame.Frees = totals.Frees - PreviousTotals[i].Frees;
+		frame.Bytes = totals.Bytes - PreviousTotals[i].Bytes;
+		PreviousTotals[i] = totals;
+		FrameAllocations += frame.Allocations;
+	}
+	CurrentFrame.store(frameNumber + 1, std::memory_order_relaxed);
+}
+
+uint32_t AllocationTracker::GetFrameThreadCount()
+{
+	return FrameThreadCount;
+}
+
+const ThreadAllocationCounts* AllocationTracker::GetFrameCounts()
+{
+	return FrameCounts;
+}
+
+uint64_t AllocationTracker::GetFrameAllocations()
+{
+	return FrameAllocations;
+}
+
+bool AllocationTracker::SetGuardArmed(bool armed)
+{
+	bool previous = GuardArmed;
+	GuardArmed = armed;
+	return previous;
+}
+
+uint32_t AllocationTracker::GetGuardHits()
+{
+	return GuardHitCount.load(std::memory_order_relaxed);
+}
+
+void AllocationTracker::WriteGuardReport(FILE* file)
+{
+	bool armed = SetGuardArmed(false);
+	uint32_t hits = GetGuardHits();
+	uint32_t kept = std::min(hits, MAX_GUARD_HITS);
+	fprintf(file, "%u allocations while the allocation guard was armed\n", hits);
+
+	// the same call site allocating every frame is one entry
+	bool reported[MAX_GUARD_HITS] = {};
+	for (uint32_t i = 0; i < kept; ++i)
+	{
+		const GuardHit& hit = GuardHits[i];
+		if (reported[i] || !hit.Ready.load(std::memory_order_acquire))
+			continue;
+
+		uint32_t count = 0;
+		uint64_t bytes = 0;
+		for (uint32_t j = i; j < kept; ++j)
+		{
+			const GuardHit& other = GuardHits[j];
+			if (reported[j] || !other.Ready.load(std::memory_order_acquire) || other.FrameCount != hit.FrameCount
+				|| memcmp(other.Frames, hit.Frames, hit.FrameCount * sizeof(void*)) != 0)
+				continue;
+			reported[j] = true;
+			++count;
+			bytes += other.Size;
+		}
+		fprintf(file, "\t%u allocations, %llu bytes, first on thread %s in frame %llu:\n", count, (unsigned long long)bytes
+			, hit.ThreadName ? hit.ThreadName : "unnamed", (unsigned long long)hit.FrameNumber);
+		_WriteStack(file, hit.Frames, hit.FrameCount);
+	}
+	if (hits > kept)
+		fprintf(file, "\t%u more without call stack\n", hits - kept);
+	fflush(file);
+	SetGuardArmed(armed);
+}
+
+void AllocationTracker::ResetGuard()
+{
+	uint32_t kept = std::min(GetGuardHits(), MAX_GUARD_HITS);
+	for (uint32_t i = 0; i < kept; ++i)
+		GuardHits[i].Ready.store(false, std::memory_order_relaxed);
+	GuardHitCount.store(0, std::memory_order_relaxed);
+}
+
+#ifndef VENGINE_DISABLE_ALLOCATION_TRACKER
+// every replaceable form, so none of them slips past the counts. Sized deletes forward to the unsized ones
+namespace
+{
+	void* _Allocate(std::size_t size)
+	{
+		void* ptr = malloc(size > 0 ? size : 1);
+		if (!ptr)
+			throw std::bad_alloc();
+		_OnAllocation(size);
+		return ptr;
+	}
+
+	void* _AllocateAligned(std::size_t size, std::align_val_t alignment)
+	{
+		std::size_t align = std::max((std::size_t)alignment, sizeof(void*));
+#ifdef _WIN32
+		void* ptr = _aligned_malloc(size > 0 ? size : 1, align);
+#else
+		void* ptr = nullptr;
+		if (posix_memalign(&ptr, align, size > 0 ? size : 1) != 0)
+			ptr = nullptr;
+#endif
+		if (!ptr)
+			throw std::bad_alloc();
+		_OnAllocation(size);
+		return ptr;
+	}
+
+	void _FreeAligned(void* ptr)
+	{
+		_OnFree(ptr);
+#ifdef _WIN32
+		_aligned_free(ptr);
+#else
+		free(ptr);
+#endif
+	}
+}
+
+void* operator new(std::size_t size) { return _Allocate(size); }
+void* operator new[](std::size_t size) { return _Allocate(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	try { return _Allocate(size); }
+	catch (...) { return nullptr; }
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	try { return _Allocate(size); }
+	catch (...) { return nullptr; }
+}
+void* operator new(std::size_t size, std::align_val_t alignment) { return _AllocateAligned(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return _AllocateAligned(size, alignment); }
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	try { return _AllocateAligned(size, alignment); }
+	catch (...) { return nullptr; }
+}
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	try { return _AllocateAligned(size, alignment); }
+	catch (...) { return nullptr; }
+}
+
+void operator delete(void* ptr) noexcept { _OnFree(ptr); free(ptr); }
+void operator delete[](void* ptr) noexcept { _OnFree(ptr); free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { operator delete(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { operator delete[](ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { operator delete(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { operator delete[](ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { _FreeAligned(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { _FreeAligned(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { _FreeAligned(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { _FreeAligned(ptr); }
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { _FreeAligned(ptr); }
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { _FreeAligned(ptr); }
+#endif
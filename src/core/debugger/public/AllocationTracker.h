@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include "defines.h"
+
+// heap traffic of one thread, through the global operator new/delete
+struct ThreadAllocationCounts
+{
+	const char* Name;// null when the thread never called SetThreadName
+	uint64_t Allocations;
+	uint64_t Frees;
+	uint64_t Bytes;// requested by the allocations
+};
+
+// Counts every operator new/delete per thread, the engine turns that into per frame counts with
+// EndFrame. Threads that allocate while the guard is armed record their call stack, the steady
+// state frame loop is meant to allocate nothing (see EngineSettings::AllocationGuard).
+// malloc and the vulkan host allocations (VulkanLib::GetHostAllocationStats) aren't counted here.
+// Define VENGINE_DISABLE_ALLOCATION_TRACKER to keep the default operator new
+class AllocationTracker
+{
+public:
+	static constexpr uint32_t MAX_THREADS = 128;// alive at once, threads past it share the last slot
+	static constexpr uint32_t MAX_GUARD_HITS = 64;// call stacks kept, hits past it are only counted
+	static constexpr uint32_t MAX_STACK_FRAMES = 16;
+
+	// shows up in the frame counts and the guard report, call it at the start of the thread
+	static void SetThreadName(const char* name);
+
+	// Main thread, once per frame: what every thread allocated since the last call. Doesn't allocate
+	static void EndFrame(uint64_t frameNumber);
+	static uint32_t GetFrameThreadCount();
+	static const ThreadAllocationCounts* GetFrameCounts();
+	static uint64_t GetFrameAllocations();// all threads
+
+	// calling thread only, returns the previous state so scopes can nest
+	static bool SetGuardArmed(bool armed);
+	static uint32_t GetGuardHits();
+	// the distinct call stacks of the hits with how often they allocated, symbols need debug info
+	static void WriteGuardReport(FILE* file);
+	static void ResetGuard();
+};
+
+// arms the allocation guard of the calling thread for its lifetime
+class AllocationGuardScope
+{
+	bool Previous;
+public:
+	DISABLE_COPY(AllocationGuardScope)
+	explicit AllocationGuardScope(bool armed = true) : Previous{ AllocationTracker::SetGuardArmed(armed) } {}
+	~AllocationGuardScope() { AllocationTracker::SetGuardArmed(Previous); }
+};
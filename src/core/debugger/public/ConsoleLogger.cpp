@@ -1,7 +1,9 @@
 #include "Logger.h"
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 
-#include <string>
+#include <cstdio>
 #include "ConsoleLogger.h"
 
 
@@ -13,6 +15,8 @@ ConsoleLogger::ConsoleLogger()
 
 void ConsoleLogger::CreateAndAttachConsoleToWin32Program()
 {
+	// elsewhere stdout is already the terminal (or the ci log)
+#ifdef _WIN32
 	FILE* fpstdin = stdin;
 	FILE* fpstdout = stdout;
 	FILE* fpstderr = stderr;
@@ -22,32 +26,29 @@ void ConsoleLogger::CreateAndAttachConsoleToWin32Program()
 	freopen_s(&fpstdout, "CONOUT$", "w", stdout);
 	freopen_s(&fpstderr, "CONOUT$", "w", stderr);
 	SetConsoleTitle("appconsole");
+#endif
 }
 
 void ConsoleLogger::LogMsg(LOG_TYPE type, const char* message) 
 {
-
+#ifdef _WIN32
 		SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE),(WORD) type);
 		SetConsoleTextAttribute(GetStdHandle(STD_ERROR_HANDLE),(WORD) type);
+#endif
 	
-		std::string header{};
-		switch (type)
-		{
-		case LOG_TYPE::LOG: header = "[LOG]"; break;
-		case LOG_TYPE::TRACE: header = "[TRACE]"; break;
-		case LOG_TYPE::WARN:header = "[WARN]"; break;
-		case LOG_TYPE::VAL: header = "[VALIDATION LAYER]"; break;
-		case LOG_TYPE::ERR:header = "[ERROR]"; break;
-		}
 		printf("%s",message);
 	
+#ifdef _WIN32
 		SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), 15);
 		SetConsoleTextAttribute(GetStdHandle(STD_ERROR_HANDLE), 15);
+#endif
 }
 
 ConsoleLogger::~ConsoleLogger()
 {
+#ifdef _WIN32
 	SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), 15);
 	SetConsoleTextAttribute(GetStdHandle(STD_ERROR_HANDLE), 15);
+#endif
 }
 
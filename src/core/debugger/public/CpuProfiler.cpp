@@ -0,0 +1,189 @@
+#include "CpuProfiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+CpuProfiler::CpuProfiler()
+	: ThreadsMutex{}
+	, Threads{}
+	, FreeBuffers{}
+	, FrameZones{}
+	, CaptureZones{}
+	, CaptureFrames{}
+	, Capturing{ false }
+	, DroppedZones{ 0 }
+	, BaseTick{ Now() }
+	, BaseTime{ std::chrono::steady_clock::now() }
+	, NsPerTick{ 1.0 }
+{
+#ifndef VENGINE_PROFILER_TSC
+	NsPerTick = 1e9 * std::chrono::steady_clock::period::num / std::chrono::steady_clock::period::den;
+#endif
+}
+
+CpuProfiler::~CpuProfiler()
+{
+	// static destruction, the engine threads are joined by now
+	for (ThreadBuffer* buffer : Threads)
+		delete buffer;
+}
+
+CpuProfiler& CpuProfiler::GetInstance()
+{
+	static CpuProfiler profiler;
+	return profiler;
+}
+
+CpuProfiler::ThreadBufferOwner::~ThreadBufferOwner()
+{
+	// the buffer stays alive after its thread ends so the collector can drain it, then it's reused
+	if (Buffer)
+		Buffer->Exited.store(true, std::memory_order_release);
+}
+
+CpuProfiler::ThreadBuffer* CpuProfiler::_RegisterThread()
+{
+	// once per thread, a buffer a dead thread left is reused before a new one is allocated
+	CpuProfiler& profiler = GetInstance();
+	std::lock_guard<std::mutex> lock(profiler.ThreadsMutex);
+	ThreadBuffer* buffer;
+	if (!profiler.FreeBuffers.empty())
+	{
+		// fully drained, its read and write indices just carry on
+		buffer = profiler.FreeBuffers.back();
+		profiler.FreeBuffers.pop_back();
+	}
+	else
+	{
+		buffer = new ThreadBuffer;
+		buffer->ThreadIndex = (uint32_t)profiler.Threads.size();
+		profiler.Threads.push_back(buffer);
+	}
+	snprintf(buffer->Name, sizeof(buffer->Name), "thread %u", buffer->ThreadIndex);
+	return buffer;
+}
+
+void CpuProfiler::SetThreadName(const char* name)
+{
+	ThreadBuffer* buffer = GetThreadBuffer();
+	std::lock_guard<std::mutex> lock(GetInstance().ThreadsMutex);
+	snprintf(buffer->Name, sizeof(buffer->Name), "%s", name);
+}
+
+bool CpuProfiler::GetThreadName(uint32_t threadIndex, char* name, std::size_t size)
+{
+	std::lock_guard<std::mutex> lock(ThreadsMutex);
+	if (threadIndex >= Threads.size())
+		return false;
+	snprintf(name, size, "%s", Threads[threadIndex]->Name);
+	return true;
+}
+
+void CpuProfiler::_Calibrate()
+{
+#ifdef VENGINE_PROFILER_TSC
+	// the longer the interval the better the tsc rate, it keeps improving while the app runs
+	std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - BaseTime;
+	uint64_t ticks = Now() - BaseTick;
+	if (elapsed > std::chrono::milliseconds(100) && ticks > 0)
+		NsPerTick = std::chrono::duration<double, std::nano>(elapsed).count() / ticks;
+#endif
+}
+
+void CpuProfiler::EndFrame(uint64_t frameNumber)
+{
+	_Calibrate();
+	FrameZones.clear();
+
+	std::lock_guard<std::mutex> lock(ThreadsMutex);
+	for (ThreadBuffer* buffer : Threads)
+	{
+		// before the write index, everything the thread recorded is in once it exited
+		bool exited = buffer->Exited.load(std::memory_order_acquire);
+		uint64_t write = buffer->WriteIndex.load(std::memory_order_acquire);
+		uint64_t read = buffer->ReadIndex;
+		// the oldest slot is the one the thread writes next, it may be in the middle of it
+		if (write - read > ZONES_PER_THREAD - 1)
+		{
+			DroppedZones += write - read - (ZONES_PER_THREAD - 1);
+			read = write - (ZONES_PER_THREAD - 1);
+		}
+
+		std::size_t first = FrameZones.size();
+		for (uint64_t i = read; i < write; ++i)
+		{
+			const RawZone& zone = buffer->Zones[i & (ZONES_PER_THREAD - 1)];
+			FrameZones.push_back(CpuZone{ zone.Name, zone.Begin, zone.End, buffer->ThreadIndex });
+		}
+
+		// the thread kept recording while we copied, whatever it wrapped over is garbage and so is
+		// the slot of its WriteIndex, which it may be filling right now
+		uint64_t firstSafe = buffer->WriteIndex.load(std::memory_order_acquire) - (ZONES_PER_THREAD - 1);
+		if ((int64_t)firstSafe > (int64_t)read)
+		{
+			uint64_t lost = std::min(firstSafe, write) - read;
+			FrameZones.erase(FrameZones.begin() + first, FrameZones.begin() + first + (std::size_t)lost);
+			DroppedZones += lost;
+		}
+		buffer->ReadIndex = write;
+
+		if (exited)
+		{
+			buffer->Exited.store(false, std::memory_order_relaxed);
+			FreeBuffers.push_back(buffer);
+		}
+	}
+
+	if (Capturing)
+	{
+		std::size_t room = MAX_CAPTURED_ZONES - std::min(MAX_CAPTURED_ZONES, CaptureZones.size());
+		std::size_t count = std::min(room, FrameZones.size());
+		CaptureZones.insert(CaptureZones.end(), FrameZones.begin(), FrameZones.begin() + count);
+		CaptureFrames.emplace_back(frameNumber, Now());
+		if (count < FrameZones.size())
+			Capturing = false;// full, keep what we have
+	}
+}
+
+void CpuProfiler::BeginCapture()
+{
+	CaptureZones.clear();
+	CaptureFrames.clear();
+	Capturing = true;
+}
+
+bool CpuProfiler::WriteChromeTrace(const char* path)
+{
+	FILE* file = fopen(path, "w");
+	if (!file)
+		return false;
+
+	// trace event format, "X" complete events in microseconds since the profiler started
+	auto toUs = [this](uint64_t tick) { return (double)(int64_t)(tick - BaseTick) * NsPerTick / 1000.0; };
+
+	fprintf(file, "{\"traceEvents\":[\n");
+	bool first = true;
+	{
+		std::lock_guard<std::mutex> lock(ThreadsMutex);
+		for (const ThreadBuffer* buffer : Threads)
+		{
+			fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}"
+				, first ? "" : ",\n", buffer->ThreadIndex, buffer->Name);
+			first = false;
+		}
+	}
+	for (const CpuZone& zone : CaptureZones)
+	{
+		fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}"
+			, first ? "" : ",\n", zone.Name, zone.ThreadIndex, toUs(zone.Begin), toUs(zone.End) - toUs(zone.Begin));
+		first = false;
+	}
+	for (const std::pair<uint64_t, uint64_t>& frame : CaptureFrames)
+	{
+		fprintf(file, "%s{\"name\":\"frame %llu\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":%.3f}"
+			, first ? "" : ",\n", (unsigned long long)frame.first, toUs(frame.second));
+		first = false;
+	}
+	fprintf(file, "\n]}\n");
+	return fclose(file) == 0;
+}
@@ -0,0 +1,161 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "defines.h"
+#include "PerfCounters.h"
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define VENGINE_PROFILER_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define VENGINE_PROFILER_TSC
+#endif
+
+// A zone as collected at the end of a frame, Begin/End in CpuProfiler ticks
+struct CpuZone
+{
+	const char* Name;
+	uint64_t Begin;
+	uint64_t End;
+	uint32_t ThreadIndex;
+};
+
+// Scoped cpu zones for release builds. A zone is two timestamp reads and one store into a ring
+// owned by the recording thread: no locks, no allocations (the ring is allocated the first time
+// a thread records). Once per frame the main thread collects every ring, see EndFrame.
+// Zone names must outlive the profiler, string literals
+class CpuProfiler
+{
+public:
+	static constexpr uint32_t ZONES_PER_THREAD = 1 << 14;// power of two, per frame and thread
+
+	struct RawZone
+	{
+		const char* Name;
+		uint64_t Begin;
+		uint64_t End;
+	};
+
+	// written by its thread only, WriteIndex tells the collector how far it got
+	struct ThreadBuffer
+	{
+		RawZone Zones[ZONES_PER_THREAD];
+		alignas(64) std::atomic<uint64_t> WriteIndex{ 0 };
+		alignas(64) uint64_t ReadIndex = 0;// collector side
+		uint32_t ThreadIndex = 0;
+		char Name[32] = {};
+		std::atomic<bool> Exited{ false };// set after the last zone of the thread, see EndFrame
+	};
+
+	// hands the buffer back when its thread exits, the benchmark starts new threads for every scene
+	struct ThreadBufferOwner
+	{
+		ThreadBuffer* Buffer = nullptr;
+		~ThreadBufferOwner();
+	};
+
+private:
+	static constexpr std::size_t MAX_CAPTURED_ZONES = 1 << 22;
+
+	std::mutex ThreadsMutex;// registration and collection, never taken while recording
+	std::vector<ThreadBuffer*> Threads;// by ThreadIndex
+	std::vector<ThreadBuffer*> FreeBuffers;// drained after their thread exited, reused with their ThreadIndex
+	std::vector<CpuZone> FrameZones;// zones collected by the last EndFrame
+	std::vector<CpuZone> CaptureZones;
+	std::vector<std::pair<uint64_t, uint64_t>> CaptureFrames;// frame number, tick when it ended
+	bool Capturing;
+	uint64_t DroppedZones;
+	// ticks to nanoseconds, calibrated against steady_clock
+	uint64_t BaseTick;
+	std::chrono::steady_clock::time_point BaseTime;
+	double NsPerTick;
+
+	CpuProfiler();
+	static ThreadBuffer* _RegisterThread();
+	void _Calibrate();
+
+public:
+	DISABLE_COPY(CpuProfiler)
+	~CpuProfiler();
+	static CpuProfiler& GetInstance();
+
+	static uint64_t Now()
+	{
+#ifdef VENGINE_PROFILER_TSC
+		return __rdtsc();
+#else
+		return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+	}
+
+	static ThreadBuffer* GetThreadBuffer()
+	{
+		static thread_local ThreadBufferOwner owner;
+		if (!owner.Buffer)
+			owner.Buffer = _RegisterThread();
+		return owner.Buffer;
+	}
+
+	static void Record(const char* name, uint64_t begin, uint64_t end)
+	{
+		ThreadBuffer* buffer = GetThreadBuffer();
+		uint64_t index = buffer->WriteIndex.load(std::memory_order_relaxed);
+		buffer->Zones[index & (ZONES_PER_THREAD - 1)] = RawZone{ name, begin, end };
+		buffer->WriteIndex.store(index + 1, std::memory_order_release);
+	}
+
+	// shows up in the trace, call it at the start of the thread
+	static void SetThreadName(const char* name);
+	// copies the name of the thread a CpuZone::ThreadIndex refers to, false for an unknown index.
+	// Indices of threads that exited are given to new threads, the name is the newest one's
+	bool GetThreadName(uint32_t threadIndex, char* name, std::size_t size);
+
+	// Main thread, once per frame: moves what every thread recorded since the last call into the
+	// frame zones (and the capture if one is running). Zones a thread recorded past the size of
+	// its ring since the last call are lost and counted in GetDroppedZones
+	void EndFrame(uint64_t frameNumber);
+	const std::vector<CpuZone>& GetFrameZones() const { return FrameZones; }
+	uint64_t GetDroppedZones() const { return DroppedZones; }
+	double TicksToMs(uint64_t ticks) const { return ticks * NsPerTick / 1000000.0; }
+
+	// collects frames until EndCapture, then WriteChromeTrace (chrome://tracing, Perfetto)
+	void BeginCapture();
+	void EndCapture() { Capturing = false; }
+	bool WriteChromeTrace(const char* path);
+};
+
+// the hardware counters are only read when PerfCounters::Enable was called
+class ProfileScope
+{
+	const char* Name;
+	uint64_t Begin;
+	PerfCounterValues CountersBegin;
+	bool Counted;
+public:
+	DISABLE_COPY(ProfileScope)
+	explicit ProfileScope(const char* name)
+		: Name{ name }
+		, Begin{ CpuProfiler::Now() }
+		, CountersBegin{}
+		, Counted{ PerfCounters::IsEnabled() && PerfCounters::Read(CountersBegin) }
+	{
+	}
+	~ProfileScope()
+	{
+		PerfCounterValues countersEnd;
+		if (Counted && PerfCounters::Read(countersEnd))
+			PerfCounters::Accumulate(Name, CountersBegin, countersEnd);
+		CpuProfiler::Record(Name, Begin, CpuProfiler::Now());
+	}
+};
+
+#ifdef VENGINE_DISABLE_PROFILER
+#define PROFILE_SCOPE(name)
+#else
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#endif
@@ -1,27 +1,31 @@
 #pragma once
 
 #ifdef NDEBUG
+#include <stdexcept>
+
 #define LOG_MSG(message,...) ;
 #define LOG_TRACE(message, ...) ;
 #define LOG_WARN(message,...) ;
-#define LOG_ERR(message,...) ;
+// no logger, but errors still stop: a headless run must fail instead of going on with a broken device
+#define LOG_ERR(message,...) {throw std::runtime_error(message);}
 #define VAL_LAYER(message,...) ;
-#define ASSERT_EQU(object, value, message, ...) ;
-#define ASSERT_NOT_NULL(object, value, message, ...) ;
-#define VK_CHECK(func,message,...) func
+#define ASSERT_EQU(object, value, message, ...) do { if ( object != value){LOG_ERR(message,##__VA_ARGS__}}while(0)
+#define ASSERT_NOT_NULL(object, message,...) do { if (!object){LOG_ERR(message,##__VA_ARGS__)}}while(0)
+#define VK_CHECK(func,...) do{ if((func) != 0) LOG_ERR("Failed to " #func "\n") }while(0)
 
 #else
-#include <exception>
+#include <stdexcept>
 #include "core/debugger/private/LogEngine.h"
 
 // Use this because in no debug mode will not exist any logger
 #define LOG_MSG(message,...){ LogEngine::GetLogEngineInstance()->LogMsg(LOG_TYPE::LOG,message,##__VA_ARGS__);}
-#define LOG_TRACE(message, ...){LogEngine::GetLogEngineInstance()->LogMsg(LOG_TYPE::TRACE,message,__VA_ARGS__);}
-#define LOG_WARN(message,...){ LogEngine::GetLogEngineInstance()->LogMsg(LOG_TYPE::WARN,message,__VA_ARGS__);}
-#define LOG_ERR(message,...) {LogEngine::GetLogEngineInstance()->LogMsg(LOG_TYPE::ERR,message,__VA_ARGS__); throw std::exception(message);}
-#define VAL_LAYER(message,...){ LogEngine::GetLogEngineInstance()->LogMsg(LOG_TYPE::VAL,message ,__VA_ARGS__);}
-#define ASSERT_EQU(object, value, message, ...) do { if ( object != value){LOG_ERR(message,__VA_ARGS__}}while(0)
-#define ASSERT_NOT_NULL(object, message,...) do { if (!object){LOG_ERR(message,__VA_ARGS__)}}while(0)
-#define VK_CHECK(func,message,...) do{ if((func) != 0) LOG_ERR("Failed to "#func ##"\n", __VA_ARGS__) }while(0)
+// ##__VA_ARGS__ drops the comma when there are no arguments, gcc/clang need it for headless linux builds
+#define LOG_TRACE(message, ...){LogEngine::GetLogEngineInstance()->LogMsg(LOG_TYPE::TRACE,message,##__VA_ARGS__);}
+#define LOG_WARN(message,...){ LogEngine::GetLogEngineInstance()->LogMsg(LOG_TYPE::WARN,message,##__VA_ARGS__);}
+#define LOG_ERR(message,...) {LogEngine::GetLogEngineInstance()->LogMsg(LOG_TYPE::ERR,message,##__VA_ARGS__); throw std::runtime_error(message);}
+#define VAL_LAYER(message,...){ LogEngine::GetLogEngineInstance()->LogMsg(LOG_TYPE::VAL,message ,##__VA_ARGS__);}
+#define ASSERT_EQU(object, value, message, ...) do { if ( object != value){LOG_ERR(message,##__VA_ARGS__}}while(0)
+#define ASSERT_NOT_NULL(object, message,...) do { if (!object){LOG_ERR(message,##__VA_ARGS__)}}while(0)
+#define VK_CHECK(func,...) do{ if((func) != 0) LOG_ERR("Failed to " #func "\n") }while(0)
 
 #endif
\ No newline at end of file
@@ -0,0 +1,226 @@
+#include "PerfCounters.h"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+std::atomic<bool> PerfCounters::Enabled{ false };
+
+namespace
+{
+	struct ZoneTotals
+	{
+		const char* Name;
+		uint64_t Samples;
+		PerfCounterValues Totals;
+	};
+
+	// one per thread that recorded a zone since Enable, never freed: the collector can read them after the thread ended
+	struct ThreadCounters
+	{
+		static constexpr uint32_t COUNTER_COUNT = 4;
+		int Fds[COUNTER_COUNT] = { -1, -1, -1, -1 };// cycles leads the group
+		uint64_t Ids[COUNTER_COUNT] = {};
+		bool Opened = false;
+		std::mutex Lock;// owner thread on Accumulate, the collector on GetZoneStats/Reset
+		std::vector<ZoneTotals> Zones;// a handful of zones, linear search
+	};
+
+	std::mutex ThreadsLock;
+	std::vector<ThreadCounters*> Threads;
+
+#ifdef __linux__
+	int _OpenCounter(uint32_t type, uint64_t config, int groupFd)
+	{
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = type;
+		attr.config = config;
+		attr.disabled = groupFd == -1 ? 1 : 0;// the leader starts the whole group
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		// the times tell how long the group was really counting when the kernel had to multiplex it
+		attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		// this thread, any cpu
+		return (int)syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+	}
+
+	bool _OpenGroup(ThreadCounters& counters)
+	{
+		const uint32_t types[ThreadCounters::COUNTER_COUNT] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE };
+		const uint64_t configs[ThreadCounters::COUNTER_COUNT] =
+		{
+			PERF_COUNT_HW_CPU_CYCLES,
+			PERF_COUNT_HW_INSTRUCTIONS,
+			PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+			PERF_COUNT_HW_BRANCH_MISSES
+		};
+
+		for (uint32_t i = 0; i < ThreadCounters::COUNTER_COUNT; ++i)
+		{
+			// a counter the cpu doesn't have reads as 0, the leader must be there
+			counters.Fds[i] = _OpenCounter(types[i], configs[i], i == 0 ? -1 : counters.Fds[0]);
+			if (counters.Fds[i] == -1)
+			{
+				if (i == 0)
+					return false;
+				continue;
+			}
+			ioctl(counters.Fds[i], PERF_EVENT_IOC_ID, &counters.Ids[i]);
+		}
+		ioctl(counters.Fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(counters.Fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+		return true;
+	}
+#endif
+
+	// closes the counters when the thread ends, the totals stay for the collector
+	struct ThreadCountersOwner
+	{
+		ThreadCounters* Counters = nullptr;
+		~ThreadCountersOwner()
+		{
+#ifdef __linux__
+			if (Counters)
+			{
+				for (int fd : Counters->Fds)
+				{
+					if (fd != -1)
+						close(fd);
+				}
+			}
+#endif
+		}
+	};
+
+	ThreadCounters* _GetThreadCounters()
+	{
+		static thread_local ThreadCountersOwner owner;
+		if (!owner.Counters)
+		{
+			owner.Counters = new ThreadCounters;
+#ifdef __linux__
+			owner.Counters->Opened = _OpenGroup(*owner.Counters);
+#endif
+			std::lock_guard<std::mutex> lock(ThreadsLock);
+			Threads.push_back(owner.Counters);
+		}
+		return owner.Counters;
+	}
+}
+
+bool PerfCounters::Enable()
+{
+#ifdef __linux__
+	// try on this thread, the others fail the same way
+	if (!_GetThreadCounters()->Opened)
+		return false;
+	Enabled.store(true, std::memory_order_relaxed);
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool PerfCounters::Read(PerfCounterValues& values)
+{
+#ifdef __linux__
+	ThreadCounters* counters = _GetThreadCounters();
+	if (!counters->Opened)
+		return false;
+
+	// see _OpenCounter: count, time enabled, time running, then value and id of each counter
+	uint64_t buffer[3 + 2 * ThreadCounters::COUNTER_COUNT];
+	if (read(counters->Fds[0], buffer, sizeof(buffer)) <= 0)
+		return false;
+	// never scheduled yet, there is nothing to scale
+	uint64_t enabled = buffer[1];
+	uint64_t running = buffer[2];
+	if (running == 0)
+		return false;
+	// the group only counted running of the enabled time, extrapolate like perf stat does
+	double scale = (double)enabled / running;
+
+	uint64_t* targets[ThreadCounters::COUNTER_COUNT] = { &values.Cycles, &values.Instructions, &values.LlcMisses, &values.BranchMisses };
+	uint64_t count = std::min<uint64_t>(buffer[0], ThreadCounters::COUNTER_COUNT);
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		for (uint32_t j = 0; j < ThreadCounters::COUNTER_COUNT; ++j)
+		{
+			if (counters->Fds[j] != -1 && counters->Ids[j] == buffer[4 + i * 2])
+				*targets[j] = running == enabled ? buffer[3 + i * 2] : (uint64_t)(buffer[3 + i * 2] * scale);
+		}
+	}
+	return true;
+#else
+	(void)values;
+	return false;
+#endif
+}
+
+void PerfCounters::Accumulate(const char* name, const PerfCounterValues& begin, const PerfCounterValues& end)
+{
+	ThreadCounters* counters = _GetThreadCounters();
+	std::lock_guard<std::mutex> lock(counters->Lock);
+	// the same literal can have another address in another translation unit
+	auto zone = std::find_if(counters->Zones.begin(), counters->Zones.end(), [name](const ZoneTotals& totals) { return totals.Name == name || strcmp(totals.Name, name) == 0; });
+	if (zone == counters->Zones.end())
+		zone = counters->Zones.insert(counters->Zones.end(), ZoneTotals{ name, 0, {} });
+
+	// multiplexed reads are estimates, the end one can come out below the begin one
+	auto delta = [](uint64_t from, uint64_t to) { return to > from ? to - from : 0; };
+	++zone->Samples;
+	zone->Totals.Cycles += delta(begin.Cycles, end.Cycles);
+	zone->Totals.Instructions += delta(begin.Instructions, end.Instructions);
+	zone->Totals.LlcMisses += delta(begin.LlcMisses, end.LlcMisses);
+	zone->Totals.BranchMisses += delta(begin.BranchMisses, end.BranchMisses);
+}
+
+std::vector<ZoneCounterStats> PerfCounters::GetZoneStats()
+{
+	std::vector<ZoneCounterStats> stats;
+	std::lock_guard<std::mutex> threadsLock(ThreadsLock);
+	for (ThreadCounters* counters : Threads)
+	{
+		std::lock_guard<std::mutex> lock(counters->Lock);
+		for (const ZoneTotals& zone : counters->Zones)
+		{
+			auto merged = std::find_if(stats.begin(), stats.end(), [&zone](const ZoneCounterStats& s) { return s.Name == zone.Name || strcmp(s.Name, zone.Name) == 0; });
+			if (merged == stats.end())
+				merged = stats.insert(stats.end(), ZoneCounterStats{ zone.Name, 0, {}, 0.0, 0.0, 0.0 });
+			merged->Samples += zone.Samples;
+			merged->Totals.Cycles += zone.Totals.Cycles;
+			merged->Totals.Instructions += zone.Totals.Instructions;
+			merged->Totals.LlcMisses += zone.Totals.LlcMisses;
+			merged->Totals.BranchMisses += zone.Totals.BranchMisses;
+		}
+	}
+
+	for (ZoneCounterStats& zone : stats)
+	{
+		if (zone.Totals.Cycles > 0)
+			zone.Ipc = (double)zone.Totals.Instructions / zone.Totals.Cycles;
+		if (zone.Totals.Instructions > 0)
+		{
+			zone.LlcMissesPerKiloInstruction = 1000.0 * zone.Totals.LlcMisses / zone.Totals.Instructions;
+			zone.BranchMissesPerKiloInstruction = 1000.0 * zone.Totals.BranchMisses / zone.Totals.Instructions;
+		}
+	}
+	return stats;
+}
+
+void PerfCounters::Reset()
+{
+	std::lock_guard<std::mutex> threadsLock(ThreadsLock);
+	for (ThreadCounters* counters : Threads)
+	{
+		std::lock_guard<std::mutex> lock(counters->Lock);
+		counters->Zones.clear();
+	}
+}
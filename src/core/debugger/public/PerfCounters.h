@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// hardware counters of the calling thread, user space only
+struct PerfCounterValues
+{
+	uint64_t Cycles = 0;
+	uint64_t Instructions = 0;
+	uint64_t LlcMisses = 0;// last level cache read misses
+	uint64_t BranchMisses = 0;
+};
+
+// totals of every zone with the same name, over all threads since the last Reset
+struct ZoneCounterStats
+{
+	const char* Name;
+	uint64_t Samples;
+	PerfCounterValues Totals;
+	double Ipc;
+	double LlcMissesPerKiloInstruction;
+	double BranchMissesPerKiloInstruction;
+};
+
+// Optional perf_event_open counters on the PROFILE_SCOPE zones, Linux only. Off by default: every
+// counted zone costs two read() syscalls (around a microsecond each), that goes into the wall time
+// of the zone and of its parents but not into its own counts past the first read.
+// Each thread opens its counter group the first time it records a zone after Enable. Needs
+// perf_event_paranoid <= 2 (or CAP_PERFMON), hardware counters are often missing in VMs
+class PerfCounters
+{
+	static std::atomic<bool> Enabled;
+
+public:
+	// false when the counters can't be opened on this machine, they stay off then
+	static bool Enable();
+	static void Disable() { Enabled.store(false, std::memory_order_relaxed); }
+	static bool IsEnabled() { return Enabled.load(std::memory_order_relaxed); }
+
+	// false when this thread has no counters. Scaled up when the kernel multiplexed the group
+	static bool Read(PerfCounterValues& values);
+	// adds end - begin to the totals of the zone, on the calling thread's table
+	static void Accumulate(const char* name, const PerfCounterValues& begin, const PerfCounterValues& end);
+	// merged over all threads, zones with the same name are one zone
+	static std::vector<ZoneCounterStats> GetZoneStats();
+	static void Reset();
+};
@@ -0,0 +1,70 @@
+#ifndef ENGINE_SETTINGS_HPP
+#define ENGINE_SETTINGS_HPP
+
+#include "core/api/VulkanSwapChain.h"
+
+// Input to photon latency over throughput, e.g: interactive kiosks. Works best with 1-2 frames in flight
+struct LowLatencySettings
+{
+	// wait for the frame fence before sampling input, then hold the frame back until the gpu is
+	// about to run out of work. Frames are rendered from the main thread, not the present thread
+	bool Enabled = false;
+	uint32_t StartMarginUs = 1000;// slack before the predicted gpu idle time, at least the sleep granularity
+	// the acquire gives up after this and the frame is retried after pumping events again
+	uint32_t AcquireTimeoutUs = 8000;
+};
+
+// No window or surface, frames are rendered into a ring of offscreen images instead of a swap chain
+// e.g: render farm nodes without a display, throughput runs on cpu-only CI (lavapipe, SwiftShader)
+struct HeadlessSettings
+{
+	bool Enabled = false;// only read at startup
+	uint32_t Width = 1280;
+	uint32_t Height = 720;
+	uint64_t FrameCount = 0;// Run returns after this many frames, 0 runs until RequestStop
+};
+
+// Test mode for the steady state frame loop: once warmed up, a frame that allocates with operator new
+// (Draw, and the recording on the present thread) stops Run, which then throws with the call
+// sites written to stderr. Only read at startup
+struct AllocationGuardSettings
+{
+	bool Enabled = false;
+	uint64_t WarmupFrames = 60;// first frames fill caches and pools, they may allocate
+};
+
+// Watchdog on the frame time: a frame longer than MedianMultiple times the median of the last
+// frames is a hitch, and the frames around it (cpu zones, gpu times, allocations, queue waits)
+// are written as a chrome trace to <DumpPath>_<frame>.json. Only read at startup
+struct HitchSettings
+{
+	bool Enabled = false;
+	double MedianMultiple = 3.0;
+	double MinimumMs = 8.0;// shorter frames are never hitches, keeps vsync jitter at high refresh rates out
+	uint32_t CapturedFrames = 16;// frames up to and including the hitch in the dump, a few after it are added
+	uint32_t MaxDumps = 8;// per run, a machine that hitches all the time would fill the disk
+	const char* DumpPath = "hitch";// a relative path is from the working directory
+};
+
+// Settings that can change per deployment or at runtime through VEngine::ApplySettings
+// e.g: kiosks 2 images / 1 frame in flight for latency, heavy scenes 3 images / 2 frames
+struct EngineSettings
+{
+	SwapChainSettings SwapChain;
+	// acquire, submit and present run on their own thread, only read at startup
+	bool PresentThread = false;
+	uint32_t PresentQueueDepth = 1;// frames the main thread can be ahead of the present thread
+	// fixed rate of the simulation thread, frames interpolate between steps. Read when Run starts
+	uint32_t SimulationStepsPerSecond = 60;
+	LowLatencySettings LowLatency;
+	// vertex/fragment/primitive counts of the frame next to its gpu time, only read at startup
+	bool GpuPipelineStatistics = false;
+	HeadlessSettings Headless;
+	// read at startup and written back at shutdown so pipelines compiled once load from it. Null by
+	// default, benchmark scenes and CI runs shouldn't leave a file in the working directory
+	const char* PipelineCachePath = nullptr;
+	AllocationGuardSettings AllocationGuard;
+	HitchSettings Hitch;
+};
+
+#endif //ENGINE_SETTINGS_HPP
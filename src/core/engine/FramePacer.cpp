@@ -0,0 +1,72 @@
+#include "FramePacer.h"
+#include <algorithm>
+
+FramePacer::FramePacer()
+	: History{}
+	, InputTime{}
+	, LastCompletionTime{}
+	, LastSubmittedValue{ 0 }
+	, LastCompletedValue{ 0 }
+	, StartMargin{ std::chrono::milliseconds(1) }
+	, Stats{}
+{
+}
+
+void FramePacer::_Accumulate(double& average, double sampleMs)
+{
+	average = average == 0.0 ? sampleMs : average + (sampleMs - average) * SMOOTHING;
+}
+
+void FramePacer::OnFrameCompleted(uint64_t frameValue, Clock::time_point completionTime, bool waited)
+{
+	if (!waited)
+	{
+		LastCompletedValue = std::max(LastCompletedValue, frameValue);
+		return;
+	}
+
+	const FrameTimes& frame = History[frameValue % HISTORY_SIZE];
+	if (frame.FrameValue == frameValue)
+	{
+		// the gpu starts a frame when it is submitted or when the one before it finishes,
+		// whatever comes last. Only the frame before is known here, older ones are a guess
+		Clock::time_point gpuStart = frame.SubmitTime;
+		if (LastCompletedValue + 1 == frameValue)
+			gpuStart = std::max(gpuStart, LastCompletionTime);
+
+		_Accumulate(Stats.GpuFrameMs, std::chrono::duration<double, std::milli>(completionTime - gpuStart).count());
+		_Accumulate(Stats.InputToGpuDoneMs, std::chrono::duration<double, std::milli>(completionTime - frame.InputTime).count());
+	}
+	LastCompletedValue = frameValue;
+	LastCompletionTime = completionTime;
+}
+
+FramePacer::Clock::duration FramePacer::GetStartDelay(Clock::time_point now) const
+{
+	// nothing queued on the gpu, every moment we wait is idle time
+	if (LastCompletedValue >= LastSubmittedValue)
+		return Clock::duration::zero();
+
+	const FrameTimes& lastFrame = History[LastSubmittedValue % HISTORY_SIZE];
+	Clock::time_point gpuStart = std::max(lastFrame.SubmitTime, LastCompletionTime);
+	Clock::time_point gpuIdle = gpuStart + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(Stats.GpuFrameMs));
+	Clock::time_point start = gpuIdle - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(Stats.CpuFrameMs)) - StartMargin;
+
+	return start > now ? start - now : Clock::duration::zero();
+}
+
+void FramePacer::OnStartDelayed(Clock::duration delay)
+{
+	_Accumulate(Stats.StartDelayMs, std::chrono::duration<double, std::milli>(delay).count());
+}
+
+void FramePacer::OnFrameSubmitted(uint64_t frameValue, Clock::time_point submitTime)
+{
+	FrameTimes& frame = History[frameValue % HISTORY_SIZE];
+	frame.FrameValue = frameValue;
+	frame.InputTime = InputTime;
+	frame.SubmitTime = submitTime;
+	LastSubmittedValue = frameValue;
+
+	_Accumulate(Stats.CpuFrameMs, std::chrono::duration<double, std::milli>(submitTime - InputTime).count());
+}
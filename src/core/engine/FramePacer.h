@@ -0,0 +1,59 @@
+#ifndef FRAME_PACER_HPP
+#define FRAME_PACER_HPP
+
+#include <chrono>
+#include <cstdint>
+
+// Moving averages of the low latency mode, all in milliseconds
+struct LatencyStats
+{
+	double CpuFrameMs = 0.0;// input sampled to frame submitted
+	double GpuFrameMs = 0.0;// gpu time of a frame, measured from the frame fence
+	double InputToGpuDoneMs = 0.0;// input sampled to the gpu finishing the frame, scan out comes on top
+	double StartDelayMs = 0.0;// how long frame starts are held back
+	uint64_t AcquireTimeouts = 0;// frames that gave up on the acquire and were retried
+};
+
+// Decides when the cpu should start a frame so its submit lands right when the gpu runs out of
+// work. Starting earlier only makes the frame wait in the queue with older input in it
+class FramePacer
+{
+	using Clock = std::chrono::steady_clock;
+	static constexpr uint32_t HISTORY_SIZE = 8;// more than any frames in flight setting
+	static constexpr double SMOOTHING = 0.1;
+
+	struct FrameTimes
+	{
+		uint64_t FrameValue;
+		Clock::time_point InputTime;
+		Clock::time_point SubmitTime;
+	};
+
+	FrameTimes History[HISTORY_SIZE];
+	Clock::time_point InputTime;// of the frame being built
+	Clock::time_point LastCompletionTime;
+	uint64_t LastSubmittedValue;
+	uint64_t LastCompletedValue;
+	Clock::duration StartMargin;
+	LatencyStats Stats;
+
+	static void _Accumulate(double& average, double sampleMs);
+
+public:
+	FramePacer();
+
+	// margin kept between the predicted gpu idle time and the submit, covers misprediction and sleep granularity
+	void SetStartMargin(Clock::duration margin) { StartMargin = margin; }
+	// called after waiting on the frame fence. Only when the wait blocked (waited) completionTime
+	// is when the gpu finished, otherwise it finished some time before and nothing is measured
+	void OnFrameCompleted(uint64_t frameValue, Clock::time_point completionTime, bool waited);
+	// how long the next frame should hold back before sampling input
+	Clock::duration GetStartDelay(Clock::time_point now) const;
+	void OnStartDelayed(Clock::duration delay);
+	void OnInputSampled(Clock::time_point inputTime) { InputTime = inputTime; }
+	void OnFrameSubmitted(uint64_t frameValue, Clock::time_point submitTime);
+	void OnAcquireTimeout() { ++Stats.AcquireTimeouts; }
+	const LatencyStats& GetStats() const { return Stats; }
+};
+
+#endif //FRAME_PACER_HPP
@@ -0,0 +1,53 @@
+#ifndef FRAME_PACKET_HPP
+#define FRAME_PACKET_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+struct ObjectState
+{
+	glm::vec3 Position = glm::vec3(0.0f);
+	glm::quat Rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	glm::vec3 Scale = glm::vec3(1.0f);
+	float Radius = 1.0f;// bounding sphere in object space, used to build the visible list
+	bool Visible = true;
+	uint32_t Mesh = 0;// see VEngine::AddMesh
+	uint32_t Pipeline = 0;// see VEngine::AddPipelineVariant
+};
+
+struct CameraState
+{
+	glm::vec3 Position = glm::vec3(0.0f, 0.0f, 2.0f);
+	glm::vec3 Target = glm::vec3(0.0f);
+	glm::vec3 Up = glm::vec3(0.0f, 1.0f, 0.0f);
+	float FovY = glm::radians(60.0f);
+	float Near = 0.1f;
+	float Far = 100.0f;
+};
+
+// What the simulation thread owns and steps
+struct SimulationState
+{
+	std::vector<ObjectState> Objects;
+	CameraState Camera;
+};
+
+// Everything the renderer needs from one simulation step. Once published it is never touched
+// by the simulation thread again, so the render thread reads it without locks.
+// It carries the states before and after the step so the renderer can interpolate between them
+struct FramePacket
+{
+	uint64_t Step = 0;
+	std::chrono::steady_clock::time_point StepTime;// when the Current state is due
+	double StepSeconds = 0.0;
+	std::vector<ObjectState> Previous;
+	std::vector<ObjectState> Current;
+	std::vector<uint32_t> Visible;// indices into Previous/Current
+	CameraState PreviousCamera;
+	CameraState Camera;
+};
+
+#endif //FRAME_PACKET_HPP
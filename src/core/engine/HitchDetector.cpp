@@ -0,0 +1,254 @@
+#include "HitchDetector.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "core/debugger/public/AllocationTracker.h"
+#include "core/debugger/public/Logger.h"
+
+namespace
+{
+	constexpr uint32_t FRAMES_TRACK = 1000;// tid of the frame events, past any profiler thread index
+
+	uint64_t _TotalHostAllocations(const HostAllocationStats& stats)
+	{
+		uint64_t total = 0;
+		for (const HostAllocationScopeStats& scope : stats.Scopes)
+			total += scope.TotalAllocations;
+		return total;
+	}
+
+	uint64_t _LiveHostBytes(const HostAllocationStats& stats)
+	{
+		uint64_t total = 0;
+		for (const HostAllocationScopeStats& scope : stats.Scopes)
+			total += scope.LiveBytes;
+		return total;
+	}
+}
+
+HitchDetector::HitchDetector(const HitchSettings& settings)
+	: Settings{ settings }
+	, Frames{}
+	, GpuFrames{}
+	, GpuMutex{}
+	, FrameTimes{}
+	, FrameTimeCount{ 0 }
+	, LastHostAllocations{ 0 }
+	, PendingHitch{ 0 }
+	, HitchCount{ 0 }
+	, DumpCount{ 0 }
+	, Writer{}
+{
+	uint32_t capacity = std::max(Settings.CapturedFrames, 1u) + FRAMES_AFTER_HITCH;
+	Frames.resize(capacity);
+	GpuFrames.resize(capacity);
+	for (FrameRecord& frame : Frames)
+		frame.Zones.reserve(ZONES_RESERVED);
+}
+
+HitchDetector::~HitchDetector()
+{
+	if (Writer.valid())
+		Writer.wait();
+}
+
+double HitchDetector::_Median() const
+{
+	uint32_t count = (uint32_t)std::min<uint64_t>(FrameTimeCount, MEDIAN_WINDOW);
+	if (count == 0)
+		return 0.0;
+	double sorted[MEDIAN_WINDOW];
+	std::copy(FrameTimes, FrameTimes + count, sorted);
+	std::nth_element(sorted, sorted + count / 2, sorted + count);
+	return sorted[count / 2];
+}
+
+void HitchDetector::OnFrameEnd(uint64_t frameNumber, double frameMs, const HostAllocationStats& hostStats)
+{
+	double median = _Median();
+	bool hitch = FrameTimeCount >= MIN_MEDIAN_SAMPLES && frameMs >= Settings.MinimumMs && frameMs > median * Settings.MedianMultiple;
+	FrameTimes[FrameTimeCount % MEDIAN_WINDOW] = frameMs;
+	++FrameTimeCount;
+
+	FrameRecord& frame = Frames[frameNumber % Frames.size()];
+	frame.FrameNumber = frameNumber;
+	frame.EndTick = CpuProfiler::Now();
+	frame.FrameMs = frameMs;
+	frame.MedianMs = median;
+	const std::vector<CpuZone>& zones = CpuProfiler::GetInstance().GetFrameZones();
+	frame.Zones.assign(zones.begin(), zones.end());
+
+	frame.Allocations = 0;
+	frame.AllocatedBytes = 0;
+	const ThreadAllocationCounts* counts = AllocationTracker::GetFrameCounts();
+	for (uint32_t i = 0; i < AllocationTracker::GetFrameThreadCount(); ++i)
+	{
+		frame.Allocations += counts[i].Allocations;
+		frame.AllocatedBytes += counts[i].Bytes;
+	}
+	uint64_t hostAllocations = _TotalHostAllocations(hostStats);
+	frame.HostAllocations = hostAllocations - std::min(LastHostAllocations, hostAllocations);
+	frame.HostLiveBytes = _LiveHostBytes(hostStats);
+	LastHostAllocations = hostAllocations;
+
+	if (hitch)
+	{
+		++HitchCount;
+		LOG_WARN("Hitch in frame %llu: %.2f ms, median %.2f ms\n", (unsigned long long)frameNumber, frameMs, median)
+		// a hitch right after another one goes into the same dump
+		if (PendingHitch == 0 && DumpCount < Settings.MaxDumps)
+			PendingHitch = frameNumber;
+	}
+	if (PendingHitch != 0 && frameNumber >= PendingHitch + FRAMES_AFTER_HITCH)
+		Flush();
+}
+
+void HitchDetector::OnGpuFrame(uint64_t frameNumber, double frameMs, double mainPassMs)
+{
+	std::lock_guard<std::mutex> lock(GpuMutex);
+	GpuRecord& gpu = GpuFrames[frameNumber % GpuFrames.size()];
+	gpu.FrameNumber = frameNumber;
+	gpu.FrameMs = frameMs;
+	gpu.MainPassMs = mainPassMs;
+}
+
+void HitchDetector::Flush()
+{
+	if (PendingHitch == 0)
+		return;
+	_Dump(PendingHitch);
+	PendingHitch = 0;
+}
+
+void HitchDetector::_Dump(uint64_t hitchFrame)
+{
+	// copies for the worker, the rings keep going
+	uint64_t first = hitchFrame > Settings.CapturedFrames ? hitchFrame - Settings.CapturedFrames + 1 : 1;
+	std::vector<FrameRecord> frames;
+	std::vector<GpuRecord> gpuFrames;
+	for (uint64_t frameNumber = first; frameNumber <= hitchFrame + FRAMES_AFTER_HITCH; ++frameNumber)
+	{
+		const FrameRecord& frame = Frames[frameNumber % Frames.size()];
+		if (frame.FrameNumber == frameNumber)
+			frames.push_back(frame);
+	}
+	{
+		std::lock_guard<std::mutex> lock(GpuMutex);
+		for (const GpuRecord& gpu : GpuFrames)
+		{
+			if (gpu.FrameNumber >= first && gpu.FrameNumber <= hitchFrame + FRAMES_AFTER_HITCH)
+				gpuFrames.push_back(gpu);
+		}
+	}
+
+	CpuProfiler& profiler = CpuProfiler::GetInstance();
+	std::vector<std::pair<uint32_t, std::string>> threadNames;
+	for (const FrameRecord& frame : frames)
+	{
+		for (const CpuZone& zone : frame.Zones)
+		{
+			auto known = std::find_if(threadNames.begin(), threadNames.end(), [&zone](const std::pair<uint32_t, std::string>& name) { return name.first == zone.ThreadIndex; });
+			char name[32];
+			if (known == threadNames.end() && profiler.GetThreadName(zone.ThreadIndex, name, sizeof(name)))
+				threadNames.emplace_back(zone.ThreadIndex, name);
+		}
+	}
+
+	std::string path = std::string(Settings.DumpPath) + "_" + std::to_string(hitchFrame) + ".json";
+	double msPerTick = profiler.TicksToMs(1);
+	double multiple = Settings.MedianMultiple;
+	++DumpCount;
+	// one dump at a time, they are far apart anyway
+	if (Writer.valid())
+		Writer.wait();
+	Writer = std::async(std::launch::async, [path, hitchFrame, multiple, msPerTick, frames = std::move(frames), gpuFrames = std::move(gpuFrames), threadNames = std::move(threadNames)]()
+	{
+		_WriteTrace(path, hitchFrame, multiple, msPerTick, frames, gpuFrames, threadNames);
+	});
+}
+
+void HitchDetector::_WriteTrace(const std::string& path, uint64_t hitchFrame, double multiple, double msPerTick
+	, const std::vector<FrameRecord>& frames, const std::vector<GpuRecord>& gpuFrames
+	, const std::vector<std::pair<uint32_t, std::string>>& threadNames)
+{
+	FILE* file = fopen(path.c_str(), "w");
+	if (!file)
+	{
+		LOG_WARN("Can't write the hitch dump %s\n", path.c_str())
+		return;
+	}
+
+	// trace event format (chrome://tracing, Perfetto), microseconds since the first captured frame started
+	uint64_t baseTick = UINT64_MAX;
+	for (const FrameRecord& frame : frames)
+	{
+		baseTick = std::min(baseTick, frame.EndTick - (uint64_t)(frame.FrameMs / msPerTick));
+		for (const CpuZone& zone : frame.Zones)
+			baseTick = std::min(baseTick, zone.Begin);
+	}
+	auto toUs = [baseTick, msPerTick](uint64_t tick) { return (double)(int64_t)(tick - baseTick) * msPerTick * 1000.0; };
+
+	const FrameRecord* hitch = nullptr;
+	for (const FrameRecord& frame : frames)
+	{
+		if (frame.FrameNumber == hitchFrame)
+			hitch = &frame;
+	}
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\n\"hitch\":{\"frame\":%llu,\"frameMs\":%.3f,\"medianMs\":%.3f,\"medianMultiple\":%.2f},\n"
+		, (unsigned long long)hitchFrame, hitch ? hitch->FrameMs : 0.0, hitch ? hitch->MedianMs : 0.0, multiple);
+
+	fprintf(file, "\"traceEvents\":[\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"frames\"}}", FRAMES_TRACK);
+	for (const std::pair<uint32_t, std::string>& name : threadNames)
+		fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", name.first, name.second.c_str());
+
+	for (const FrameRecord& frame : frames)
+	{
+		// cpu waits on the gpu, the swap chain and the present thread are the "wait ..." zones
+		double queueWaitMs = 0.0;
+		for (const CpuZone& zone : frame.Zones)
+		{
+			if (!strncmp(zone.Name, "wait", 4))
+				queueWaitMs += (zone.End - zone.Begin) * msPerTick;
+		}
+		const GpuRecord* gpu = nullptr;
+		for (const GpuRecord& record : gpuFrames)
+		{
+			if (record.FrameNumber == frame.FrameNumber)
+				gpu = &record;
+		}
+
+		double endUs = toUs(frame.EndTick);
+		double beginUs = endUs - frame.FrameMs * 1000.0;
+		fprintf(file, ",\n{\"name\":\"frame %llu%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{"
+			"\"frameMs\":%.3f,\"medianMs\":%.3f,\"queueWaitMs\":%.3f,\"allocations\":%llu,\"allocatedBytes\":%llu,\"hostAllocations\":%llu,\"hostLiveBytes\":%llu"
+			, (unsigned long long)frame.FrameNumber, frame.FrameNumber == hitchFrame ? " (hitch)" : "", FRAMES_TRACK, beginUs, frame.FrameMs * 1000.0
+			, frame.FrameMs, frame.MedianMs, queueWaitMs, (unsigned long long)frame.Allocations, (unsigned long long)frame.AllocatedBytes
+			, (unsigned long long)frame.HostAllocations, (unsigned long long)frame.HostLiveBytes);
+		// still in flight, or no timestamps on the graphics queue
+		bool hasGpuFrame = gpu && gpu->FrameMs >= 0.0;
+		if (hasGpuFrame)
+			fprintf(file, ",\"gpuFrameMs\":%.3f", gpu->FrameMs);
+		if (gpu && gpu->MainPassMs >= 0.0)
+			fprintf(file, ",\"gpuMainPassMs\":%.3f", gpu->MainPassMs);
+		fprintf(file, "}}");
+
+		fprintf(file, ",\n{\"name\":\"frame ms\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"cpu\":%.3f", beginUs, frame.FrameMs);
+		if (hasGpuFrame)
+			fprintf(file, ",\"gpu\":%.3f", gpu->FrameMs);
+		fprintf(file, "}}");
+		fprintf(file, ",\n{\"name\":\"queue wait ms\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"wait\":%.3f}}", beginUs, queueWaitMs);
+		fprintf(file, ",\n{\"name\":\"allocations\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"heap\":%llu,\"vulkan\":%llu}}"
+			, beginUs, (unsigned long long)frame.Allocations, (unsigned long long)frame.HostAllocations);
+
+		for (const CpuZone& zone : frame.Zones)
+		{
+			fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}"
+				, zone.Name, zone.ThreadIndex, toUs(zone.Begin), toUs(zone.End) - toUs(zone.Begin));
+		}
+	}
+	fprintf(file, "\n]}\n");
+	if (fclose(file) != 0)
+	{
+		LOG_WARN("Can't write the hitch dump %s\n", path.c_str())
+	}
+}
@@ -0,0 +1,81 @@
+#ifndef HITCH_DETECTOR_HPP
+#define HITCH_DETECTOR_HPP
+
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "defines.h"
+#include "core/engine/EngineSettings.h"
+#include "core/api/VulkanHostAllocator.h"
+#include "core/debugger/public/CpuProfiler.h"
+
+// Keeps the last frames around and dumps them when one of them takes far longer than the
+// rolling median, see HitchSettings. The dump waits a few frames after the hitch so the gpu
+// times of the frames up to it have been read back, and is written on a worker thread so it
+// doesn't hitch the next frames itself. Recording doesn't allocate once the rings are warm
+class HitchDetector
+{
+	static constexpr uint32_t MEDIAN_WINDOW = 120;
+	static constexpr uint32_t MIN_MEDIAN_SAMPLES = 30;// no hitches while the median settles
+	// more than the frames in flight plus the present queue
+	static constexpr uint32_t FRAMES_AFTER_HITCH = 8;
+	static constexpr std::size_t ZONES_RESERVED = 256;// per frame, grows once if a frame has more
+
+	struct FrameRecord
+	{
+		uint64_t FrameNumber = 0;
+		uint64_t EndTick = 0;// CpuProfiler ticks
+		double FrameMs = 0.0;
+		double MedianMs = 0.0;
+		std::vector<CpuZone> Zones;
+		uint64_t Allocations = 0;// operator new, all threads
+		uint64_t AllocatedBytes = 0;
+		uint64_t HostAllocations = 0;// vulkan host allocations made during the frame
+		uint64_t HostLiveBytes = 0;
+	};
+
+	struct GpuRecord
+	{
+		uint64_t FrameNumber = 0;
+		double FrameMs = -1.0;// negative when the scope had no results for the frame
+		double MainPassMs = -1.0;
+	};
+
+	HitchSettings Settings;
+	std::vector<FrameRecord> Frames;// ring by frame number
+	std::vector<GpuRecord> GpuFrames;// same ring, written by the thread rendering the frames
+	std::mutex GpuMutex;
+	double FrameTimes[MEDIAN_WINDOW];
+	uint64_t FrameTimeCount;
+	uint64_t LastHostAllocations;
+	uint64_t PendingHitch;// frame waiting for its dump, 0 none
+	uint32_t HitchCount;
+	uint32_t DumpCount;
+	std::future<void> Writer;// the last dump
+
+	double _Median() const;
+	void _Dump(uint64_t hitchFrame);
+	static void _WriteTrace(const std::string& path, uint64_t hitchFrame, double multiple, double msPerTick
+		, const std::vector<FrameRecord>& frames, const std::vector<GpuRecord>& gpuFrames
+		, const std::vector<std::pair<uint32_t, std::string>>& threadNames);
+
+public:
+	DISABLE_COPY(HitchDetector)
+	explicit HitchDetector(const HitchSettings& settings);
+	// waits for a dump still being written
+	~HitchDetector();
+
+	// main thread, after CpuProfiler and AllocationTracker collected the frame.
+	// frameMs: the whole frame, from its start to the start of the next one
+	void OnFrameEnd(uint64_t frameNumber, double frameMs, const HostAllocationStats& hostStats);
+	// any thread, when the gpu times of the frame are read back. A negative time is a scope whose
+	// queries had no results for the frame, it's left out of the dump
+	void OnGpuFrame(uint64_t frameNumber, double frameMs, double mainPassMs);
+	// writes a hitch still waiting for the frames after it, e.g: Run is returning
+	void Flush();
+	uint32_t GetHitchCount() const { return HitchCount; }
+};
+
+#endif //HITCH_DETECTOR_HPP
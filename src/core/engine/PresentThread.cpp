@@ -0,0 +1,111 @@
+#include "PresentThread.h"
+#include <algorithm>
+#include "core/debugger/public/CpuProfiler.h"
+#include "core/debugger/public/AllocationTracker.h"
+
+PresentThread::PresentThread(std::function<void(const FrameRequest&)> renderFrame, uint32_t maxQueuedFrames)
+	: Requests{}
+	, RenderFrame{ std::move(renderFrame) }
+	, MaxQueuedFrames{ std::min<uint32_t>(std::max(1u, maxQueuedFrames), QUEUE_CAPACITY) }
+	, Running{ true }
+	, PushedFrames{ 0 }
+	, CompletedFrames{ 0 }
+	, SleepMutex{}
+	, FramePushed{}
+	, FrameCompleted{}
+	, Error{}
+	, Thread{}
+{
+	Thread = std::thread(&PresentThread::_Loop, this);
+}
+
+PresentThread::~PresentThread()
+{
+	Stop();
+}
+
+void PresentThread::Push(const FrameRequest& request)
+{
+	{
+		PROFILE_SCOPE("wait present thread");
+		std::unique_lock<std::mutex> lock(SleepMutex);
+		FrameCompleted.wait(lock, [this]() { return PushedFrames - CompletedFrames < MaxQueuedFrames; });
+		_RethrowError();
+	}
+
+	Requests.TryPush(request);// can't fail, MaxQueuedFrames <= QUEUE_CAPACITY
+	++PushedFrames;
+
+	// take the lock so the wake up can't slip in between the present thread checking the queue and sleeping
+	{
+		std::lock_guard<std::mutex> lock(SleepMutex);
+	}
+	FramePushed.notify_one();
+}
+
+void PresentThread::Drain()
+{
+	std::unique_lock<std::mutex> lock(SleepMutex);
+	FrameCompleted.wait(lock, [this]() { return CompletedFrames == PushedFrames; });
+	_RethrowError();
+}
+
+void PresentThread::_RethrowError()
+{
+	if (!Error)
+		return;
+	std::exception_ptr error = Error;
+	Error = nullptr;
+	std::rethrow_exception(error);
+}
+
+void PresentThread::Stop()
+{
+	if (!Thread.joinable())
+		return;
+
+	{
+		std::unique_lock<std::mutex> lock(SleepMutex);
+		// no rethrow here, Stop runs from the destructor
+		FrameCompleted.wait(lock, [this]() { return CompletedFrames == PushedFrames; });
+		Running = false;
+	}
+	FramePushed.notify_one();
+	Thread.join();
+}
+
+void PresentThread::_Loop()
+{
+	CpuProfiler::SetThreadName("present");
+	AllocationTracker::SetThreadName("present");
+	while (true)
+	{
+		FrameRequest request;
+		if (!Requests.TryPop(request))
+		{
+			std::unique_lock<std::mutex> lock(SleepMutex);
+			FramePushed.wait(lock, [this]() { return !Requests.Empty() || !Running; });
+			if (!Running && Requests.Empty())
+				return;
+			continue;
+		}
+
+		std::exception_ptr error;
+		try
+		{
+			RenderFrame(request);
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(SleepMutex);
+			if (error)
+				Error = error;
+			++CompletedFrames;
+		}
+		FrameCompleted.notify_all();
+	}
+}
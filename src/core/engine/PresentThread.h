@@ -0,0 +1,56 @@
+#ifndef PRESENT_THREAD_HPP
+#define PRESENT_THREAD_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "defines.h"
+#include "core/utils/SpscQueue.h"
+
+// A frame the main thread finished its cpu work for, everything left is gpu side
+struct FrameRequest
+{
+	uint64_t FrameNumber;
+};
+
+// Owns acquire, submit and present so blocking in the driver or the presentation engine
+// never stalls the thread pumping window events. Frames come in through a lock-free queue,
+// the mutex and condition variables are only used to sleep while there is nothing to do
+class PresentThread
+{
+	static constexpr std::size_t QUEUE_CAPACITY = 8;
+
+	SpscQueue<FrameRequest, QUEUE_CAPACITY> Requests;
+	std::function<void(const FrameRequest&)> RenderFrame;
+	uint32_t MaxQueuedFrames;
+	std::atomic<bool> Running;
+	std::atomic<uint64_t> PushedFrames;
+	std::atomic<uint64_t> CompletedFrames;
+	std::mutex SleepMutex;
+	std::condition_variable FramePushed;
+	std::condition_variable FrameCompleted;
+	std::exception_ptr Error;// thrown by RenderFrame, rethrown on the main thread
+	std::thread Thread;
+
+	void _Loop();
+	void _RethrowError();
+
+public:
+	DISABLE_COPY(PresentThread)
+	// renderFrame runs on the present thread once per pushed frame, in order
+	PresentThread(std::function<void(const FrameRequest&)> renderFrame, uint32_t maxQueuedFrames);
+	~PresentThread();
+
+	// blocks while maxQueuedFrames frames are still waiting, so the main thread can't run away
+	void Push(const FrameRequest& request);
+	// returns once every pushed frame has been rendered and presented, after this the
+	// main thread can touch the swap chain until the next Push
+	void Drain();
+	void Stop();
+};
+
+#endif //PRESENT_THREAD_HPP
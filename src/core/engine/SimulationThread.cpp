@@ -0,0 +1,145 @@
+#include "SimulationThread.h"
+#include <algorithm>
+#include "core/debugger/public/CpuProfiler.h"
+#include "core/debugger/public/AllocationTracker.h"
+
+SimulationThread::SimulationThread(const SimulationState& initialState, std::function<void(SimulationState&, double)> update, uint32_t stepsPerSecond)
+	: State{ initialState }
+	, Update{ std::move(update) }
+	, StepDuration{}
+	, StepSeconds{ 1.0 / std::max(1u, stepsPerSecond) }
+	, Step{ 0 }
+	, Packets{}
+	, Running{ true }
+	, Failed{ false }
+	, SleepMutex{}
+	, StopRequested{}
+	, Error{}
+	, Thread{}
+{
+	StepDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(StepSeconds));
+	// previous and current are the same so the first frames render the initial state as is
+	_PublishPacket(State, std::chrono::steady_clock::now());
+	Thread = std::thread(&SimulationThread::_Loop, this);
+}
+
+SimulationThread::~SimulationThread()
+{
+	Stop();
+}
+
+void SimulationThread::Stop()
+{
+	if (!Thread.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(SleepMutex);
+		Running = false;
+	}
+	StopRequested.notify_one();
+	Thread.join();
+}
+
+const FramePacket& SimulationThread::GetLatestPacket()
+{
+	if (Failed)
+	{
+		std::exception_ptr error;
+		{
+			std::lock_guard<std::mutex> lock(SleepMutex);
+			error = Error;
+			Error = nullptr;
+			Failed = false;
+		}
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+	Packets.Update();
+	return Packets.GetReadBuffer();
+}
+
+void SimulationThread::_Loop()
+{
+	CpuProfiler::SetThreadName("simulation");
+	AllocationTracker::SetThreadName("simulation");
+	SimulationState previous = State;
+	std::chrono::steady_clock::time_point nextStep = std::chrono::steady_clock::now() + StepDuration;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(SleepMutex);
+			StopRequested.wait_until(lock, nextStep, [this]() { return !Running; });
+			if (!Running)
+				return;
+		}
+
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (now - nextStep > StepDuration * MAX_CATCH_UP_STEPS)
+			nextStep = now;
+
+		try
+		{
+			// run every step that is due, the render thread only picks up the newest packet
+			while (nextStep <= now)
+			{
+				PROFILE_SCOPE("simulation step");
+				// assign keeps the capacity, steady state steps don't allocate
+				previous.Objects.assign(State.Objects.begin(), State.Objects.end());
+				previous.Camera = State.Camera;
+				Update(State, StepSeconds);
+				++Step;
+				_PublishPacket(previous, nextStep);
+				nextStep += StepDuration;
+			}
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(SleepMutex);
+			Error = std::current_exception();
+			Failed = true;
+			Running = false;
+			return;
+		}
+	}
+}
+
+void SimulationThread::_PublishPacket(const SimulationState& previous, std::chrono::steady_clock::time_point stepTime)
+{
+	FramePacket& packet = Packets.GetWriteBuffer();
+	packet.Step = Step;
+	packet.StepTime = stepTime;
+	packet.StepSeconds = StepSeconds;
+	packet.Previous.assign(previous.Objects.begin(), previous.Objects.end());
+	packet.Current.assign(State.Objects.begin(), State.Objects.end());
+	packet.PreviousCamera = previous.Camera;
+	packet.Camera = State.Camera;
+	_BuildVisibleList(State, packet.Visible);
+	Packets.Publish();
+}
+
+void SimulationThread::_BuildVisibleList(const SimulationState& state, std::vector<uint32_t>& visible)
+{
+	// coarse culling: drop what is behind the camera or past the far plane,
+	// the rasterizer takes care of the rest
+	PROFILE_SCOPE("cull");
+	const CameraState& camera = state.Camera;
+	glm::vec3 forward = glm::normalize(camera.Target - camera.Position);
+
+	visible.clear();
+	for (uint32_t i = 0; i < (uint32_t)state.Objects.size(); ++i)
+	{
+		const ObjectState& object = state.Objects[i];
+		if (!object.Visible)
+			continue;
+
+		float scale = std::max(object.Scale.x, std::max(object.Scale.y, object.Scale.z));
+		float radius = object.Radius * scale;
+		float depth = glm::dot(object.Position - camera.Position, forward);
+		if (depth + radius < camera.Near || depth - radius > camera.Far)
+			continue;
+		visible.push_back(i);
+	}
+}
@@ -0,0 +1,52 @@
+#ifndef SIMULATION_THREAD_HPP
+#define SIMULATION_THREAD_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "defines.h"
+#include "core/engine/FramePacket.h"
+#include "core/utils/TripleBuffer.h"
+
+// Steps the simulation at a fixed rate on its own thread, independent of how fast frames are
+// rendered and presented. Every step is published as a FramePacket through a triple buffer,
+// the render thread always picks up the newest one and never waits for the simulation
+class SimulationThread
+{
+	// after a hitch (debugger, window drag...) don't try to catch up more than this, just skip ahead
+	static constexpr uint32_t MAX_CATCH_UP_STEPS = 5;
+
+	SimulationState State;
+	std::function<void(SimulationState&, double)> Update;
+	std::chrono::steady_clock::duration StepDuration;
+	double StepSeconds;
+	uint64_t Step;
+	TripleBuffer<FramePacket> Packets;
+	std::atomic<bool> Running;
+	std::atomic<bool> Failed;
+	std::mutex SleepMutex;
+	std::condition_variable StopRequested;
+	std::exception_ptr Error;// thrown by Update, rethrown on the render thread
+	std::thread Thread;
+
+	void _Loop();
+	void _PublishPacket(const SimulationState& previous, std::chrono::steady_clock::time_point stepTime);
+	static void _BuildVisibleList(const SimulationState& state, std::vector<uint32_t>& visible);
+
+public:
+	DISABLE_COPY(SimulationThread)
+	// update runs on the simulation thread with the step length in seconds, stepsPerSecond times a second
+	SimulationThread(const SimulationState& initialState, std::function<void(SimulationState&, double)> update, uint32_t stepsPerSecond);
+	~SimulationThread();
+
+	// render thread only: the newest published packet, valid until the next call.
+	// There is always one, the initial state is published before the thread starts
+	const FramePacket& GetLatestPacket();
+	void Stop();
+};
+
+#endif //SIMULATION_THREAD_HPP
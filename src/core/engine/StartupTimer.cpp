@@ -0,0 +1,62 @@
+#include "StartupTimer.h"
+#include "core/debugger/public/CpuProfiler.h"
+#include "core/debugger/public/Logger.h"
+
+StartupTimer::Stage::Stage(StartupTimer& timer, const char* name, bool background)
+	: Timer{ timer }
+	, Name{ name }
+	, Background{ background }
+	, StageBegin{ Clock::now() }
+	, ProfilerBegin{ CpuProfiler::Now() }
+{
+}
+
+StartupTimer::Stage::~Stage()
+{
+	CpuProfiler::Record(Name, ProfilerBegin, CpuProfiler::Now());
+	Clock::time_point end = Clock::now();
+	std::lock_guard<std::mutex> lock(Timer.Lock);
+	Timer.Stats.Stages.push_back(StartupStage{ Name, Timer._MsSinceBegin(StageBegin)
+		, std::chrono::duration<double, std::milli>(end - StageBegin).count(), Background });
+}
+
+StartupTimer::StartupTimer()
+	: Begin{ Clock::now() }
+	, Lock{}
+	, Stats{}
+{
+}
+
+void StartupTimer::OnInitDone()
+{
+	std::lock_guard<std::mutex> lock(Lock);
+	Stats.InitMs = _MsSinceBegin(Clock::now());
+}
+
+bool StartupTimer::OnFrameSubmitted()
+{
+	std::lock_guard<std::mutex> lock(Lock);
+	if (Stats.TimeToFirstFrameMs > 0.0)
+		return false;
+	Stats.TimeToFirstFrameMs = _MsSinceBegin(Clock::now());
+	return true;
+}
+
+StartupStats StartupTimer::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(Lock);
+	return Stats;
+}
+
+void StartupTimer::LogStages() const
+{
+	// LOG_TRACE is compiled out in release, nothing to walk the stages for
+#ifndef NDEBUG
+	StartupStats stats = GetStats();
+	for (const StartupStage& stage : stats.Stages)
+	{
+		LOG_TRACE("Startup %-20s %8.2f ms (at %.2f ms%s)\n", stage.Name, stage.DurationMs, stage.BeginMs, stage.Background ? ", background" : "")
+	}
+	LOG_TRACE("Startup took %.2f ms\n", stats.InitMs)
+#endif
+}
@@ -0,0 +1,60 @@
+#ifndef STARTUP_TIMER_HPP
+#define STARTUP_TIMER_HPP
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include "defines.h"
+
+struct StartupStage
+{
+	const char* Name;
+	double BeginMs;// since the engine started
+	double DurationMs;
+	bool Background;// overlapped with the main thread stages
+};
+
+struct StartupStats
+{
+	std::vector<StartupStage> Stages;// in the order they finished
+	double InitMs = 0.0;// constructor start to return
+	double TimeToFirstFrameMs = 0.0;// constructor start to the first frame submitted, 0 until then
+};
+
+// Times the startup stages of the engine. Stages can finish on any thread
+class StartupTimer
+{
+	using Clock = std::chrono::steady_clock;
+
+	Clock::time_point Begin;
+	mutable std::mutex Lock;
+	StartupStats Stats;
+
+	double _MsSinceBegin(Clock::time_point time) const { return std::chrono::duration<double, std::milli>(time - Begin).count(); }
+
+public:
+	// a stage from construction to destruction, also a cpu profiler zone
+	class Stage
+	{
+		StartupTimer& Timer;
+		const char* Name;
+		bool Background;
+		Clock::time_point StageBegin;
+		uint64_t ProfilerBegin;
+	public:
+		DISABLE_COPY(Stage)
+		Stage(StartupTimer& timer, const char* name, bool background = false);
+		~Stage();
+	};
+
+	StartupTimer();
+
+	void OnInitDone();
+	// only the first call counts, returns true for it
+	bool OnFrameSubmitted();
+	StartupStats GetStats() const;
+	// stages and init time to the trace log
+	void LogStages() const;
+};
+
+#endif //STARTUP_TIMER_HPP
@@ -1,35 +1,128 @@
 #include "VEngine.h"
 
+#ifdef _WIN32
 #include <Windows.h>
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
 
 #include "core/debugger/public/Logger.h"
-#include "core/api/pipelineConfigs/VulkanPipeLineDefaultConfiguration.h"
+#include "core/debugger/public/CpuProfiler.h"
+#include "core/debugger/public/AllocationTracker.h"
+#include "core/api/pipelineConfigs/VulkanPipelineDefaultConfiguration.h"
 #include "core/api/VulkanSwapChain.h"
 #include "core/api/VulkanPipeline.h"
 #include "core/api/VulkanLib.h"
 #include "core/api/VertexBuffer.h"
+#include "core/api/VulkanUploadManager.h"
+#include "core/api/VulkanAsyncCompute.h"
+#include "core/api/VulkanLateLatchBuffer.h"
+#include "core/api/VulkanGpuProfiler.h"
+#include "core/engine/PresentThread.h"
+#include "core/engine/SimulationThread.h"
+#include "core/engine/HitchDetector.h"
 
-VEngine::VEngine(const char* appname, HINSTANCE instance)
-	: Window( (LPCTSTR)appname )
+VEngine::VEngine(const EngineSettings& settings)
+	: Startup{}
+	, Window{nullptr}
+	, Settings{ settings }
 	, Vulkan{ nullptr }
 	, SwapChain{nullptr}
+	, Uploader{nullptr}
+	, AsyncCompute{nullptr}
+	, ComputeCallback{}
+	, ComputeConsumerStages{0}
+	, LateLatch{nullptr}
 	, PipelineLayout{nullptr}
-	, Pipeline{ nullptr}
+	, Pipelines{}
 	, AppInfo{}
+	, FrameCommandPool{ VK_NULL_HANDLE }
 	, CommandBuffers{}
-	, Vertexbuffer{nullptr}
+	, Meshes{}
+	, GpuProfiler{nullptr}
+	, FrameScope{0}
+	, MainPassScope{0}
+	, TimedFrameNumbers{}
+	, CpuFrameTimes{}
+	, FrameTimingCallback{}
+	, Presenter{nullptr}
+	, FrameNumber{0}
+	, SwapChainOutOfDate{false}
+	, Scene{}
+	, SimulationUpdate{}
+	, Simulation{nullptr}
+	, Pacer{}
+	, Hitches{nullptr}
+	, AcquirePending{false}
+	, RecordedPacket{nullptr}
+	, RecordedAlpha{1.0f}
+	, RecordedFrameValue{0}
+	, StopRequested{false}
+	, PipelineShaders{}
 {
-    
-	Window.CreateWin32Window(instance);
-	Vulkan = _CreateVulkanInstance(appname);
-	SwapChain = new VulkanSwapChain{ *Vulkan,VkExtent2D{Window.Width,Window.Height} };
-	VkExtent2D swapChainExtent = SwapChain->GetSwapChainExtent();
+}
+
+#ifdef _WIN32
+VEngine::VEngine(const char* appname, HINSTANCE instance, const EngineSettings& settings)
+	: VEngine(settings)
+{
+	// only the object here, the window itself is created while vulkan starts up
+	if (!Settings.Headless.Enabled)
+		Window = new Win32Window((LPCTSTR)appname);
+	_Init(appname, [this, instance]()
+	{
+		if (Window)
+			Window->CreateWin32Window(instance);
+	});
+}
+#endif
+
+VEngine::VEngine(const char* appname, const EngineSettings& settings)
+	: VEngine(settings)
+{
+	Settings.Headless.Enabled = true;
+	_Init(appname, {});
+}
+
+void VEngine::_Init(const char* appname, const std::function<void()>& createWindow)
+{
+	// disk reads need nothing from vulkan, they overlap with the instance and device creation.
+	// The futures join before any exception leaves here
+	std::future<ShaderList> shaders = std::async(std::launch::async, [this]()
+	{
+		StartupTimer::Stage stage(Startup, "shader load", true);
+		return VulkanPipeline::LoadShaders();
+	});
+	std::future<std::vector<char>> pipelineCache = std::async(std::launch::async, [this]()
+	{
+		StartupTimer::Stage stage(Startup, "pipeline cache read", true);
+		return _ReadPipelineCache();
+	});
+
+	Vulkan = _CreateVulkanInstance(appname, createWindow);
+	{
+		StartupTimer::Stage stage(Startup, "pipeline cache");
+		Vulkan->CreatePipelineCache(pipelineCache.get());
+	}
+	{
+		StartupTimer::Stage stage(Startup, "swap chain");
+		Uploader = new VulkanUploadManager{ *Vulkan };
+		// headless the swap chain renders into offscreen images of this size
+		SwapChain = new VulkanSwapChain{ *Vulkan, _GetTargetExtent(), Settings.SwapChain };
+		AsyncCompute = new VulkanAsyncCompute{ *Vulkan, *SwapChain };
+		// one region per swap chain image covers any frames in flight setting without waits
+		LateLatch = new VulkanLateLatchBuffer{ *Vulkan, sizeof(glm::mat4), (uint32_t)SwapChain->ImageCount() };
+		SwapChain->SetLateLatchCallback([this](uint64_t frameValue) { _LatchCamera(frameValue); });
+	}
 	_CreatePipeLineLayout();
-	VulkanPipelineDefaultConfiguration pipelineConfigInfo;
-	pipelineConfigInfo.CreatePipelineConfigInfo(swapChainExtent.width, swapChainExtent.height);
-	
-	pipelineConfigInfo.PipelineLayout = PipelineLayout;	
-	pipelineConfigInfo.Renderpass = SwapChain->GetRenderPass();
+	PipelineShaders = shaders.get();
 
 	std::vector<float> triangle
 	{
@@ -38,190 +131,734 @@ VEngine::VEngine(const char* appname, HINSTANCE instance)
 		-0.5f,0.5f,0.0,  0.0f,0.0f,1.0f
 	};
 
-	Vertexbuffer = new VertexBuffer(*Vulkan, triangle, 6* sizeof(float), 0, 2);
-	Pipeline = new VulkanPipeline{*Vulkan, pipelineConfigInfo,Vertexbuffer};
+	// mesh 0 first, the pipelines take the vertex layout from it
+	{
+		StartupTimer::Stage stage(Startup, "vertex buffer");
+		AddMesh(triangle);
+	}
+	{
+		StartupTimer::Stage stage(Startup, "pipeline");
+		AddPipelineVariant();
+	}
 	_CreateCommandBuffers();
+	GpuProfiler = new VulkanGpuProfiler{ *Vulkan, MAX_TIMED_SLOTS, 32, Settings.GpuPipelineStatistics };
+	FrameScope = GpuProfiler->RegisterScope("frame");
+	MainPassScope = GpuProfiler->RegisterScope("main pass");
+	if (Settings.Hitch.Enabled)
+		Hitches = new HitchDetector{ Settings.Hitch };
+	_CreateDefaultScene();
+
+#ifdef _WIN32
+	// Win32 runs its own loop while the user drags the window border, keep drawing from there
+	if (Window)
+		Window->SetLiveResizeCallback([this]() { Draw(); });
+#endif
 
+	if (Settings.PresentThread)
+		Presenter = new PresentThread{ [this](const FrameRequest& request) { _RenderFrame(request); }, Settings.PresentQueueDepth };
 
+	Startup.OnInitDone();
+	Startup.LogStages();
 }
 
 VEngine::~VEngine()
 {
-	delete Vertexbuffer;
-	vkFreeCommandBuffers(Vulkan->GetLogicalDevice(), Vulkan->GetCommandPool(), static_cast<uint32_t>(CommandBuffers.size()), CommandBuffers.data());
-	delete Pipeline;
-	vkDestroyPipelineLayout(Vulkan->GetLogicalDevice(), PipelineLayout, nullptr);
+	// no frame can be in the middle of a submit while we tear down
+	delete Presenter;
+	delete Simulation;
+	// the constructor threw before the library was up
+	if (!Vulkan)
+	{
+		_DestroyWindow();
+		return;
+	}
+
+	const VulkanDispatch& vk = Vulkan->GetDispatch();
+
+	// Resources go through the deletion queue, so the order here doesn't matter for the gpu.
+	// Shutdown is the only place we wait for the whole device: the swap chain and the sync
+	// objects can't be deferred past it
+	vk.DeviceWaitIdle(Vulkan->GetLogicalDevice());
+	_WritePipelineCache();
+
+	for (VertexBuffer* mesh : Meshes)
+		delete mesh;
+	// after the command buffers of older swap chains, they are freed from this pool by the deletion queue
+	if (FrameCommandPool)
+	{
+		VkDevice device = Vulkan->GetLogicalDevice();
+		const VkAllocationCallbacks* allocator = Vulkan->GetAllocator();
+		Vulkan->GetDeletionQueue().Push([dispatch = &vk, device, allocator, commandPool = FrameCommandPool]()
+		{
+			dispatch->DestroyCommandPool(device, commandPool, allocator);
+		});
+	}
+	delete GpuProfiler;
+	delete Hitches;
+	for (VulkanPipeline* pipeline : Pipelines)
+		delete pipeline;
+	Vulkan->GetDeletionQueue().DestroyPipelineLayout(PipelineLayout);
+	delete LateLatch;
+	delete AsyncCompute;
 	delete SwapChain;
+	delete Uploader;
 	// the last thing to be deleted should be the library
 	delete Vulkan;
+	// the surface is gone, the window can go too
+	_DestroyWindow();
 }
 
-VulkanLib* VEngine::_CreateVulkanInstance(const char* appName)
+VulkanLib* VEngine::_CreateVulkanInstance(const char* appName, const std::function<void()>& createWindow)
 {
 	//if throw doesn't matter nothing has been allocated at this moment
 	VulkanLib* vulkan = nullptr;
-	vulkan = new VulkanLib(Window);
+	vulkan = new VulkanLib(Window);// null window: headless, no surface
 	AppInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
 	AppInfo.pApplicationName = appName;
 	AppInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	AppInfo.pEngineName = "VEngine";
 	AppInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	AppInfo.apiVersion = VK_API_VERSION_1_0;
+	// highest version we know about, VulkanLib lowers it to what the loader and gpu support
+#ifdef VK_API_VERSION_1_3
+	AppInfo.apiVersion = VK_API_VERSION_1_3;
+#else
+	AppInfo.apiVersion = VK_API_VERSION_1_2;
+#endif
 	try
 	{  // this can throw and if we throw at this moment we have succesfully
 	   // allocated vulkanLib pointer so we need to clean up 
-		vulkan->Init(AppInfo);
+		// loading the loader, layers and drivers is the slow part of the instance, the window
+		// gets created meanwhile. The surface needs both
+		std::future<void> instance = std::async(std::launch::async, [this, vulkan]()
+		{
+			StartupTimer::Stage stage(Startup, "vulkan instance", true);
+			vulkan->InitInstance(AppInfo);
+		});
+		if (createWindow)
+		{
+			StartupTimer::Stage stage(Startup, "window");
+			createWindow();
+		}
+		instance.get();
+
+		StartupTimer::Stage stage(Startup, "vulkan device");
+		vulkan->InitDevice();
 	}
-	catch (const std::exception& e)
+	catch (...)
 	{
 		if (vulkan) delete vulkan;
 		vulkan = nullptr;
-		throw e;
+		throw;// rethrow, not a copy: the message of the runtime_error has to reach main
 	}
 	return vulkan;
 }
 
+std::vector<char> VEngine::_ReadPipelineCache() const
+{
+	// no file on the first run, the cache starts empty
+	std::vector<char> data;
+	if (!Settings.PipelineCachePath)
+		return data;
+
+	std::ifstream file(Settings.PipelineCachePath, std::ios::ate | std::ios::binary);
+	if (!file.is_open())
+		return data;
+	data.resize((std::size_t)file.tellg());
+	file.seekg(0);
+	file.read(data.data(), data.size());
+	if (!file)
+		data.clear();
+	return data;
+}
+
+void VEngine::_WritePipelineCache() const
+{
+	if (!Settings.PipelineCachePath)
+		return;
+
+	std::vector<char> data = Vulkan->GetPipelineCacheData();
+	std::ofstream file(Settings.PipelineCachePath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open() || !file.write(data.data(), data.size()))
+		LOG_WARN("Can't write the pipeline cache to %s\n", Settings.PipelineCachePath)
+}
+
 void VEngine::_CreatePipeLineLayout()
 {
+	const VulkanDispatch& vk = Vulkan->GetDispatch();
 	// This sets uniforms values to shaders can be change at draw time like mvp matrix, texture samples
 	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = 0;
-	pipelineLayoutInfo.pSetLayouts = nullptr;
-	pipelineLayoutInfo.pushConstantRangeCount = 0;
-	pipelineLayoutInfo.pPushConstantRanges = nullptr;
+	// set 0 is the late latched camera, the object transform goes in a push constant, see vertex.glsl
+	VkDescriptorSetLayout cameraSetLayout = LateLatch->GetSetLayout();
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &cameraSetLayout;
+
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(glm::mat4);
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
 
-	VK_CHECK(vkCreatePipelineLayout(Vulkan->GetLogicalDevice(), &pipelineLayoutInfo, nullptr, &PipelineLayout));
+	VK_CHECK(vk.CreatePipelineLayout(Vulkan->GetLogicalDevice(), &pipelineLayoutInfo, Vulkan->GetAllocator(), &PipelineLayout));
 }
 
 void VEngine::_CreateCommandBuffers()
 {
+	const VulkanDispatch& vk = Vulkan->GetDispatch();
+	if (!FrameCommandPool)
+	{
+		VkCommandPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = (uint32_t)Vulkan->GetGraphicsQueueIndex();
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		VK_CHECK(vk.CreateCommandPool(Vulkan->GetLogicalDevice(), &poolInfo, Vulkan->GetAllocator(), &FrameCommandPool));
+	}
+
+	// one per frame slot, recorded again every frame with the latest simulation state.
+	// Frames in flight can change without a new swap chain, the image count is the upper bound
 	CommandBuffers.resize(SwapChain->ImageCount());
 
 	VkCommandBufferAllocateInfo allocInfo = {};
 	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo. commandPool = Vulkan->GetCommandPool();
+	allocInfo. commandPool = FrameCommandPool;
 	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;// can be submit for exec but not being called by other commands
 	allocInfo.commandBufferCount = (uint32_t) CommandBuffers.size();
 	
-	VK_CHECK(vkAllocateCommandBuffers(Vulkan->GetLogicalDevice(), &allocInfo, CommandBuffers.data()));
-
-	// we associate each command buffer with one of the framebuffers available
-	for (int i = 0; i < CommandBuffers.size(); ++i)
-	{
-		VkCommandBufferBeginInfo beginInfo = {};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;	
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-		//start comman buffer recording
-		VK_CHECK(vkBeginCommandBuffer(CommandBuffers[i], &beginInfo));
-		
-		VkRenderPassBeginInfo renderPassInfo = {};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass = SwapChain->GetRenderPass();
-		renderPassInfo.framebuffer = SwapChain->GetFrameBuffer(i);
-		renderPassInfo.renderArea.offset = { 0,0 };
-		renderPassInfo.renderArea.extent = SwapChain->GetSwapChainExtent();
-		
-		VkClearValue clearValues[2] = {};
-		clearValues[0].color = VkClearColorValue{ 0.5f,0.3f,0.8f,1.0f };
-		clearValues[1].depthStencil = VkClearDepthStencilValue{ 1.0f,0 };
-		
-		renderPassInfo.clearValueCount = 2;
-		renderPassInfo.pClearValues = clearValues;
-
-		//Start render pass
-		vkCmdBeginRenderPass(CommandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-		// bind graphics pipeline 
-		// Binding a pipeline is very similar to glUseProgram, 
-		// with much more state than only the programmable shaders
-		Pipeline->BindPipeline(CommandBuffers[i]);
-
-		// set the view port and scissors dynamically so we don't have to recreate the pipeline
-		VkExtent2D  extent = SwapChain->GetSwapChainExtent();
-		VkViewport viewport = {};
-		viewport.height = (float)extent.height;
-		viewport.width = (float)extent.width;
-		viewport.minDepth = (float)0.0f;
-		viewport.maxDepth = (float)1.0f;
-		viewport.x = 0;
-		viewport.y = 0;
-		vkCmdSetViewport(CommandBuffers[i], 0, 1, &viewport);
-
-		VkRect2D scissor = {};
-		scissor.offset = { 0,0 };
-		scissor.extent = { extent.width,(uint32_t)extent.height };
-		vkCmdSetScissor(CommandBuffers[i], 0, 1, &scissor);
-
-        // bind vertex buffer
-		Vertexbuffer->BindBuffer(CommandBuffers[i]);
-		// set the draw command
-		vkCmdDraw(CommandBuffers[i], (uint32_t)Vertexbuffer->GetVerticesSize() , 1, 0, 0);
-		//End render pass
-		vkCmdEndRenderPass(CommandBuffers[i]);
-
-		//end command buffer recording
-		VK_CHECK(vkEndCommandBuffer(CommandBuffers[i]));
+	VK_CHECK(vk.AllocateCommandBuffers(Vulkan->GetLogicalDevice(), &allocInfo, CommandBuffers.data()));
+}
+
+void VEngine::_ReportFrameTiming(uint32_t slot)
+{
+	if (slot >= MAX_TIMED_SLOTS || TimedFrameNumbers[slot] == 0)
+		return;
+
+	FrameTiming timing;
+	timing.FrameNumber = TimedFrameNumbers[slot];
+	timing.CpuFrameMs = CpuFrameTimes[timing.FrameNumber % CPU_TIME_HISTORY];
+	TimedFrameNumbers[slot] = 0;
+
+	// the frame is done, its queries are read without waiting
+	if (GpuProfiler->ResolveFrame(slot))
+	{
+		// the frame scope alone can be missing its results, there is no gpu time for the frame then
+		timing.HasGpuTime = GpuProfiler->GetLastMs(FrameScope, timing.GpuFrameMs);
+		double mainPassMs = 0.0;
+		bool hasMainPass = GpuProfiler->GetLastMs(MainPassScope, mainPassMs);
+		if (Hitches)
+			Hitches->OnGpuFrame(timing.FrameNumber, timing.HasGpuTime ? timing.GpuFrameMs : -1.0, hasMainPass ? mainPassMs : -1.0);
 	}
+
+	if (FrameTimingCallback)
+		FrameTimingCallback(timing);
+}
+
+uint32_t VEngine::AddMesh(const std::vector<float>& vertices)
+{
+	// same layout as the triangle, the pipelines were created against it
+	Meshes.push_back(new VertexBuffer(*Vulkan, vertices, 6 * sizeof(float), 0, 2, Uploader));
+	return (uint32_t)Meshes.size() - 1;
+}
+
+uint32_t VEngine::AddPipelineVariant()
+{
+	VkExtent2D swapChainExtent = SwapChain->GetSwapChainExtent();
+	VulkanPipelineDefaultConfiguration pipelineConfigInfo;
+	pipelineConfigInfo.CreatePipelineConfigInfo(swapChainExtent.width, swapChainExtent.height);
+
+	pipelineConfigInfo.PipelineLayout = PipelineLayout;
+	pipelineConfigInfo.Renderpass = SwapChain->GetRenderPass();
+	// a fraction of the smallest depth step, nothing moves but the state is different
+	uint32_t variant = (uint32_t)Pipelines.size();
+	if (variant > 0)
+	{
+		pipelineConfigInfo.RasterizerInfo.depthBiasEnable = VK_TRUE;
+		pipelineConfigInfo.RasterizerInfo.depthBiasConstantFactor = 0.001f * variant;
+	}
+
+	Pipelines.push_back(new VulkanPipeline{ *Vulkan, pipelineConfigInfo, Meshes[0], PipelineShaders.empty() ? nullptr : &PipelineShaders });
+	return variant;
+}
+
+void VEngine::_CreateDefaultScene()
+{
+	// a few copies of the triangle spinning at different speeds
+	Scene = {};
+	for (int i = -1; i <= 1; ++i)
+	{
+		ObjectState triangle;
+		triangle.Position = glm::vec3(0.8f * i, 0.0f, 0.0f);
+		triangle.Scale = glm::vec3(0.6f);
+		triangle.Radius = 0.5f;
+		Scene.Objects.push_back(triangle);
+	}
+
+	SimulationUpdate = [](SimulationState& state, double dt)
+	{
+		for (std::size_t i = 0; i < state.Objects.size(); ++i)
+		{
+			float speed = glm::radians(45.0f) * (float)(i + 1);
+			glm::quat spin = glm::angleAxis(speed * (float)dt, glm::vec3(0.0f, 0.0f, 1.0f));
+			state.Objects[i].Rotation = glm::normalize(spin * state.Objects[i].Rotation);
+		}
+	};
+}
+
+void VEngine::SetSimulation(const SimulationState& initialState, std::function<void(SimulationState&, double)> update)
+{
+	if (Simulation)
+	{
+		LOG_WARN("SetSimulation ignored, the simulation is already running\n");
+		return;
+	}
+	Scene = initialState;
+	SimulationUpdate = std::move(update);
+}
+
+float VEngine::_InterpolationAlpha(const FramePacket& packet)
+{
+	// The packet holds the states before and after the last step, and the current state was due
+	// at StepTime. Rendering now - StepTime into the step keeps motion smooth whatever the frame
+	// rate, at the cost of one simulation step of latency
+	if (packet.StepSeconds <= 0.0)
+		return 1.0f;
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - packet.StepTime).count();
+	return (float)std::min(std::max(elapsed / packet.StepSeconds, 0.0), 1.0);
+}
+
+void VEngine::_LatchCamera(uint64_t frameValue)
+{
+	// the command buffer binds the region of the value it was recorded for
+	if (frameValue != RecordedFrameValue)
+	{
+		LOG_ERR("Frame %llu submitted with the command buffer recorded for frame %llu\n", (unsigned long long)frameValue, (unsigned long long)RecordedFrameValue);
+	}
+
+	glm::mat4 viewProjection(1.0f);
+	if (RecordedPacket)
+	{
+		// same packet and alpha as the objects of the frame, a newer step would make them jitter against the camera
+		const FramePacket& packet = *RecordedPacket;
+		float alpha = RecordedAlpha;
+		const CameraState& from = packet.PreviousCamera;
+		const CameraState& to = packet.Camera;
+		VkExtent2D extent = SwapChain->GetSwapChainExtent();
+
+		glm::mat4 view = glm::lookAtRH(glm::mix(from.Position, to.Position, alpha)
+			, glm::mix(from.Target, to.Target, alpha), glm::normalize(glm::mix(from.Up, to.Up, alpha)));
+		glm::mat4 projection = glm::perspectiveRH_ZO(glm::mix(from.FovY, to.FovY, alpha)
+			, (float)extent.width / (float)extent.height, to.Near, to.Far);
+		projection[1][1] *= -1.0f;// vulkan clip space has y pointing down
+		viewProjection = projection * view;
+	}
+	LateLatch->Write(frameValue, &viewProjection, sizeof(viewProjection));
+}
+
+void VEngine::_RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint64_t frameValue, const FramePacket* packet)
+{
+	const VulkanDispatch& vk = Vulkan->GetDispatch();
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;	
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	//start comman buffer recording, the pool resets it implicitly
+	PROFILE_SCOPE("record");
+	VK_CHECK(vk.BeginCommandBuffer(commandBuffer, &beginInfo));
+
+	GpuProfiler->BeginFrame(commandBuffer, (uint32_t)SwapChain->GetCurrentFrame());
+	GpuProfiler->BeginScope(commandBuffer, FrameScope, Settings.GpuPipelineStatistics);
+	
+	VkExtent2D  extent = SwapChain->GetSwapChainExtent();
+	VkRenderPassBeginInfo renderPassInfo = {};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassInfo.renderPass = SwapChain->GetRenderPass();
+	renderPassInfo.framebuffer = SwapChain->GetFrameBuffer(imageIndex);
+	renderPassInfo.renderArea.offset = { 0,0 };
+	renderPassInfo.renderArea.extent = extent;
+	
+	VkClearValue clearValues[2] = {};
+	clearValues[0].color = VkClearColorValue{ 0.5f,0.3f,0.8f,1.0f };
+	clearValues[1].depthStencil = VkClearDepthStencilValue{ 1.0f,0 };
+	
+	renderPassInfo.clearValueCount = 2;
+	renderPassInfo.pClearValues = clearValues;
+
+	//Start render pass
+	GpuProfiler->BeginScope(commandBuffer, MainPassScope);
+	vk.CmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+	// set the view port and scissors dynamically so we don't have to recreate the pipeline
+	VkViewport viewport = {};
+	viewport.height = (float)extent.height;
+	viewport.width = (float)extent.width;
+	viewport.minDepth = (float)0.0f;
+	viewport.maxDepth = (float)1.0f;
+	viewport.x = 0;
+	viewport.y = 0;
+	vk.CmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+	VkRect2D scissor = {};
+	scissor.offset = { 0,0 };
+	scissor.extent = { extent.width,(uint32_t)extent.height };
+	vk.CmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	// only the region is bound here, the camera itself is written just before the submit
+	LateLatch->Bind(commandBuffer, PipelineLayout, 0, frameValue);
+	RecordedFrameValue = frameValue;
+	RecordedPacket = packet;
+	RecordedAlpha = packet ? _InterpolationAlpha(*packet) : 1.0f;
+
+	if (packet)
+	{
+		float alpha = RecordedAlpha;
+		// objects are drawn in the visible list order, binds only happen when the pipeline or the
+		// mesh changes from the previous object
+		uint32_t boundPipeline = UINT32_MAX;
+		uint32_t boundMesh = UINT32_MAX;
+
+		for (uint32_t index : packet->Visible)
+		{
+			const ObjectState& current = packet->Current[index];
+			if (current.Pipeline >= Pipelines.size() || current.Mesh >= Meshes.size())
+				continue;
+			if (current.Pipeline != boundPipeline)
+			{
+				// bind graphics pipeline 
+				// Binding a pipeline is very similar to glUseProgram, 
+				// with much more state than only the programmable shaders
+				Pipelines[current.Pipeline]->BindPipeline(commandBuffer);
+				boundPipeline = current.Pipeline;
+			}
+			if (current.Mesh != boundMesh)
+			{
+				// bind vertex buffer
+				Meshes[current.Mesh]->BindBuffer(commandBuffer);
+				boundMesh = current.Mesh;
+			}
+			// objects added in the last step have no previous state
+			const ObjectState& previous = index < packet->Previous.size() ? packet->Previous[index] : current;
+
+			glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::mix(previous.Position, current.Position, alpha))
+				* glm::mat4_cast(glm::slerp(previous.Rotation, current.Rotation, alpha))
+				* glm::scale(glm::mat4(1.0f), glm::mix(previous.Scale, current.Scale, alpha));
+			vk.CmdPushConstants(commandBuffer, PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &model);
+			// set the draw command
+			vk.CmdDraw(commandBuffer, Meshes[current.Mesh]->GetVertexCount(), 1, 0, 0);
+		}
+	}
+	//End render pass
+	vk.CmdEndRenderPass(commandBuffer);
+	GpuProfiler->EndScope(commandBuffer, MainPassScope);
+	GpuProfiler->EndScope(commandBuffer, FrameScope);
+
+	//end command buffer recording
+	VK_CHECK(vk.EndCommandBuffer(commandBuffer));
 }
 
 
 void VEngine::Run()
 {
-	while (!Window.ShouldClose())
+	// The simulation steps at its own fixed rate on another thread and the frames pick up its
+	// latest packet. This thread only pumps window events and hands frames over, with a present
+	// thread recording and submitting happen there too and the three of them overlap
+	Simulation = new SimulationThread{ Scene, SimulationUpdate, Settings.SimulationStepsPerSecond };
+
+	CpuProfiler::SetThreadName("main");
+	AllocationTracker::SetThreadName("main");
+	StopRequested = false;
+	while (!_ShouldClose())
 	{
-       
+		std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+		uint64_t frameNumber = FrameNumber;
+		_WaitForFrameStart();
+		_PoolEvents();
 		Draw();
-		Window.PoolEvents();
+		// nothing to time when the frame was skipped, e.g: minimized
+		if (FrameNumber != frameNumber)
+			CpuFrameTimes[FrameNumber % CPU_TIME_HISTORY] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+		CpuProfiler::GetInstance().EndFrame(FrameNumber);
+		AllocationTracker::EndFrame(FrameNumber);
+		// the whole iteration, a hitch can as well be in the frame start wait or the events
+		if (Hitches && FrameNumber != frameNumber)
+			Hitches->OnFrameEnd(FrameNumber, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count(), Vulkan->GetHostAllocationStats());
+		// test mode: the first frame that allocated is enough, the next ones would repeat it
+		if (Settings.AllocationGuard.Enabled && AllocationTracker::GetGuardHits() > 0)
+			StopRequested = true;
+	}
+
+	// no frame can be reading a packet while the simulation goes away
+	_DrainPresentThread();
+	delete Simulation;
+	Simulation = nullptr;
+
+	// report the frames still in flight, oldest slot first
+	SwapChain->WaitForFrameValue(SwapChain->GetSubmittedFrameValue());
+	uint32_t currentSlot = (uint32_t)SwapChain->GetCurrentFrame();
+	for (uint32_t i = 0; i < MAX_TIMED_SLOTS; ++i)
+		_ReportFrameTiming((currentSlot + i) % MAX_TIMED_SLOTS);
+	// a hitch in the last frames is dumped with what there is
+	if (Hitches)
+		Hitches->Flush();
+
+	if (Settings.AllocationGuard.Enabled && AllocationTracker::GetGuardHits() > 0)
+	{
+		AllocationTracker::WriteGuardReport(stderr);
+		AllocationTracker::ResetGuard();
+		throw std::runtime_error("The frame loop allocated after the warmup frames");
 	}
-	// wait until all gpu operations have been executed like command buffer execution
-    vkDeviceWaitIdle(Vulkan->GetLogicalDevice());
 }
+
+bool VEngine::_IsAllocationGuarded(uint64_t frameNumber) const
+{
+	return Settings.AllocationGuard.Enabled && frameNumber > Settings.AllocationGuard.WarmupFrames;
+}
+void VEngine::_WaitForFrameStart()
+{
+	if (!Settings.LowLatency.Enabled || _IsMinimized())
+		return;
+
+	// the same wait AdquireNextImage does, but before the events are pumped so the frame
+	// doesn't carry input that went stale while it waited for the gpu
+	uint64_t frameValue = SwapChain->GetCurrentFrameSlotValue();
+	bool waited = SwapChain->GetCompletedFrameValue() < frameValue;
+	SwapChain->WaitForFrameValue(frameValue);
+	Pacer.OnFrameCompleted(frameValue, std::chrono::steady_clock::now(), waited);
+
+	// with frames still queued on the gpu, starting now would only make this one wait behind them
+	Pacer.SetStartMargin(std::chrono::microseconds(Settings.LowLatency.StartMarginUs));
+	std::chrono::steady_clock::duration delay = Pacer.GetStartDelay(std::chrono::steady_clock::now());
+	Pacer.OnStartDelayed(delay);
+	if (delay > std::chrono::steady_clock::duration::zero())
+		std::this_thread::sleep_for(delay);
+}
+
+void VEngine::_DrainPresentThread()
+{
+	if (Presenter)
+		Presenter->Drain();
+}
+
+VkExtent2D VEngine::_GetTargetExtent() const
+{
+#ifdef _WIN32
+	if (Window)
+		return VkExtent2D{ Window->Width, Window->Height };
+#endif
+	return VkExtent2D{ Settings.Headless.Width, Settings.Headless.Height };
+}
+
+bool VEngine::_IsMinimized() const
+{
+#ifdef _WIN32
+	if (Window)
+		return Window->IsMinimized();
+#endif
+	return false;
+}
+
+bool VEngine::_ShouldClose() const
+{
+	if (StopRequested)
+		return true;
+#ifdef _WIN32
+	if (Window)
+		return Window->ShouldClose();
+#endif
+	return Settings.Headless.FrameCount > 0 && FrameNumber >= Settings.Headless.FrameCount;
+}
+
+void VEngine::_PoolEvents()
+{
+#ifdef _WIN32
+	if (Window)
+		Window->PoolEvents();
+#endif
+}
+
+void VEngine::_DestroyWindow()
+{
+#ifdef _WIN32
+	delete Window;
+#endif
+	Window = nullptr;
+}
+
 void VEngine::RecreateSwapChain()
 {
-	vkDeviceWaitIdle(Vulkan->GetLogicalDevice());
-	vkFreeCommandBuffers(Vulkan->GetLogicalDevice(), Vulkan->GetCommandPool(), static_cast<uint32_t>(CommandBuffers.size()), CommandBuffers.data());
-	SwapChain->CleanupSwapChain();
-	SwapChain->RecreateSwapChain();
+	const VulkanDispatch& vk = Vulkan->GetDispatch();
+	VkExtent2D windowExtent = _GetTargetExtent();
+	// minimized, there is nothing to present to until the window comes back
+	if (windowExtent.width == 0 || windowExtent.height == 0)
+		return;
+	_DrainPresentThread();
+	SwapChainOutOfDate = false;
+
+	// the command buffers may still be executing for the frames in flight, free them when the gpu is done.
+	// The deletion queue is flushed by the thread rendering the frames, the only one using FrameCommandPool
+	VkDevice device = Vulkan->GetLogicalDevice();
+	VkCommandPool commandPool = FrameCommandPool;
+	Vulkan->GetDeletionQueue().Push([dispatch = &vk, device, commandPool, commandBuffers = std::move(CommandBuffers)]()
+	{
+		dispatch->FreeCommandBuffers(device, commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+	});
+	CommandBuffers.clear();
+
+	SwapChain->RecreateSwapChain(windowExtent);
 	_CreateCommandBuffers();
 }
 
+void VEngine::ApplySettings(const EngineSettings& settings)
+{
+	_DrainPresentThread();
+	// the present thread is only started at construction
+	bool presentThread = Settings.PresentThread;
+	Settings = settings;
+	Settings.PresentThread = presentThread;
+	// frames in flight are applied by the swap chain itself, a new image count needs a new swap chain
+	if (SwapChain->ApplySettings(Settings.SwapChain))
+		RecreateSwapChain();
+}
+
+void VEngine::SetPresentModePolicy(PRESENT_MODE_POLICY policy)
+{
+	EngineSettings settings = Settings;
+	settings.SwapChain.PresentMode = policy;
+	ApplySettings(settings);
+}
+
+std::vector<GpuScopeStats> VEngine::GetGpuScopeStats() const
+{
+	return GpuProfiler->GetScopeStats();
+}
+
+void VEngine::SetComputeCallback(std::function<void(VkCommandBuffer)> callback, VkPipelineStageFlags consumerStages)
+{
+	_DrainPresentThread();
+	ComputeCallback = std::move(callback);
+	ComputeConsumerStages = consumerStages;
+}
+
 void VEngine::Draw()
 {
+	PROFILE_SCOPE("draw");
+	if (_IsMinimized())
+		return;
+
+#ifdef _WIN32
+	// Resize events come in bursts while dragging, the window only keeps the last size
+	// and we rebuild at most once per frame and only if the size really changed
+	if (Window && Window->ConsumeResize())
+	{
+		VkExtent2D extent = SwapChain->GetSwapChainExtent();
+		if (extent.width != Window->Width || extent.height != Window->Height)
+			SwapChainOutOfDate = true;
+	}
+#endif
+	if (SwapChainOutOfDate)
+		RecreateSwapChain();
+
+	// a resize is allowed to allocate, the steady state starts here
+	AllocationGuardScope allocationGuard(_IsAllocationGuarded(FrameNumber + 1));
+	FrameRequest request = {};
+	// only submitted frames count, a low latency acquire retry renders the same number again
+	request.FrameNumber = FrameNumber + 1;
+	if (Settings.LowLatency.Enabled)
+		Pacer.OnInputSampled(std::chrono::steady_clock::now());
+
+	// with a present thread we only wait here when it is PresentQueueDepth frames behind,
+	// blocking acquires and presents no longer hold up the window events
+	// in low latency mode a queued frame would be stale input, render it straight away
+	if (Presenter && !Settings.LowLatency.Enabled)
+	{
+		// the present thread acquires without a timeout, the frame is as good as submitted
+		Presenter->Push(request);
+		FrameNumber = request.FrameNumber;
+	}
+	else if (_RenderFrame(request))
+		FrameNumber = request.FrameNumber;
+}
+
+bool VEngine::_RenderFrame(const FrameRequest& request)
+{
+	PROFILE_SCOPE("render frame");
+	// on the present thread when there is one
+	AllocationGuardScope allocationGuard(_IsAllocationGuarded(request.FrameNumber));
+	// Compute goes first and doesn't wait for the image, so it runs while the previous frame rasterizes.
+	// After a failed acquire it is already in the frame batch, it must not be submitted twice
+	if (ComputeCallback && !AcquirePending)
+	{
+		VkCommandBuffer computeCommands = AsyncCompute->Begin();
+		ComputeCallback(computeCommands);
+		AsyncCompute->Submit(ComputeConsumerStages);
+	}
+
 	// Adquire image from the swapchain
+	// low latency mode doesn't block in the driver, the events get pumped and the frame retried
+	uint64_t timeout = Settings.LowLatency.Enabled ? Settings.LowLatency.AcquireTimeoutUs * 1000ull : UINT64_MAX;
 	uint32_t index;
-	VkResult result = SwapChain->AdquireNextImage(&index);
+	VkResult result;
+	{
+		PROFILE_SCOPE("acquire");
+		result = SwapChain->AdquireNextImage(&index, timeout);
+	}
 	
 	if (result == VK_ERROR_OUT_OF_DATE_KHR) 
 	{
-		vkDeviceWaitIdle(Vulkan->GetLogicalDevice());
-		vkFreeCommandBuffers(Vulkan->GetLogicalDevice(), Vulkan->GetCommandPool(), static_cast<uint32_t>(CommandBuffers.size()), CommandBuffers.data());
-		SwapChain->CleanupSwapChain();
-		SwapChain->RecreateSwapChain();
-		_CreateCommandBuffers();
-		return;
+		AcquirePending = true;
+		SwapChainOutOfDate = true;
+		return false;
+	}
+	else if (result == VK_TIMEOUT || result == VK_NOT_READY)
+	{
+		AcquirePending = true;
+		Pacer.OnAcquireTimeout();
+		return false;
 	}
 	else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) 
 	{
 		LOG_ERR("failed to acquire swap chain image!");
 	}
-	
 
-	// Submit the command buffer for execution with that image attached in the framebuffer
-	result = SwapChain->SubmitCommandBuffers(&CommandBuffers[index], &index);
+	AcquirePending = false;
+
+	// the slot's previous frame finished in AdquireNextImage, its command buffer is free to record.
+	// The packet is taken as late as possible so the frame shows the newest simulation state
+	uint32_t slot = (uint32_t)SwapChain->GetCurrentFrame();
+	VkCommandBuffer commandBuffer = CommandBuffers[slot];
+	_ReportFrameTiming(slot);
+	uint64_t frameValue = SwapChain->GetNextFrameValue();
+	// only waits with more frames in flight than late latch regions
+	SwapChain->WaitForFrameValue(LateLatch->GetOldestFrameUsingSlot(frameValue));
+	_RecordCommandBuffer(commandBuffer, index, frameValue, Simulation ? &Simulation->GetLatestPacket() : nullptr);
+	if (slot < MAX_TIMED_SLOTS)
+		TimedFrameNumbers[slot] = request.FrameNumber;
 
-	if (result == VK_ERROR_OUT_OF_DATE_KHR)
+	// everything loaded since the last frame goes to the gpu in one batch,
+	// submitted before the frame so the frame already sees it
 	{
-		vkDeviceWaitIdle(Vulkan->GetLogicalDevice());
+		PROFILE_SCOPE("upload flush");
+		Uploader->Flush();
+	}
 
-		vkFreeCommandBuffers(Vulkan->GetLogicalDevice(), Vulkan->GetCommandPool(), static_cast<uint32_t>(CommandBuffers.size()), CommandBuffers.data());
-		SwapChain->CleanupSwapChain();
-		SwapChain->RecreateSwapChain();
-		_CreateCommandBuffers();
+	// Submit the command buffer for execution with that image attached in the framebuffer
+	{
+		PROFILE_SCOPE("submit");
+		result = SwapChain->SubmitCommandBuffers(&commandBuffer, &index);
 	}
-	else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) 
+	if (Settings.LowLatency.Enabled)
+		Pacer.OnFrameSubmitted(SwapChain->GetSubmittedFrameValue(), std::chrono::steady_clock::now());
+	if (Startup.OnFrameSubmitted())
 	{
-		LOG_ERR("failed to acquire swap chain image!");
+		LOG_TRACE("Time to first frame %.2f ms\n", Startup.GetStats().TimeToFirstFrameMs)
 	}
 
-}
+	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+	{
+		SwapChainOutOfDate = true;
+	}
+	else if (result != VK_SUCCESS) 
+	{
+		LOG_ERR("failed to present swap chain image!");
+	}
+	return true;
+}
\ No newline at end of file
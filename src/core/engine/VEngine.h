@@ -2,34 +2,169 @@
 #define VENGINE_HPP
 
 #include "core/os/Win32Window.h"
+#include "core/engine/EngineSettings.h"
+#include "core/engine/FramePacket.h"
+#include "core/engine/FramePacer.h"
+#include "core/engine/StartupTimer.h"
+#include "core/utils/ShaderLoader.h"
+#include "core/api/VulkanGpuProfiler.h"
 #include <vulkan/vulkan.h>
 #include <vector>
+#include <functional>
+#include <atomic>
 
+class Win32Window;
 class VertexBuffer;
 class VulkanLib;
 class VulkanSwapChain;
 class VulkanPipeline;
+class VulkanUploadManager;
+class VulkanAsyncCompute;
+class VulkanLateLatchBuffer;
+class VulkanGpuProfiler;
+class PresentThread;
+class SimulationThread;
+class HitchDetector;
+struct FrameRequest;
+
+// Reported for every rendered frame once the gpu is done with it, see SetFrameTimingCallback
+struct FrameTiming
+{
+	uint64_t FrameNumber = 0;
+	double CpuFrameMs = 0.0;// main thread, from the start of the frame until Draw returned
+	double GpuFrameMs = 0.0;// the "frame" gpu scope: the frame's command buffer, compute and uploads not included
+	bool HasGpuTime = false;// false when the graphics queue has no timestamps or the frame scope got no result
+};
 
 class VEngine
 {
-	Win32Window Window;
+	// frame timing history: the slot of a frame is read back when it is reused, the cpu time is
+	// kept until then (frames in flight plus the present queue, far less than this)
+	static constexpr uint32_t MAX_TIMED_SLOTS = 8;
+	static constexpr uint32_t CPU_TIME_HISTORY = 16;
+
+	StartupTimer Startup;// first, its clock starts with the constructor
+	Win32Window* Window;// null when headless
+	EngineSettings Settings;
 	VulkanLib* Vulkan;
 	VulkanSwapChain* SwapChain;
+	VulkanUploadManager* Uploader;
+	VulkanAsyncCompute* AsyncCompute;
+	// records the compute work of each frame, see SetComputeCallback
+	std::function<void(VkCommandBuffer)> ComputeCallback;
+	VkPipelineStageFlags ComputeConsumerStages;
+	// camera of each frame, written right before the submit instead of at record time
+	VulkanLateLatchBuffer* LateLatch;
 	VkPipelineLayout_T* PipelineLayout;
-	VulkanPipeline* Pipeline;
+	// objects pick theirs with ObjectState::Pipeline/Mesh, index 0 is the default pipeline and the triangle
+	std::vector<VulkanPipeline*> Pipelines;
 	VkApplicationInfo AppInfo;
+	// the frame command buffers are recorded and freed by the thread rendering the frames, they get
+	// their own pool so the main thread can keep using Vulkan->GetCommandPool() meanwhile
+	VkCommandPool FrameCommandPool;
 	std::vector<VkCommandBuffer> CommandBuffers;
-	VertexBuffer* Vertexbuffer;
-	VulkanLib* _CreateVulkanInstance(const char* appName);
+	std::vector<VertexBuffer*> Meshes;
+	// gpu time of the frame and of its passes, one set of queries per command buffer slot
+	VulkanGpuProfiler* GpuProfiler;
+	uint32_t FrameScope;
+	uint32_t MainPassScope;
+	uint64_t TimedFrameNumbers[MAX_TIMED_SLOTS];// frame waiting to be read back in each slot, 0 none
+	double CpuFrameTimes[CPU_TIME_HISTORY];// by frame number
+	std::function<void(const FrameTiming&)> FrameTimingCallback;
+	PresentThread* Presenter;// null when frames are presented from the main thread
+	uint64_t FrameNumber;// frames submitted, or handed to the present thread
+	// set by whichever thread acquires/presents, handled on the main thread
+	std::atomic<bool> SwapChainOutOfDate;
+	// scene the simulation thread starts from and the function stepping it, see SetSimulation
+	SimulationState Scene;
+	std::function<void(SimulationState&, double)> SimulationUpdate;
+	SimulationThread* Simulation;// only alive while Run is running
+	FramePacer Pacer;// frame start timing and latency stats of the low latency mode
+	HitchDetector* Hitches;// null unless Settings.Hitch is enabled
+	bool AcquirePending;// the last acquire didn't get an image, the frame's compute is already submitted
+	// what the frame being submitted was recorded with, the camera is latched from the same packet
+	// and alpha so it can't come from another simulation step than the objects
+	const FramePacket* RecordedPacket;// null without a simulation
+	float RecordedAlpha;
+	uint64_t RecordedFrameValue;
+	std::atomic<bool> StopRequested;
+	ShaderList PipelineShaders;// loaded once at startup, every pipeline variant uses them
+	// the members only, the public constructors create the window (or not) and call _Init
+	explicit VEngine(const EngineSettings& settings);
+	// createWindow runs on this thread while the vulkan instance is created on another one
+	void _Init(const char* appName, const std::function<void()>& createWindow);
+	VulkanLib* _CreateVulkanInstance(const char* appName, const std::function<void()>& createWindow);
+	std::vector<char> _ReadPipelineCache() const;
+	void _WritePipelineCache() const;
 	void _CreatePipeLineLayout();
 	void _CreateCommandBuffers();
+	void _CreateDefaultScene();
+	// reports the frame that last used the slot, the gpu must be done with it
+	void _ReportFrameTiming(uint32_t slot);
+	// records the frame with the objects interpolated between the two states of the packet
+	void _RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint64_t frameValue, const FramePacket* packet);
+	// writes the camera of the frame from the packet it was recorded with, runs just before the frame is submitted
+	void _LatchCamera(uint64_t frameValue);
+	// how far between the previous and the current state of the packet the frame is rendered
+	static float _InterpolationAlpha(const FramePacket& packet);
+	// gpu side of a frame: compute, acquire, uploads, submit and present.
+	// false when the acquire failed and nothing was submitted, the frame is retried with the same number
+	bool _RenderFrame(const FrameRequest& request);
+	// low latency mode: wait for the frame fence and hold the frame back until just in time, before input is sampled
+	void _WaitForFrameStart();
+	// wait for the present thread to go idle before touching the swap chain from the main thread
+	void _DrainPresentThread();
+	// see EngineSettings::AllocationGuard
+	bool _IsAllocationGuarded(uint64_t frameNumber) const;
+	// window or headless, the rest of the engine doesn't care which
+	VkExtent2D _GetTargetExtent() const;
+	bool _IsMinimized() const;
+	bool _ShouldClose() const;
+	void _PoolEvents();
+	void _DestroyWindow();
 	
 public:
-	VEngine(const char* appname, HINSTANCE hInstance);
+#ifdef _WIN32
+	// renders to a window unless settings.Headless is enabled
+	VEngine(const char* appname, HINSTANCE hInstance, const EngineSettings& settings = {});
+#endif
+	// always headless, no window system needed
+	VEngine(const char* appname, const EngineSettings& settings);
 	~VEngine();
 	void Run();
+	// Run returns after the frame in progress, can be called from any thread
+	void RequestStop() { StopRequested = true; }
+	bool IsHeadless() const { return Window == nullptr; }
 	void Draw();
 	void RecreateSwapChain();
+	// only rebuilds what the changed settings need
+	void ApplySettings(const EngineSettings& settings);
+	const EngineSettings& GetSettings() const { return Settings; }
+	// switch while running, e.g: UNCAPPED for benchmarks, POWER_SAVING on battery
+	void SetPresentModePolicy(PRESENT_MODE_POLICY policy);
+	// Called every frame with a compute command buffer that is submitted to the compute queue
+	// before the frame, the frame waits for it at consumerStages (the stages reading the results)
+	void SetComputeCallback(std::function<void(VkCommandBuffer)> callback
+		, VkPipelineStageFlags consumerStages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+	// Must be called before Run: the simulation thread starts from initialState and calls update
+	// with the fixed step length in seconds, Settings.SimulationStepsPerSecond times a second
+	void SetSimulation(const SimulationState& initialState, std::function<void(SimulationState&, double)> update);
+	// Scene resources, must be added before Run. The vertices are a triangle list with position and
+	// color interleaved (6 floats per vertex), returns the index for ObjectState::Mesh
+	uint32_t AddMesh(const std::vector<float>& vertices);
+	// the default pipeline with its own tiny depth bias: same image, but a distinct pipeline the
+	// driver has to switch to. Returns the index for ObjectState::Pipeline
+	uint32_t AddPipelineVariant();
+	// called from the thread rendering the frames, a few frames after each frame was drawn.
+	// The frames still in flight are reported when Run returns
+	void SetFrameTimingCallback(std::function<void(const FrameTiming&)> callback) { FrameTimingCallback = std::move(callback); }
+	// moving averages of the gpu scopes ("frame", "main pass"), can be called from any thread
+	std::vector<GpuScopeStats> GetGpuScopeStats() const;
+	const VulkanLib& GetVulkan() const { return *Vulkan; }
+	// only measured while Settings.LowLatency is enabled
+	const LatencyStats& GetLatencyStats() const { return Pacer.GetStats(); }
+	// stage times of the constructor and the time to the first frame, can be called from any thread
+	StartupStats GetStartupStats() const { return Startup.GetStats(); }
 
 };
 
@@ -1,4 +1,5 @@
 #include "Win32Window.h"
+#ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
 #include <vulkan/vulkan.h>
 #include <cstdio>
@@ -30,7 +31,17 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
 		}
 		case WM_SIZE:
 		{
-		
+			Win32Window* win = (Win32Window*)GetWindowLongPtr(hwnd, GWLP_USERDATA);
+			if (win)
+				win->OnResize(LOWORD(lparam), HIWORD(lparam), wparam == SIZE_MINIMIZED);
+			break;
+		}
+		case WM_ENTERSIZEMOVE:
+		case WM_EXITSIZEMOVE:
+		{
+			Win32Window* win = (Win32Window*)GetWindowLongPtr(hwnd, GWLP_USERDATA);
+			if (win)
+				win->OnSizeMove(msg == WM_ENTERSIZEMOVE);
 			break;
 		}
 		default:
@@ -44,6 +55,10 @@ Win32Window::Win32Window(LPCTSTR appName)
 	, WindowHandle(nullptr)
 	, ApplicationName(appName)
 	, CloseWindow(false)
+	, Resized(false)
+	, Minimized(false)
+	, InSizeMove(false)
+	, LiveResizeCallback()
 {
 }
 
@@ -126,6 +141,30 @@ void Win32Window::OnDestroy()
 	CloseWindow = true;
 }
 
+void Win32Window::OnResize(unsigned int width, unsigned int height, bool minimized)
+{
+	Minimized = minimized || width == 0 || height == 0;
+	if (Minimized)
+		return;
+
+	if (width != Width || height != Height)
+	{
+		Width = width;
+		Height = height;
+		Resized = true;
+	}
+
+	if (InSizeMove && LiveResizeCallback)
+		LiveResizeCallback();
+}
+
+bool Win32Window::ConsumeResize()
+{
+	bool resized = Resized;
+	Resized = false;
+	return resized;
+}
+
 HWND Win32Window::GetHandleToWindow() const
 {
 	return WindowHandle;
@@ -147,3 +186,5 @@ void Win32Window::CreateWindowSurface(VkInstance vulkanInstance, VkSurfaceKHR_T*
 	if (vkCreateWin32SurfaceKHR(vulkanInstance, &surfaceInfo, nullptr, &(*windowSurface)) != VK_SUCCESS)
 		LOG_ERR("Unable to create window surface for win32 api!\n");
 }
+
+#endif //_WIN32
@@ -1,6 +1,9 @@
 #pragma once
 
+// Windows only, headless builds (VEngine without a window) don't need it
+#ifdef _WIN32
 #include <Windows.h>
+#include <functional>
 struct VkInstance_T;
 struct VkSurfaceKHR_T;
 class VEngine;
@@ -12,6 +15,10 @@ class Win32Window
 	HWND WindowHandle;
 	LPCTSTR ApplicationName;
 	bool CloseWindow;
+	bool Resized;
+	bool Minimized;
+	bool InSizeMove;
+	std::function<void()> LiveResizeCallback;
 public:
 	unsigned int Width{ 1280 }, Height{720};
 
@@ -21,8 +28,16 @@ public:
 	void CreateWindowSurface(VkInstance_T* vulkanInstance, VkSurfaceKHR_T** windowSurface);
 	bool ShouldClose() const { return CloseWindow; }
 	void OnDestroy();
+	void OnResize(unsigned int width, unsigned int height, bool minimized);
+	void OnSizeMove(bool entering) { InSizeMove = entering; }
+	// true once after the client area changed size, Width and Height hold the last size
+	bool ConsumeResize();
+	bool IsMinimized() const { return Minimized; }
+	// called on every size change while the user drags the border (Win32 modal loop)
+	void SetLiveResizeCallback(std::function<void()> callback) { LiveResizeCallback = std::move(callback); }
 	void PoolEvents();
 	HWND GetHandleToWindow() const;
 	HINSTANCE GetWindowInstance()const;
 };
 
+#endif //_WIN32
@@ -1,9 +1,26 @@
 #include "ShaderLoader.h"
 #include <fstream>
+#include <cstring>
 #include "core/debugger/public/Logger.h"
+#ifdef VENGINE_EMBEDDED_SHADERS
+#include "generated/EmbeddedShaders.h"
+#endif
 
 std::vector<char> ShaderLoader::readFile(const std::string& shaderSrcFile)
 {
+#ifdef VENGINE_EMBEDDED_SHADERS
+    // release builds compile the spir-v into the binary (see glslShaders/compileShaders.py)
+    // so we only go to disk for shaders that were not embedded
+    for (const EmbeddedShaders::Entry& shader : EmbeddedShaders::Table)
+    {
+        if (shaderSrcFile == shader.Path)
+        {
+            std::vector<char> src(shader.Size, 0);
+            std::memcpy(src.data(), shader.Code, shader.Size);
+            return src;
+        }
+    }
+#endif
     std::ifstream f(shaderSrcFile, std::ios::ate | std::ios::binary);
     if (!f.is_open()) LOG_ERR(("can't open file: " + shaderSrcFile).c_str());
 
@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+// Single producer single consumer ring buffer without locks: only the producer writes Tail
+// and only the consumer writes Head. Capacity must be a power of two
+template<typename T, std::size_t Capacity>
+class SpscQueue
+{
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+	// on their own cache lines so the two threads don't invalidate each other's line on every push/pop
+	alignas(64) std::atomic<std::size_t> Head;
+	alignas(64) std::atomic<std::size_t> Tail;
+	T Items[Capacity];
+
+public:
+	SpscQueue() : Head{ 0 }, Tail{ 0 }, Items{} {}
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	// producer thread only, false when full
+	bool TryPush(const T& item)
+	{
+		std::size_t tail = Tail.load(std::memory_order_relaxed);
+		if (tail - Head.load(std::memory_order_acquire) == Capacity)
+			return false;
+		Items[tail & (Capacity - 1)] = item;
+		Tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer thread only, false when empty
+	bool TryPop(T& item)
+	{
+		std::size_t head = Head.load(std::memory_order_relaxed);
+		if (head == Tail.load(std::memory_order_acquire))
+			return false;
+		item = Items[head & (Capacity - 1)];
+		Head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// a snapshot, it may have changed by the time the caller looks at it
+	std::size_t Size() const { return Tail.load(std::memory_order_acquire) - Head.load(std::memory_order_acquire); }
+	bool Empty() const { return Size() == 0; }
+};
@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Lock-free handoff of the latest value between one writer and one reader thread.
+// The writer always has a slot to fill and the reader always has a slot to read, the third one
+// is swapped between them. Neither side ever waits, the reader just skips values it was too slow to see
+template<typename T>
+class TripleBuffer
+{
+	static constexpr uint8_t INDEX_MASK = 0x3;
+	static constexpr uint8_t DIRTY_BIT = 0x4;// the shared slot has a value the reader hasn't taken yet
+
+	T Slots[3];
+	uint8_t WriteIndex;// writer thread only
+	uint8_t ReadIndex;// reader thread only
+	alignas(64) std::atomic<uint8_t> Shared;
+
+public:
+	TripleBuffer() : Slots{}, WriteIndex{ 0 }, ReadIndex{ 1 }, Shared{ 2 } {}
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+	// writer thread only, the slot keeps whatever was written to it two publishes ago
+	// so containers inside T keep their capacity
+	T& GetWriteBuffer() { return Slots[WriteIndex]; }
+
+	// writer thread only, hands the write slot to the reader and takes the shared one back
+	void Publish()
+	{
+		uint8_t previous = Shared.exchange(WriteIndex | DIRTY_BIT, std::memory_order_acq_rel);
+		WriteIndex = previous & INDEX_MASK;
+	}
+
+	// reader thread only, true when a newer value was published since the last call
+	bool Update()
+	{
+		if ((Shared.load(std::memory_order_relaxed) & DIRTY_BIT) == 0)
+			return false;
+		uint8_t previous = Shared.exchange(ReadIndex, std::memory_order_acq_rel);
+		ReadIndex = previous & INDEX_MASK;
+		return true;
+	}
+
+	// reader thread only, stays valid until the next Update
+	const T& GetReadBuffer() const { return Slots[ReadIndex]; }
+};
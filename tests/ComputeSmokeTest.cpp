@@ -0,0 +1,210 @@
+// Compute smoke test for headless CI (lavapipe, SwiftShader): runs glslShaders/computeFill.glsl
+// through VulkanComputePipeline and reads the storage buffer back.
+// Exercises the storage buffer binding, push constants, a specialization constant and
+// DispatchForSize with a size that isn't a multiple of the local size. Exit code 0 when it passed
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <vulkan/vulkan.h>
+#include "core/api/VulkanLib.h"
+#include "core/api/VulkanComputePipeline.h"
+
+namespace
+{
+	const uint32_t ELEMENT_COUNT = 1000;// 16 groups of 64, the last 24 invocations have nothing to do
+	const uint32_t BUFFER_ELEMENTS = 1024;
+	const uint32_t SCALE = 3;
+	const uint32_t OFFSET = 7;// specialization constant 1 of the shader
+	const uint32_t UNTOUCHED = 0xDEADBEEF;
+
+	struct PushConstants
+	{
+		uint32_t Count;
+		uint32_t Scale;
+	};
+
+	struct ReadbackBuffer
+	{
+		VkBuffer Buffer = VK_NULL_HANDLE;
+		VkDeviceMemory Memory = VK_NULL_HANDLE;
+		uint32_t* Values = nullptr;
+	};
+
+	bool _CreateReadbackBuffer(const VulkanLib& vulkan, VkDeviceSize size, ReadbackBuffer& buffer)
+	{
+		const VulkanDispatch& vk = vulkan.GetDispatch();
+		VkDevice device = vulkan.GetLogicalDevice();
+
+		VkBufferCreateInfo bufferInfo = {};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		if (vk.CreateBuffer(device, &bufferInfo, vulkan.GetAllocator(), &buffer.Buffer) != VK_SUCCESS)
+			return false;
+
+		VkMemoryRequirements requirements;
+		vk.GetBufferMemoryRequirements(device, buffer.Buffer, &requirements);
+		VkMemoryAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = requirements.size;
+		allocInfo.memoryTypeIndex = vulkan.FindMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		if (allocInfo.memoryTypeIndex == UINT32_MAX || vk.AllocateMemory(device, &allocInfo, vulkan.GetAllocator(), &buffer.Memory) != VK_SUCCESS)
+			return false;
+
+		return vk.BindBufferMemory(device, buffer.Buffer, buffer.Memory, 0) == VK_SUCCESS
+			&& vk.MapMemory(device, buffer.Memory, 0, size, 0, (void**)&buffer.Values) == VK_SUCCESS;
+	}
+
+	void _DestroyReadbackBuffer(const VulkanLib& vulkan, ReadbackBuffer& buffer)
+	{
+		const VulkanDispatch& vk = vulkan.GetDispatch();
+		VkDevice device = vulkan.GetLogicalDevice();
+		if (buffer.Values)
+			vk.UnmapMemory(device, buffer.Memory);
+		vk.DestroyBuffer(device, buffer.Buffer, vulkan.GetAllocator());
+		vk.FreeMemory(device, buffer.Memory, vulkan.GetAllocator());
+	}
+
+	// records the dispatch and waits for it, false when the gpu never ran it
+	bool _RunDispatch(const VulkanLib& vulkan, VulkanComputePipeline& pipeline, VkBuffer buffer)
+	{
+		const VulkanDispatch& vk = vulkan.GetDispatch();
+		VkDevice device = vulkan.GetLogicalDevice();
+
+		VkCommandPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		poolInfo.queueFamilyIndex = (uint32_t)vulkan.GetComputeQueueIndex();
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		if (vk.CreateCommandPool(device, &poolInfo, vulkan.GetAllocator(), &commandPool) != VK_SUCCESS)
+			return false;
+
+		VkCommandBufferAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+		VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+		vk.AllocateCommandBuffers(device, &allocInfo, &cmdBuffer);
+
+		VkDescriptorSet set = pipeline.AllocateDescriptorSet();
+		pipeline.SetStorageBuffer(set, 0, buffer);
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vk.BeginCommandBuffer(cmdBuffer, &beginInfo);
+
+		PushConstants push = { ELEMENT_COUNT, SCALE };
+		pipeline.BindPipeline(cmdBuffer);
+		pipeline.BindDescriptorSet(cmdBuffer, set);
+		pipeline.PushConstants(cmdBuffer, &push, sizeof(push));
+		pipeline.DispatchForSize(cmdBuffer, ELEMENT_COUNT);
+
+		// the host reads the buffer once the fence is signaled
+		VkBufferMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = buffer;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+		vk.CmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+		vk.EndCommandBuffer(cmdBuffer);
+
+		VkFenceCreateInfo fenceInfo = {};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		VkFence fence = VK_NULL_HANDLE;
+		vk.CreateFence(device, &fenceInfo, vulkan.GetAllocator(), &fence);
+
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &cmdBuffer;
+		bool completed = vulkan.QueueSubmit(vulkan.GetComputeQueue(), 1, &submitInfo, fence) == VK_SUCCESS
+			&& vk.WaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX) == VK_SUCCESS;
+
+		vk.DestroyFence(device, fence, vulkan.GetAllocator());
+		vk.DestroyCommandPool(device, commandPool, vulkan.GetAllocator());
+		return completed;
+	}
+
+	uint32_t _CountMismatches(const uint32_t* values)
+	{
+		uint32_t mismatches = 0;
+		for (uint32_t i = 0; i < BUFFER_ELEMENTS; ++i)
+		{
+			uint32_t expected = i < ELEMENT_COUNT ? i * SCALE + OFFSET : UNTOUCHED;
+			if (values[i] == expected)
+				continue;
+			if (mismatches < 8)
+				std::cerr << "Values[" << i << "] = " << values[i] << ", expected " << expected << "\n";
+			++mismatches;
+		}
+		return mismatches;
+	}
+}
+
+int main()
+{
+	try
+	{
+		VulkanLib vulkan(nullptr);
+		VkApplicationInfo appInfo = {};
+		appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+		appInfo.pApplicationName = "compute smoke test";
+		appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+		appInfo.pEngineName = "VEngine";
+		appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+		appInfo.apiVersion = VK_API_VERSION_1_2;
+		vulkan.Init(appInfo);
+
+		VkPhysicalDeviceProperties gpuProperties;
+		vulkan.GetInstanceDispatch().GetPhysicalDeviceProperties(vulkan.GetGpu(), &gpuProperties);
+		std::cout << "compute smoke test on " << gpuProperties.deviceName << "\n";
+
+		ReadbackBuffer buffer;
+		bool ran = false;
+		if (_CreateReadbackBuffer(vulkan, BUFFER_ELEMENTS * sizeof(uint32_t), buffer))
+		{
+			for (uint32_t i = 0; i < BUFFER_ELEMENTS; ++i)
+				buffer.Values[i] = UNTOUCHED;
+
+			ComputePipelineDesc desc;
+			desc.ShaderPath = "glslShaders/computeFill.spv";
+			desc.StorageBufferCount = 1;
+			desc.PushConstantSize = sizeof(PushConstants);
+			desc.MaxDescriptorSets = 1;
+			desc.Specialization.Set<uint32_t>(1, OFFSET);
+			VulkanComputePipeline pipeline(vulkan, desc);
+			ran = _RunDispatch(vulkan, pipeline, buffer.Buffer);
+		}
+
+		uint32_t mismatches = ran ? _CountMismatches(buffer.Values) : BUFFER_ELEMENTS;
+		_DestroyReadbackBuffer(vulkan, buffer);
+		// the pipeline went through the deletion queue, ~VulkanLib flushes it
+		vulkan.GetDispatch().DeviceWaitIdle(vulkan.GetLogicalDevice());
+
+		if (!ran)
+		{
+			std::cerr << "compute smoke test: the dispatch did not run\n";
+			return EXIT_FAILURE;
+		}
+		if (mismatches > 0)
+		{
+			std::cerr << "compute smoke test: " << mismatches << " wrong values\n";
+			return EXIT_FAILURE;
+		}
+		std::cout << "compute smoke test passed\n";
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "compute smoke test: " << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}